@@ -0,0 +1,145 @@
+/*
+ * Microbenchmark for misc/ring.c: transfers data from a producer to a
+ * consumer thread, using the copying API (mp_ring_write()/mp_ring_read()),
+ * and the zero-copy API (mp_ring_reserve()/mp_ring_commit() and
+ * mp_ring_peek()/mp_ring_consume()) on normal and mirrored ringbuffers.
+ * The data is verified on the consumer side.
+ *
+ * Build from the source root after configuring with waf:
+ *
+ *   gcc -std=c99 -O2 -D_GNU_SOURCE -I. -Ibuild TOOLS/ringbench.c misc/ring.c \
+ *       ta/ta.c ta/ta_talloc.c ta/ta_utils.c -lpthread -o ringbench
+ *
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "talloc.h"
+#include "misc/ring.h"
+
+#define RING_SIZE (64 * 1024)
+#define CHUNK 3000 // deliberately not a divisor of the ring size
+#define TOTAL (512LL * 1024 * 1024)
+
+struct bench {
+    struct mp_ring *ring;
+    bool zero_copy;
+    bool failed;
+};
+
+// The transferred data is a byte counter, so the consumer can verify it.
+static void fill(uint8_t *dst, long long pos, int len)
+{
+    for (int n = 0; n < len; n++)
+        dst[n] = (uint8_t)(pos + n);
+}
+
+static bool check(const uint8_t *src, long long pos, int len)
+{
+    for (int n = 0; n < len; n++) {
+        if (src[n] != (uint8_t)(pos + n))
+            return false;
+    }
+    return true;
+}
+
+static void *producer(void *arg)
+{
+    struct bench *b = arg;
+    uint8_t tmp[CHUNK];
+    long long pos = 0;
+    while (pos < TOTAL) {
+        int len = TOTAL - pos < CHUNK ? TOTAL - pos : CHUNK;
+        int done;
+        if (b->zero_copy) {
+            struct mp_ring_span spans[2];
+            done = mp_ring_reserve(b->ring, len, spans);
+            fill(spans[0].data, pos, spans[0].len);
+            fill(spans[1].data, pos + spans[0].len, spans[1].len);
+            mp_ring_commit(b->ring, done);
+        } else {
+            fill(tmp, pos, len);
+            done = mp_ring_write(b->ring, tmp, len);
+        }
+        if (!done)
+            sched_yield();
+        pos += done;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    struct bench *b = arg;
+    uint8_t tmp[CHUNK];
+    long long pos = 0;
+    while (pos < TOTAL) {
+        int done;
+        if (b->zero_copy) {
+            struct mp_ring_span spans[2];
+            done = mp_ring_peek(b->ring, CHUNK, spans);
+            if (!check(spans[0].data, pos, spans[0].len) ||
+                !check(spans[1].data, pos + spans[0].len, spans[1].len))
+                b->failed = true;
+            mp_ring_consume(b->ring, done);
+        } else {
+            done = mp_ring_read(b->ring, tmp, CHUNK);
+            if (!check(tmp, pos, done))
+                b->failed = true;
+        }
+        if (!done)
+            sched_yield();
+        pos += done;
+    }
+    return NULL;
+}
+
+static void run(const char *name, struct mp_ring *ring, bool zero_copy)
+{
+    struct bench b = { .ring = ring, .zero_copy = zero_copy };
+    struct timespec t0, t1;
+    pthread_t p, c;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&p, NULL, producer, &b);
+    pthread_create(&c, NULL, consumer, &b);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%-24s %8.1f MB/s %s\n", name, TOTAL / secs / (1024 * 1024),
+           b.failed ? "DATA CORRUPTED" : "");
+}
+
+int main(void)
+{
+    void *ctx = talloc_new(NULL);
+
+    run("copy", mp_ring_new(ctx, RING_SIZE), false);
+    run("zero-copy", mp_ring_new(ctx, RING_SIZE), true);
+    run("zero-copy (mirrored)", mp_ring_new_mirrored(ctx, RING_SIZE), true);
+
+    talloc_free(ctx);
+    return 0;
+}
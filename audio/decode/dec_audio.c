@@ -270,15 +270,23 @@ static int filter_n_bytes(struct dec_audio *da, struct mp_audio_buffer *outbuf,
     mp_audio_buffer_peek(da->decode_buffer, &filter_data);
     filter_data.rate = da->afilter->input.rate; // due to playback speed change
     len = MPMIN(filter_data.samples, len);
-    filter_data.samples = len;
-    bool eof = filter_data.samples == 0 && error < 0;
-
-    if (af_filter(da->afilter, &filter_data, eof ? AF_FILTER_FLAG_EOF : 0) < 0)
-        return -1;
-
-    mp_audio_buffer_append(outbuf, &filter_data);
-    if (eof && filter_data.samples > 0)
-        error = 0; // don't end playback yet
+    bool eof = len == 0 && error < 0;
+
+    // Never pass more data than the filter buffers were allocated for.
+    int pos = 0;
+    do {
+        struct mp_audio chunk = filter_data;
+        mp_audio_skip_samples(&chunk, pos);
+        chunk.samples = MPMIN(len - pos, da->afilter->max_input_samples);
+        pos += chunk.samples;
+
+        if (af_filter(da->afilter, &chunk, eof ? AF_FILTER_FLAG_EOF : 0) < 0)
+            return -1;
+
+        mp_audio_buffer_append(outbuf, &chunk);
+        if (eof && chunk.samples > 0)
+            error = 0; // don't end playback yet
+    } while (pos < len);
 
     // remove processed data from decoder buffer:
     mp_audio_buffer_skip(da->decode_buffer, len);
@@ -21,6 +21,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+
+#include <libavutil/mem.h>
 
 #include "common/common.h"
 #include "common/global.h"
@@ -498,6 +501,90 @@ static int af_fix_rate(struct af_stream *s, struct af_instance **p_af,
     return AF_OK;
 }
 
+static void af_free_buffers(struct af_stream *s)
+{
+    for (int n = 0; n < 2; n++) {
+        av_free(s->buffers[n].data);
+        s->buffers[n] = (struct af_buffer){0};
+    }
+}
+
+// Assign output buffers to all out_of_place filters. Two buffers are used in
+// ping-pong fashion, so that a filter never writes into the buffer it reads
+// from. They are allocated once here, large enough for s->max_input_samples
+// input samples, so that af_filter() does no allocations in the steady state.
+// Filters which process data in place don't need a buffer at all.
+static void af_plan_buffers(struct af_stream *s)
+{
+    int plane_size[2] = {0};
+    int num_planes[2] = {0};
+    int samples = s->max_input_samples;
+    int cur = -1; // buffer containing the current data (-1: input buffer)
+
+    af_free_buffers(s);
+
+    for (struct af_instance *af = s->first->next; af != s->last; af = af->next)
+    {
+        int out_samples = af->max_output_samples
+                        ? af->max_output_samples(af, samples)
+                        : (int)ceil(samples * af->mul);
+        struct mp_audio *out = af->data;
+        // Stale pointers into the old buffers
+        if (af->out_buffer && !out->allocated[0])
+            mp_audio_set_null_data(out);
+        af->out_buffer = NULL;
+        if (af->out_of_place) {
+            cur = cur == 0 ? 1 : 0;
+            plane_size[cur] = MPMAX(plane_size[cur], out_samples * out->sstride);
+            num_planes[cur] = MPMAX(num_planes[cur], out->num_planes);
+            af->out_buffer = &s->buffers[cur];
+        }
+        samples = out_samples;
+    }
+
+    for (int n = 0; n < 2; n++) {
+        if (!num_planes[n])
+            continue;
+        // Keep planes aligned for SIMD
+        int size = MP_ALIGN_UP(MPMAX(plane_size[n], 1), 64);
+        s->buffers[n] = (struct af_buffer) {
+            .data = av_malloc(size * num_planes[n]),
+            .plane_size = size,
+            .num_planes = num_planes[n],
+        };
+        if (!s->buffers[n].data)
+            abort();
+        MP_VERBOSE(s, "Filter buffer %d: %d planes of %d bytes.\n", n,
+                   num_planes[n], size);
+    }
+}
+
+/* Make sure af->data of an out_of_place filter has room for at least the
+ * given number of samples. This normally points af->data to the buffer
+ * assigned by af_plan_buffers(). If the buffer is too small (e.g. the
+ * filter's output ratio changed without reinitialization), the filter gets
+ * its own buffer, which is allocated on demand like with
+ * mp_audio_realloc_min(). */
+void af_alloc_output(struct af_instance *af, int samples)
+{
+    struct mp_audio *out = af->data;
+    struct af_buffer *buf = af->out_buffer;
+    if (buf && buf->data && !out->allocated[0] &&
+        out->num_planes <= buf->num_planes &&
+        samples * out->sstride <= buf->plane_size)
+    {
+        for (int n = 0; n < out->num_planes; n++)
+            out->planes[n] = buf->data + n * buf->plane_size;
+        return;
+    }
+    if (!out->allocated[0]) {
+        MP_VERBOSE(af, "Allocating private output buffer for %d samples.\n",
+                   samples);
+        mp_audio_set_null_data(out);
+    }
+    mp_audio_realloc_min(out, samples);
+}
+
 // Return AF_OK on success or AF_ERROR on failure.
 // Warning:
 // A failed af_reinit() leaves the audio chain behind in a useless, broken
@@ -564,6 +651,8 @@ static int af_reinit(struct af_stream *s)
 
     af_print_filter_chain(s, NULL, MSGL_V);
 
+    af_plan_buffers(s);
+
     /* Set previously unset fields in s->output to those of the filter chain
      * output. This is used to make the output format fixed, and even if you
      * insert new filters or change the input format, the output format won't
@@ -611,12 +700,14 @@ struct af_stream *af_new(struct mpv_global *global)
     s->last->prev = s->first;
     s->opts = global->opts;
     s->log = mp_log_new(s, global->log, "!af");
+    s->max_input_samples = AF_DEFAULT_MAX_INPUT;
     return s;
 }
 
 void af_destroy(struct af_stream *s)
 {
     af_uninit(s);
+    af_free_buffers(s);
     talloc_free(s);
 }
 
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #include "options/options.h"
@@ -39,9 +40,19 @@ struct mpv_global;
 #define AF_FLAGS_REENTRANT      0x00000000
 #define AF_FLAGS_NOT_REENTRANT  0x00000001
 
+// Default for af_stream.max_input_samples
+#define AF_DEFAULT_MAX_INPUT 16384
+
 // Flags for af->filter()
 #define AF_FILTER_FLAG_EOF 1
 
+// Output buffer shared between filters, see af_plan_buffers() in af.c
+struct af_buffer {
+    uint8_t *data;      // num_planes * plane_size bytes
+    int plane_size;     // size of each plane in bytes
+    int num_planes;
+};
+
 /* Audio filter information not specific for current instance, but for
    a specific filter */
 struct af_info {
@@ -75,6 +86,15 @@ struct af_instance {
                  * the number of samples passed though. (Ratio of input
                  * and output, e.g. mul=4 => 1 sample becomes 4 samples) .*/
     bool auto_inserted; // inserted by af.c, such as conversion filters
+    /* Set by filters on AF_CONTROL_REINIT if they can't process the data in
+     * place, but write their output to af->data (using af_alloc_output()). */
+    bool out_of_place;
+    /* Optional, for out_of_place filters: maximum number of output samples
+     * the filter can return for in_samples input samples. If NULL, this is
+     * assumed to be in_samples * mul (rounded up). */
+    int (*max_output_samples)(struct af_instance *af, int in_samples);
+    // Output buffer assigned by the filter chain (NULL if not out_of_place)
+    struct af_buffer *out_buffer;
 };
 
 // Current audio stream
@@ -88,6 +108,12 @@ struct af_stream {
     struct mp_audio output;
     struct mp_audio filter_output;
 
+    // Maximum number of samples passed to af_filter() at once. The filter
+    // buffers are preallocated for this size on initialization.
+    int max_input_samples;
+    // Ping-pong buffers for the output of out_of_place filters
+    struct af_buffer buffers[2];
+
     struct mp_log *log;
     struct MPOpts *opts;
 };
@@ -115,6 +141,10 @@ enum af_control {
     AF_CONTROL_SET_PAN_BALANCE,
     AF_CONTROL_GET_PAN_BALANCE,
     AF_CONTROL_SET_PLAYBACK_SPEED,
+    // double*: speed factor relative to the rates the filter was configured
+    // with. Applied without reinitializing (and without audible glitches),
+    // but only for small factors close to 1.
+    AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE,
 };
 
 // Argument for AF_CONTROL_SET_PAN_LEVEL
@@ -136,6 +166,7 @@ double af_calc_filter_multiplier(struct af_stream *s);
 double af_calc_delay(struct af_stream *s);
 
 int af_test_output(struct af_instance *af, struct mp_audio *out);
+void af_alloc_output(struct af_instance *af, int samples);
 
 int af_from_dB(int n, float *in, float *out, float k, float mi, float ma);
 int af_to_dB(int n, float *in, float *out, float k);
@@ -189,7 +189,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags)
   af_channels_t* s = af->priv;
   int 		 i;
 
-  mp_audio_realloc_min(af->data, data->samples);
+  af_alloc_output(af, data->samples);
 
   // Reset unused channels
   memset(l->planes[0],0,mp_audio_psize(c) / c->nch * l->nch);
@@ -210,6 +210,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags)
 static int af_open(struct af_instance* af){
     af->control=control;
     af->filter=filter;
+    af->out_of_place = true;
     af_channels_t *s = af->priv;
 
     // If router scan commandline for routing pairs
@@ -72,7 +72,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
 
 static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 {
-    mp_audio_realloc_min(af->data, data->samples);
+    af_alloc_output(af, data->samples);
 
     struct mp_audio *out = af->data;
     size_t len = mp_audio_psize(data) / data->bps;
@@ -105,6 +105,7 @@ static int af_open(struct af_instance *af)
 {
     af->control = control;
     af->filter = filter;
+    af->out_of_place = true;
     return AF_OK;
 }
 
@@ -32,20 +32,40 @@
 
 #include "af.h"
 #include "dsp.h"
+#include "fftconv.h"
 
 /* HRTF filter coefficients and adjustable parameters */
 #include "af_hrtf.h"
 
+/* Inputs of the convolution engine */
+enum {
+    HRTF_IN_LF, HRTF_IN_RF, HRTF_IN_LR, HRTF_IN_RR, HRTF_IN_CF, HRTF_IN_CR,
+    HRTF_IN_BA_L, HRTF_IN_BA_R, HRTF_IN_LFE,
+    HRTF_IN_NUM
+};
+
+/* Impulse responses, in the order in which they are stored in an
+   external HRIR file */
+enum {
+    HRIR_CF, HRIR_AF, HRIR_OF, HRIR_AR, HRIR_OR, HRIR_CR,
+    HRIR_NUM
+};
+
 typedef struct af_hrtf_s {
     /* Lengths */
-    int dlbuflen, hrflen, basslen;
+    int dlbuflen, basslen;
     /* L, C, R, Ls, Rs channels */
     float *lf, *rf, *lr, *rr, *cf, *cr;
-    const float *cf_ir, *af_ir, *of_ir, *ar_ir, *or_ir, *cr_ir;
-    int cf_o, af_o, of_o, ar_o, or_o, cr_o;
+    /* HRIRs and their length */
+    const float *ir[HRIR_NUM];
+    int irlen;
     /* Bass */
     float *ba_l, *ba_r;
     float *ba_ir;
+    /* Partitioned FFT convolution of all channels into L, R */
+    struct mp_fftconv *conv;
+    float *blk_in[HRTF_IN_NUM], *blk_out[2];
+    int blk_pos;
     /* Whether to matrix decode the rear center channel */
     int matrix_mode;
     /* How to decode the input:
@@ -72,43 +92,9 @@ typedef struct af_hrtf_s {
     int cyc_pos;
     int print_flag;
     int mode;
+    char *hrir_file;
 } af_hrtf_t;
 
-/* Convolution on a ring buffer
- *    nx:	length of the ring buffer
- *    nk:	length of the convolution kernel
- *    sx:	ring buffer
- *    sk:	convolution kernel
- *    offset:	offset on the ring buffer, can be
- */
-static float conv(const int nx, const int nk, const float *sx, const float *sk,
-		  const int offset)
-{
-    /* k = reminder of offset / nx */
-    int k = offset >= 0 ? offset % nx : nx + (offset % nx);
-
-    if(nk + k <= nx)
-	return af_filter_fir(nk, sx + k, sk);
-    else
-	return af_filter_fir(nk + k - nx, sx, sk + nx - k) +
-	    af_filter_fir(nx - k, sx + k, sk);
-}
-
-/* Detect when the impulse response starts (significantly) */
-static int pulse_detect(const float *sx)
-{
-    /* nmax must be the reference impulse response length (128) minus
-       s->hrflen */
-    const int nmax = 128 - HRTFFILTLEN;
-    const float thresh = IRTHRESH;
-    int i;
-
-    for(i = 0; i < nmax; i++)
-	if(fabs(sx[i]) > thresh)
-	    return i;
-    return 0;
-}
-
 /* Fuzzy matrix coefficient transfer function to "lock" the matrix on
    a effectively passive mode if the gain is approximately 1 */
 static inline float passive_lock(float x)
@@ -284,6 +270,103 @@ static inline void update_ch(af_hrtf_t *s, short *in, const int k)
     s->ba_r[k] = in[4] + in[1] + in[3];
 }
 
+/* Drop the partially filled input block and the pending output block */
+static void clear_blocks(af_hrtf_t *s)
+{
+    for(int i = 0; i < HRTF_IN_NUM; i++)
+	memset(s->blk_in[i], 0, HRTFBLOCKLEN * sizeof(float));
+    for(int i = 0; i < 2; i++)
+	memset(s->blk_out[i], 0, HRTFBLOCKLEN * sizeof(float));
+    s->blk_pos = 0;
+}
+
+/* Set up the convolution engine for the current decoding mode. All
+   HRIR and bass compensation filtering is linear, so the complete
+   mixing matrix is folded into the impulse responses of the engine:
+   each input channel is transformed once per block, and each output
+   ear needs a single inverse transform. */
+static int setup_conv(struct af_instance *af, int nch)
+{
+    af_hrtf_t *s = af->priv;
+    const float rear_gain = s->matrix_mode ? M1_76DB : 1;
+    const float lfe_ir = M3_01DB;
+    float fc;
+    int i;
+
+    fc = 2.0 * BASSFILTFREQ / (float)af->data->rate;
+    if(af_filter_design_fir(s->basslen, s->ba_ir, &fc, LP | KAISER, 4 * M_PI) ==
+       -1) {
+	MP_ERR(af, "[hrtf] Unable to design low-pass "
+	       "filter.\n");
+	return -1;
+    }
+    for(i = 0; i < s->basslen; i++)
+	s->ba_ir[i] *= BASSGAIN;
+
+    if(!s->conv) {
+	s->conv = mp_fftconv_create(af, HRTFBLOCKLEN,
+				    FFMAX(s->irlen, s->basslen),
+				    HRTF_IN_NUM, 2);
+	if(!s->conv)
+	    return -1;
+    }
+    mp_fftconv_clear_ir(s->conv);
+    mp_fftconv_reset(s->conv);
+
+    /* Front channels: same side (A) and opposite side (O) HRIR */
+    mp_fftconv_add_ir(s->conv, HRTF_IN_LF, 0, s->ir[HRIR_AF], s->irlen, 1);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_RF, 0, s->ir[HRIR_OF], s->irlen, 1);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_RF, 1, s->ir[HRIR_AF], s->irlen, 1);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_LF, 1, s->ir[HRIR_OF], s->irlen, 1);
+
+    if(s->decode_mode != HRTF_MIX_STEREO) {
+	mp_fftconv_add_ir(s->conv, HRTF_IN_CF, 0, s->ir[HRIR_CF], s->irlen, 1);
+	mp_fftconv_add_ir(s->conv, HRTF_IN_CF, 1, s->ir[HRIR_CF], s->irlen, 1);
+	/* In matrix decoding mode, the rear channel gain must be
+	   renormalized, as there is an additional channel. */
+	mp_fftconv_add_ir(s->conv, HRTF_IN_LR, 0, s->ir[HRIR_AR], s->irlen,
+			  rear_gain);
+	mp_fftconv_add_ir(s->conv, HRTF_IN_RR, 0, s->ir[HRIR_OR], s->irlen,
+			  rear_gain);
+	mp_fftconv_add_ir(s->conv, HRTF_IN_RR, 1, s->ir[HRIR_AR], s->irlen,
+			  rear_gain);
+	mp_fftconv_add_ir(s->conv, HRTF_IN_LR, 1, s->ir[HRIR_OR], s->irlen,
+			  rear_gain);
+	if(s->matrix_mode) {
+	    mp_fftconv_add_ir(s->conv, HRTF_IN_CR, 0, s->ir[HRIR_CR],
+			      s->irlen, M1_76DB);
+	    mp_fftconv_add_ir(s->conv, HRTF_IN_CR, 1, s->ir[HRIR_CR],
+			      s->irlen, M1_76DB);
+	}
+    }
+
+    /* Bass compensation for the lower frequency cut of the HRTF.  A
+       cross talk of the left and right channel is introduced to
+       match the directional characteristics of higher frequencies.
+       The bass will not have any real 3D perception, but that is
+       OK (note at 180 Hz, the wavelength is about 2 m, and any
+       spatial perception is impossible). */
+    mp_fftconv_add_ir(s->conv, HRTF_IN_BA_L, 0, s->ba_ir, s->basslen,
+		      1 - BASSCROSS);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_BA_R, 0, s->ba_ir, s->basslen,
+		      BASSCROSS);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_BA_R, 1, s->ba_ir, s->basslen,
+		      1 - BASSCROSS);
+    mp_fftconv_add_ir(s->conv, HRTF_IN_BA_L, 1, s->ba_ir, s->basslen,
+		      BASSCROSS);
+
+    /* Also mix the LFE channel (if available) */
+    if(nch >= 6) {
+	mp_fftconv_add_ir(s->conv, HRTF_IN_LFE, 0, &lfe_ir, 1, 1);
+	mp_fftconv_add_ir(s->conv, HRTF_IN_LFE, 1, &lfe_ir, 1, 1);
+    }
+
+    clear_blocks(s);
+
+    af->delay = HRTFBLOCKLEN / (double)af->data->rate;
+    return 0;
+}
+
 /* Initialization and runtime control */
 static int control(struct af_instance *af, int cmd, void* arg)
 {
@@ -311,11 +394,21 @@ static int control(struct af_instance *af, int cmd, void* arg)
 	    else if (af->data->nch < 5)
 	      mp_audio_set_channels_old(af->data, 5);
         mp_audio_set_format(af->data, AF_FORMAT_S16);
+	if(setup_conv(af, af->data->nch) < 0) {
+	    MP_ERR(af, "[hrtf] Unable to initialize FFT convolution.\n");
+	    return AF_ERROR;
+	}
 	test_output_res = af_test_output(af, (struct mp_audio*)arg);
 	// after testing input set the real output format
         mp_audio_set_num_channels(af->data, 2);
 	s->print_flag = 1;
 	return test_output_res;
+    case AF_CONTROL_RESET:
+	if(s->conv) {
+	    mp_fftconv_reset(s->conv);
+	    clear_blocks(s);
+	}
+	return AF_OK;
     }
 
     return AF_UNKNOWN;
@@ -326,6 +419,7 @@ static void uninit(struct af_instance *af)
 {
 	af_hrtf_t *s = af->priv;
 
+	talloc_free(s->conv);
 	free(s->lf);
 	free(s->rf);
 	free(s->lr);
@@ -339,6 +433,10 @@ static void uninit(struct af_instance *af)
 	free(s->fwrbuf_r);
 	free(s->fwrbuf_lr);
 	free(s->fwrbuf_rr);
+	for(int i = 0; i < HRTF_IN_NUM; i++)
+	    free(s->blk_in[i]);
+	free(s->blk_out[0]);
+	free(s->blk_out[1]);
 }
 
 /* Filter data through filter
@@ -351,6 +449,11 @@ frequencies).
 
 2. A bass compensation is introduced to ensure that 0-200 Hz are not
 damped (without any real 3D acoustical image, however).
+
+The per-sample work only builds the (matrix decoded) channel signals;
+the actual HRIR filtering is done block-wise by the FFT convolution
+engine set up in setup_conv(), which delays the output by
+HRTFBLOCKLEN samples.
 */
 static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 {
@@ -358,10 +461,10 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
     short *in = data->planes[0]; // Input audio data
     short *out = NULL; // Output audio data
     short *end = in + data->samples * data->nch; // Loop end
-    float common, left, right, diff, left_b, right_b;
-    const int dblen = s->dlbuflen, hlen = s->hrflen, blen = s->basslen;
+    float left, right, diff;
+    const int dblen = s->dlbuflen;
 
-    mp_audio_realloc_min(af->data, data->samples);
+    af_alloc_output(af, data->samples);
 
     if(s->print_flag) {
 	s->print_flag = 0;
@@ -411,6 +514,7 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 
     while(in < end) {
 	const int k = s->cyc_pos;
+	const int b = s->blk_pos;
 
 	update_ch(s, in, k);
 
@@ -421,80 +525,29 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 	s->lf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
 	s->rf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
 
-	switch (s->decode_mode) {
-	case HRTF_MIX_51:
-	case HRTF_MIX_MATRIX2CH:
-	   /* Mixer filter matrix */
-	   common = conv(dblen, hlen, s->cf, s->cf_ir, k + s->cf_o);
-	   if(s->matrix_mode) {
-	      /* In matrix decoding mode, the rear channel gain must be
-		 renormalized, as there is an additional channel. */
-	      matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
-			    s->lr_fwr, s->rr_fwr,
-			    s->lrprr_fwr, s->lrmrr_fwr,
-			    &(s->adapt_lr_gain), &(s->adapt_rr_gain),
-			    &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
-			    s->lr, s->rr, NULL, NULL, s->cr);
-	      common +=
-		 conv(dblen, hlen, s->cr, s->cr_ir, k + s->cr_o) *
-		 M1_76DB;
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	   } else {
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o) +
-		   common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o) +
-		   common);
-	   }
-	   break;
-	case HRTF_MIX_STEREO:
-	   left    =
-	      ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o));
-	   right   =
-	      ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o));
-	   break;
-	default:
-	    /* make gcc happy */
-	    left = 0.0;
-	    right = 0.0;
-	    break;
+	if(s->decode_mode != HRTF_MIX_STEREO && s->matrix_mode) {
+	    matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
+			  s->lr_fwr, s->rr_fwr,
+			  s->lrprr_fwr, s->lrmrr_fwr,
+			  &(s->adapt_lr_gain), &(s->adapt_rr_gain),
+			  &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
+			  s->lr, s->rr, NULL, NULL, s->cr);
 	}
 
-	/* Bass compensation for the lower frequency cut of the HRTF.  A
-	   cross talk of the left and right channel is introduced to
-	   match the directional characteristics of higher frequencies.
-	   The bass will not have any real 3D perception, but that is
-	   OK (note at 180 Hz, the wavelength is about 2 m, and any
-	   spatial perception is impossible). */
-	left_b  = conv(dblen, blen, s->ba_l, s->ba_ir, k);
-	right_b = conv(dblen, blen, s->ba_r, s->ba_ir, k);
-	left  += (1 - BASSCROSS) * left_b  + BASSCROSS * right_b;
-	right += (1 - BASSCROSS) * right_b + BASSCROSS * left_b;
-	/* Also mix the LFE channel (if available) */
-	if(data->nch >= 6) {
-	    left  += in[5] * M3_01DB;
-	    right += in[5] * M3_01DB;
-	}
+	/* Feed the current sample of every channel to the mixer filter
+	   matrix (see setup_conv()) */
+	s->blk_in[HRTF_IN_LF][b] = s->lf[k];
+	s->blk_in[HRTF_IN_RF][b] = s->rf[k];
+	s->blk_in[HRTF_IN_LR][b] = s->lr[k];
+	s->blk_in[HRTF_IN_RR][b] = s->rr[k];
+	s->blk_in[HRTF_IN_CF][b] = s->cf[k];
+	s->blk_in[HRTF_IN_CR][b] = s->cr[k];
+	s->blk_in[HRTF_IN_BA_L][b] = s->ba_l[k];
+	s->blk_in[HRTF_IN_BA_R][b] = s->ba_r[k];
+	s->blk_in[HRTF_IN_LFE][b] = data->nch >= 6 ? in[5] : 0;
+
+	left  = s->blk_out[0][b];
+	right = s->blk_out[1][b];
 
 	/* Amplitude renormalization. */
 	left  *= AMPLNORM;
@@ -520,6 +573,13 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 	   break;
 	}
 
+	/* Run the convolution once a full block was gathered */
+	s->blk_pos++;
+	if(s->blk_pos == HRTFBLOCKLEN) {
+	    mp_fftconv_process(s->conv, s->blk_in, s->blk_out);
+	    s->blk_pos = 0;
+	}
+
 	/* Next sample... */
 	in = &in[data->nch];
 	out = &out[af->data->nch];
@@ -535,8 +595,57 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
     return 0;
 }
 
+/* Load an external HRIR set. The file contains raw native endian 32
+   bit float samples at 48 kHz, with the 6 impulse responses
+   interleaved like the channels of an audio file, in the order
+   center front, same side front, opposite side front, same side
+   rear, opposite side rear, center rear. */
+static int load_hrir(struct af_instance *af, const char *filename)
+{
+    af_hrtf_t *s = af->priv;
+    float *buf;
+    long size;
+    int i, j, len;
+    FILE *f = fopen(filename, "rb");
+
+    if(!f) {
+	MP_ERR(af, "[hrtf] Can't open HRIR file '%s'.\n", filename);
+	return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    len = size / (HRIR_NUM * sizeof(float));
+    if(len < 1 || len > HRIRMAXLEN) {
+	MP_ERR(af, "[hrtf] HRIR file '%s' has invalid size.\n", filename);
+	fclose(f);
+	return -1;
+    }
+    buf = talloc_array(af, float, len * HRIR_NUM);
+    if(fread(buf, sizeof(float) * HRIR_NUM, len, f) != (size_t)len) {
+	MP_ERR(af, "[hrtf] Error reading HRIR file '%s'.\n", filename);
+	fclose(f);
+	return -1;
+    }
+    fclose(f);
+
+    for(i = 0; i < HRIR_NUM; i++) {
+	float *ir = talloc_array(af, float, len);
+	for(j = 0; j < len; j++)
+	    ir[j] = buf[j * HRIR_NUM + i];
+	s->ir[i] = ir;
+    }
+    talloc_free(buf);
+    s->irlen = len;
+    MP_VERBOSE(af, "[hrtf] Loaded %d samples long HRIRs from '%s'.\n",
+	       len, filename);
+    return 0;
+}
+
 static int allocate(af_hrtf_t *s)
 {
+    int i;
+
     if ((s->lf = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->rf = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->lr = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
@@ -545,6 +654,7 @@ static int allocate(af_hrtf_t *s)
     if ((s->cr = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->ba_l = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->ba_r = malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
+    if ((s->ba_ir = malloc(s->basslen * sizeof(float))) == NULL) return -1;
     if ((s->fwrbuf_l =
 	 malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->fwrbuf_r =
@@ -553,6 +663,12 @@ static int allocate(af_hrtf_t *s)
 	 malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
     if ((s->fwrbuf_rr =
 	 malloc(s->dlbuflen * sizeof(float))) == NULL) return -1;
+    for(i = 0; i < HRTF_IN_NUM; i++)
+	if ((s->blk_in[i] =
+	     malloc(HRTFBLOCKLEN * sizeof(float))) == NULL) return -1;
+    for(i = 0; i < 2; i++)
+	if ((s->blk_out[i] =
+	     malloc(HRTFBLOCKLEN * sizeof(float))) == NULL) return -1;
     return 0;
 }
 
@@ -561,16 +677,15 @@ static int af_open(struct af_instance* af)
 {
     int i;
     af_hrtf_t *s;
-    float fc;
 
     af->control = control;
     af->uninit = uninit;
     af->filter = filter;
+    af->out_of_place = true;
 
     s = af->priv;
 
     s->dlbuflen = DELAYBUFLEN;
-    s->hrflen = HRTFFILTLEN;
     s->basslen = BASSFILTLEN;
 
     s->cyc_pos = s->dlbuflen - 1;
@@ -606,26 +721,18 @@ static int af_open(struct af_instance* af)
     s->lr_fwr =
 	s->rr_fwr = 0;
 
-    s->cf_ir = cf_filt + (s->cf_o = pulse_detect(cf_filt));
-    s->af_ir = af_filt + (s->af_o = pulse_detect(af_filt));
-    s->of_ir = of_filt + (s->of_o = pulse_detect(of_filt));
-    s->ar_ir = ar_filt + (s->ar_o = pulse_detect(ar_filt));
-    s->or_ir = or_filt + (s->or_o = pulse_detect(or_filt));
-    s->cr_ir = cr_filt + (s->cr_o = pulse_detect(cr_filt));
-
-    if((s->ba_ir = malloc(s->basslen * sizeof(float))) == NULL) {
- 	MP_ERR(af, "[hrtf] Memory allocation error.\n");
-	return AF_ERROR;
-    }
-    fc = 2.0 * BASSFILTFREQ / (float)af->data->rate;
-    if(af_filter_design_fir(s->basslen, s->ba_ir, &fc, LP | KAISER, 4 * M_PI) ==
-       -1) {
-	MP_ERR(af, "[hrtf] Unable to design low-pass "
-	       "filter.\n");
-	return AF_ERROR;
+    if(s->hrir_file && s->hrir_file[0]) {
+	if(load_hrir(af, s->hrir_file) < 0)
+	    return AF_ERROR;
+    } else {
+	s->ir[HRIR_CF] = cf_filt;
+	s->ir[HRIR_AF] = af_filt;
+	s->ir[HRIR_OF] = of_filt;
+	s->ir[HRIR_AR] = ar_filt;
+	s->ir[HRIR_OR] = or_filt;
+	s->ir[HRIR_CR] = cr_filt;
+	s->irlen = HRIRLEN;
     }
-    for(i = 0; i < s->basslen; i++)
-	s->ba_ir[i] *= BASSGAIN;
 
     return AF_OK;
 }
@@ -638,6 +745,7 @@ struct af_info af_info_hrtf = {
     .priv_size = sizeof(af_hrtf_t),
     .options = (const struct m_option[]) {
         OPT_CHOICE("mode", mode, 0, ({"m", 0}, {"s", 1}, {"0", 2})),
+        OPT_STRING("hrir", hrir_file, 0),
         {0}
     },
 };
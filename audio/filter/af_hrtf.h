@@ -32,8 +32,10 @@
 #define M1_76DB		0.8164965809
 
 #define DELAYBUFLEN	1024	/* Length of the delay buffer */
-#define HRTFFILTLEN	64	/* HRTF filter length */
-#define IRTHRESH	0.001	/* Impulse response pruning thresh. */
+#define HRTFBLOCKLEN	128	/* FFT convolution block length (samples,
+				   also the latency of the filter) */
+#define HRIRLEN		128	/* Built-in HRIR length */
+#define HRIRMAXLEN	65536	/* Maximum external HRIR length */
 
 #define AMPLNORM	M6_99DB	/* Overall amplitude renormalization */
 
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
 #include <assert.h>
 
 #include <libavutil/opt.h>
@@ -86,8 +87,21 @@ struct af_resample {
     int reorder_in[MP_NUM_CHANNELS];
     int reorder_out[MP_NUM_CHANNELS];
     uint8_t *reorder_buffer;
+    // Playback speed factor applied on top of the configured rates with
+    // resampler compensation (see AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE).
+    double speed;
+    bool compensating;
 };
 
+// Maximum deviation of the speed factor from 1 that is applied by adjusting
+// the resampler step. Larger changes need reconfiguring the resampler, since
+// the lowpass cutoff isn't adjusted.
+#define MAX_SPEED_COMPENSATION 0.05
+// Number of output samples a compensation setting applies to. It is refreshed
+// on every filter() call, so it only has to be large enough to make rounding
+// of the sample delta to an integer negligible.
+#define COMPENSATION_DISTANCE (1 << 24)
+
 #if HAVE_LIBAVRESAMPLE
 static int get_delay(struct af_resample *s)
 {
@@ -97,6 +111,10 @@ static void drop_all_output(struct af_resample *s)
 {
     while (avresample_read(s->avrctx, NULL, 1000) > 0) {}
 }
+static int set_compensation(struct af_resample *s, int delta, int distance)
+{
+    return avresample_set_compensation(s->avrctx, delta, distance);
+}
 #else
 static int get_delay(struct af_resample *s)
 {
@@ -106,6 +124,10 @@ static void drop_all_output(struct af_resample *s)
 {
     while (swr_drop_output(s->avrctx, 1000) > 0) {}
 }
+static int set_compensation(struct af_resample *s, int delta, int distance)
+{
+    return swr_set_compensation(s->avrctx, delta, distance);
+}
 #endif
 
 static double af_resample_default_cutoff(int filter_size)
@@ -130,6 +152,24 @@ static bool needs_lavrctx_reconfigure(struct af_resample *s,
 
 }
 
+// Change the resampling step so that speed times the input is consumed per
+// output sample, without reinitializing the resampler.
+static int update_compensation(struct af_resample *s)
+{
+    if (s->speed == 1.0 && !s->compensating)
+        return 0;
+    int delta = lrint(COMPENSATION_DISTANCE * (1.0 - s->speed));
+    if (set_compensation(s, delta, COMPENSATION_DISTANCE) < 0)
+        return -1;
+    s->compensating = s->speed != 1.0;
+    return 0;
+}
+
+static double get_speed_mul(struct af_resample *s, int in_rate, int out_rate)
+{
+    return out_rate / (double)in_rate / s->speed;
+}
+
 static bool test_conversion(int src_format, int dst_format)
 {
     return af_to_avformat(src_format) != AV_SAMPLE_FMT_NONE &&
@@ -225,6 +265,12 @@ static int configure_lavrr(struct af_instance *af, struct mp_audio *in,
                 "Libavresample Context. \n");
         return AF_ERROR;
     }
+    // Opening resets the compensation.
+    s->compensating = false;
+    if (update_compensation(s) < 0) {
+        MP_WARN(af, "[lavrresample] Cannot apply speed factor %f.\n", s->speed);
+        s->speed = 1.0;
+    }
     return AF_OK;
 }
 
@@ -242,7 +288,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
         if (((out->rate    == in->rate) || (out->rate == 0)) &&
             (out->format   == in->format) &&
             (mp_chmap_equals(&out->channels, &in->channels) || out->nch == 0) &&
-            s->allow_detach)
+            s->speed == 1.0 && s->allow_detach)
             return AF_DETACH;
 
         if (out->rate == 0)
@@ -256,14 +302,14 @@ static int control(struct af_instance *af, int cmd, void *arg)
         if (af_to_avformat(out->format) == AV_SAMPLE_FMT_NONE)
             mp_audio_set_format(out, in->format);
 
-        af->mul     = out->rate / (double)in->rate;
-
         int r = ((in->format == orig_in.format) &&
                 mp_chmap_equals(&in->channels, &orig_in.channels))
                 ? AF_OK : AF_FALSE;
 
         if (r == AF_OK && needs_lavrctx_reconfigure(s, in, out))
             r = configure_lavrr(af, in, out);
+
+        af->mul     = get_speed_mul(s, in->rate, out->rate);
         return r;
     }
     case AF_CONTROL_SET_FORMAT: {
@@ -280,6 +326,19 @@ static int control(struct af_instance *af, int cmd, void *arg)
     case AF_CONTROL_SET_RESAMPLE_RATE:
         out->rate = *(int *)arg;
         return AF_OK;
+    case AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE: {
+        double speed = *(double *)arg;
+        if (fabs(speed - 1.0) > MAX_SPEED_COMPENSATION || !s->ctx.in_rate)
+            return AF_FALSE;
+        double old_speed = s->speed;
+        s->speed = speed;
+        if (update_compensation(s) < 0) {
+            s->speed = old_speed;
+            return AF_FALSE;
+        }
+        af->mul = get_speed_mul(s, s->ctx.in_rate, s->ctx.out_rate);
+        return AF_OK;
+    }
     case AF_CONTROL_RESET:
         drop_all_output(s);
         return AF_OK;
@@ -330,17 +389,29 @@ static void do_reorder(struct mp_audio *mpa, int *reorder)
 }
 #endif
 
+static int max_output_samples(struct af_instance *af, int in_samples)
+{
+    struct af_resample *s = af->priv;
+    int samples = av_rescale_rnd(get_delay(s) + in_samples,
+                                 s->ctx.out_rate, s->ctx.in_rate, AV_ROUND_UP);
+    if (s->speed != 1.0)
+        samples = ceil(samples / s->speed) + 1;
+    return avresample_available(s->avrctx) + samples;
+}
+
 static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 {
     struct af_resample *s = af->priv;
     struct mp_audio *in   = data;
     struct mp_audio *out  = af->data;
 
-    out->samples = avresample_available(s->avrctx) +
-        av_rescale_rnd(get_delay(s) + in->samples,
-                       s->ctx.out_rate, s->ctx.in_rate, AV_ROUND_UP);
+    // Refresh the compensation before it runs out (see COMPENSATION_DISTANCE).
+    if (s->compensating)
+        update_compensation(s);
+
+    out->samples = max_output_samples(af, in->samples);
 
-    mp_audio_realloc_min(out, out->samples);
+    af_alloc_output(af, out->samples);
 
     af->delay = get_delay(s) / (double)s->ctx.in_rate;
 
@@ -387,6 +458,8 @@ static int af_open(struct af_instance *af)
     af->control = control;
     af->uninit  = uninit;
     af->filter  = filter;
+    af->out_of_place = true;
+    af->max_output_samples = max_output_samples;
 
     if (s->opts.cutoff <= 0.0)
         s->opts.cutoff = af_resample_default_cutoff(s->opts.filter_size);
@@ -419,6 +492,7 @@ struct af_info af_info_lavrresample = {
             .phase_shift = 10,
         },
         .allow_detach = 1,
+        .speed = 1.0,
     },
     .options = (const struct m_option[]) {
         OPT_INTRANGE("filter-size", opts.filter_size, 0, 0, 32),
@@ -120,7 +120,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags)
   int		ncho = l->nch;		// Number of output channels
   register int  j,k;
 
-  mp_audio_realloc_min(af->data, data->samples);
+  af_alloc_output(af, data->samples);
 
   out = l->planes[0];
   // Execute panning
@@ -148,6 +148,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags)
 static int af_open(struct af_instance* af){
     af->control=control;
     af->filter=filter;
+    af->out_of_place = true;
     af_pan_t *s = af->priv;
     int   n = 0;
     int   j,k;
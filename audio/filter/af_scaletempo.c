@@ -210,6 +210,12 @@ static void output_overlap_s16(af_scaletempo_t *s, void *buf_out,
     }
 }
 
+static int max_output_samples(struct af_instance *af, int in_samples)
+{
+    af_scaletempo_t *s = af->priv;
+    return ((int)(in_samples / s->frames_stride_scaled) + 1) * s->frames_stride;
+}
+
 // Filter data through filter
 static int filter(struct af_instance *af, struct mp_audio *data, int flags)
 {
@@ -220,8 +226,7 @@ static int filter(struct af_instance *af, struct mp_audio *data, int flags)
         return 0;
     }
 
-    mp_audio_realloc_min(af->data,
-        ((int)(data->samples / s->frames_stride_scaled) + 1) * s->frames_stride);
+    af_alloc_output(af, max_output_samples(af, data->samples));
 
     int offset_in = fill_queue(af, data, 0);
     int8_t *pout = af->data->planes[0];
@@ -286,6 +291,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
                 return AF_DETACH;
             af->delay = 0;
             af->mul = 1;
+            af->out_of_place = false;
             return af_test_output(af, data);
         }
 
@@ -302,6 +308,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
         s->frames_stride_error  = 0;
         af->mul = 1.0 / s->scale;
         af->delay = 0;
+        af->out_of_place = true;
 
         int frames_overlap = s->frames_stride * s->percent_overlap;
         if (frames_overlap <= 0) {
@@ -457,6 +464,7 @@ static int af_open(struct af_instance *af)
     af->control   = control;
     af->uninit    = uninit;
     af->filter    = filter;
+    af->max_output_samples = max_output_samples;
 
     s->speed_tempo = !!(s->speed_opt & SCALE_TEMPO);
     s->speed_pitch = !!(s->speed_opt & SCALE_PITCH);
@@ -152,7 +152,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags){
   int 		 ri  = s->ri;	// Read index for delay queue
   int 		 wi  = s->wi;	// Write index for delay queue
 
-  mp_audio_realloc_min(af->data, data->samples);
+  af_alloc_output(af, data->samples);
 
   out = af->data->planes[0];
 
@@ -225,6 +225,7 @@ static int filter(struct af_instance* af, struct mp_audio* data, int flags){
 static int af_open(struct af_instance* af){
   af->control=control;
   af->filter=filter;
+  af->out_of_place = true;
   return AF_OK;
 }
 
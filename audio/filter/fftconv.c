@@ -0,0 +1,197 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include <libavcodec/avfft.h>
+#include <libavutil/mem.h>
+
+#include "common/common.h"
+
+#include "fftconv.h"
+
+struct mp_fftconv {
+    int block;          // samples per partition/block
+    int fft_len;        // 2 * block
+    int num_parts;      // number of impulse response partitions
+    int num_in, num_out;
+    RDFTContext *fwd, *inv;
+    float *mem;         // single aligned allocation for all buffers below
+    float *acc;         // [fft_len] spectrum accumulator for an output
+    float **in_time;    // [num_in][fft_len] previous and current input block
+    // Frequency-domain delay line: spectra of the last num_parts input blocks
+    float **fdl;        // [num_in * num_parts][fft_len]
+    // Spectra of the impulse response partitions (pre-scaled for the IRDFT)
+    float **ir;         // [(in * num_out + out) * num_parts + part][fft_len]
+    bool *path_used;    // [in * num_out + out]
+    int fdl_pos;        // index of the most recent block in fdl
+};
+
+static void destroy(void *ptr)
+{
+    struct mp_fftconv *c = ptr;
+    if (c->fwd)
+        av_rdft_end(c->fwd);
+    if (c->inv)
+        av_rdft_end(c->inv);
+    av_free(c->mem);
+}
+
+struct mp_fftconv *mp_fftconv_create(void *talloc_ctx, int block_size,
+                                     int max_ir_len, int num_in, int num_out)
+{
+    int nbits = av_log2(block_size) + 1;
+    if (block_size < 2 || (1 << (nbits - 1)) != block_size || max_ir_len < 1 ||
+        num_in < 1 || num_out < 1)
+        return NULL;
+
+    struct mp_fftconv *c = talloc_zero(talloc_ctx, struct mp_fftconv);
+    talloc_set_destructor(c, destroy);
+    c->block = block_size;
+    c->fft_len = block_size * 2;
+    c->num_parts = (max_ir_len + block_size - 1) / block_size;
+    c->num_in = num_in;
+    c->num_out = num_out;
+
+    c->fwd = av_rdft_init(nbits, DFT_R2C);
+    c->inv = av_rdft_init(nbits, IDFT_C2R);
+
+    int num_paths = num_in * num_out;
+    int num_bufs = 1 + num_in + num_in * c->num_parts
+                   + num_paths * c->num_parts;
+    c->mem = av_mallocz(num_bufs * c->fft_len * sizeof(float));
+    if (!c->fwd || !c->inv || !c->mem) {
+        talloc_free(c);
+        return NULL;
+    }
+
+    float *p = c->mem;
+    c->acc = p;
+    p += c->fft_len;
+    c->in_time = talloc_array(c, float *, num_in);
+    for (int n = 0; n < num_in; n++) {
+        c->in_time[n] = p;
+        p += c->fft_len;
+    }
+    c->fdl = talloc_array(c, float *, num_in * c->num_parts);
+    for (int n = 0; n < num_in * c->num_parts; n++) {
+        c->fdl[n] = p;
+        p += c->fft_len;
+    }
+    c->ir = talloc_array(c, float *, num_paths * c->num_parts);
+    for (int n = 0; n < num_paths * c->num_parts; n++) {
+        c->ir[n] = p;
+        p += c->fft_len;
+    }
+    c->path_used = talloc_zero_array(c, bool, num_paths);
+
+    return c;
+}
+
+int mp_fftconv_get_block_size(struct mp_fftconv *c)
+{
+    return c->block;
+}
+
+void mp_fftconv_add_ir(struct mp_fftconv *c, int in, int out,
+                       const float *ir, int len, float gain)
+{
+    assert(in >= 0 && in < c->num_in && out >= 0 && out < c->num_out);
+    assert(len <= c->num_parts * c->block);
+
+    int path = in * c->num_out + out;
+    // The inverse RDFT scales by fft_len / 2; compensate for it here.
+    gain *= 2.0f / c->fft_len;
+    for (int part = 0; part * c->block < len; part++) {
+        float *dst = c->ir[path * c->num_parts + part];
+        float *tmp = c->acc;
+        int n = MPMIN(c->block, len - part * c->block);
+        for (int i = 0; i < n; i++)
+            tmp[i] = ir[part * c->block + i] * gain;
+        memset(tmp + n, 0, (c->fft_len - n) * sizeof(float));
+        av_rdft_calc(c->fwd, tmp);
+        for (int i = 0; i < c->fft_len; i++)
+            dst[i] += tmp[i];
+    }
+    c->path_used[path] = true;
+}
+
+void mp_fftconv_clear_ir(struct mp_fftconv *c)
+{
+    int num_paths = c->num_in * c->num_out;
+    for (int n = 0; n < num_paths * c->num_parts; n++)
+        memset(c->ir[n], 0, c->fft_len * sizeof(float));
+    for (int n = 0; n < num_paths; n++)
+        c->path_used[n] = false;
+}
+
+void mp_fftconv_reset(struct mp_fftconv *c)
+{
+    for (int n = 0; n < c->num_in; n++)
+        memset(c->in_time[n], 0, c->fft_len * sizeof(float));
+    for (int n = 0; n < c->num_in * c->num_parts; n++)
+        memset(c->fdl[n], 0, c->fft_len * sizeof(float));
+    c->fdl_pos = 0;
+}
+
+// acc += a * b, with a and b in the packed format returned by av_rdft_calc():
+// DC and Nyquist bins are real and stored in [0] and [1], followed by the
+// complex bins as (re, im) pairs.
+static void spectrum_mul_add(float *acc, const float *a, const float *b, int len)
+{
+    acc[0] += a[0] * b[0];
+    acc[1] += a[1] * b[1];
+    for (int i = 2; i < len; i += 2) {
+        acc[i + 0] += a[i] * b[i]     - a[i + 1] * b[i + 1];
+        acc[i + 1] += a[i] * b[i + 1] + a[i + 1] * b[i];
+    }
+}
+
+void mp_fftconv_process(struct mp_fftconv *c, float **in, float **out)
+{
+    int block = c->block;
+    int parts = c->num_parts;
+
+    c->fdl_pos = (c->fdl_pos + 1) % parts;
+
+    for (int n = 0; n < c->num_in; n++) {
+        float *t = c->in_time[n];
+        memmove(t, t + block, block * sizeof(float));
+        memcpy(t + block, in[n], block * sizeof(float));
+        float *spec = c->fdl[n * parts + c->fdl_pos];
+        memcpy(spec, t, c->fft_len * sizeof(float));
+        av_rdft_calc(c->fwd, spec);
+    }
+
+    for (int o = 0; o < c->num_out; o++) {
+        memset(c->acc, 0, c->fft_len * sizeof(float));
+        for (int n = 0; n < c->num_in; n++) {
+            int path = n * c->num_out + o;
+            if (!c->path_used[path])
+                continue;
+            for (int part = 0; part < parts; part++) {
+                int pos = (c->fdl_pos - part + parts) % parts;
+                spectrum_mul_add(c->acc, c->fdl[n * parts + pos],
+                                 c->ir[path * parts + part], c->fft_len);
+            }
+        }
+        av_rdft_calc(c->inv, c->acc);
+        // Overlap-save: the first half is circular convolution garbage.
+        memcpy(out[o], c->acc + block, block * sizeof(float));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_FFTCONV_H
+#define MP_FFTCONV_H
+
+// Uniformly partitioned FFT convolution (overlap-save) of num_in input
+// signals with a matrix of impulse responses, mixed into num_out outputs.
+// Every (input, output) pair can have its own impulse response. The cost per
+// sample is O(log(block_size) + ir_len / block_size) instead of O(ir_len).
+// Processing introduces a latency of exactly block_size samples if the caller
+// feeds it one block at a time (as the output of a block is only available
+// once the whole block was input).
+
+struct mp_fftconv;
+
+// block_size must be a power of 2. max_ir_len is the maximum length of any
+// impulse response that will be added with mp_fftconv_add_ir().
+// Returns NULL if the parameters are invalid or the FFT can't be set up.
+struct mp_fftconv *mp_fftconv_create(void *talloc_ctx, int block_size,
+                                     int max_ir_len, int num_in, int num_out);
+
+// Add the impulse response ir[0..len-1], scaled by gain, to the path from
+// input in to output out. Adding multiple responses to the same path sums
+// them. len must not be larger than max_ir_len.
+void mp_fftconv_add_ir(struct mp_fftconv *c, int in, int out,
+                       const float *ir, int len, float gain);
+
+// Remove all impulse responses.
+void mp_fftconv_clear_ir(struct mp_fftconv *c);
+
+// Forget all previously input audio (e.g. after seeking).
+void mp_fftconv_reset(struct mp_fftconv *c);
+
+int mp_fftconv_get_block_size(struct mp_fftconv *c);
+
+// Process exactly block_size samples. in[n] points to the samples for input
+// n, and out[n] is filled with block_size samples of output n.
+void mp_fftconv_process(struct mp_fftconv *c, float **in, float **out);
+
+#endif
@@ -29,6 +29,8 @@
 
 #include "options/options.h"
 #include "options/m_config.h"
+#include "osdep/timer.h"
+#include "compat/atomics.h"
 #include "common/msg.h"
 #include "common/global.h"
 
@@ -165,6 +167,7 @@ static struct ao *ao_create(bool probing, struct mpv_global *global,
     if (!af_fmt_is_planar(ao->format))
         ao->sstride *= ao->channels.num;
     ao->bps = ao->samplerate * ao->sstride;
+    ao->stats.last_log = mp_time_sec();
     return ao;
 error:
     talloc_free(ao);
@@ -211,13 +214,26 @@ done:
 
 void ao_uninit(struct ao *ao, bool cut_audio)
 {
+    ao_print_stats(ao, MSGL_V);
     ao->driver->uninit(ao, cut_audio);
     talloc_free(ao);
 }
 
 int ao_play(struct ao *ao, void **data, int samples, int flags)
 {
-    return ao->driver->play(ao, data, samples, flags);
+    struct ao_stats *st = &ao->stats;
+    int64_t start = mp_time_us();
+    int r = ao->driver->play(ao, data, samples, flags);
+    int64_t end = mp_time_us();
+    st->play_time += (end - start) / 1e6;
+    if (r > 0) {
+        st->periods_written++;
+        st->samples_written += r;
+    }
+    double interval = ao->opts->ao_stats_interval;
+    if (interval > 0 && end / 1e6 - st->last_log >= interval)
+        ao_print_stats(ao, MSGL_INFO);
+    return r;
 }
 
 int ao_control(struct ao *ao, enum aocontrol cmd, void *arg)
@@ -233,7 +249,17 @@ double ao_get_delay(struct ao *ao)
         assert(ao->untimed);
         return 0;
     }
-    return ao->driver->get_delay(ao);
+    double delay = ao->driver->get_delay(ao);
+    // The player queries this frequently, so it's a cheap way to sample the
+    // buffer fill without adding extra calls into the driver.
+    struct ao_stats *st = &ao->stats;
+    if (!st->fill_count || delay < st->fill_min)
+        st->fill_min = delay;
+    if (!st->fill_count || delay > st->fill_max)
+        st->fill_max = delay;
+    st->fill_sum += delay;
+    st->fill_count++;
+    return delay;
 }
 
 int ao_get_space(struct ao *ao)
@@ -273,6 +299,29 @@ int ao_play_silence(struct ao *ao, int samples)
     return r;
 }
 
+void ao_report_underrun(struct ao *ao)
+{
+    mp_atomic_add_and_fetch(&ao->stats.underruns, 1);
+}
+
+void ao_report_xrun_recovered(struct ao *ao)
+{
+    mp_atomic_add_and_fetch(&ao->stats.xruns_recovered, 1);
+}
+
+void ao_print_stats(struct ao *ao, int msgl)
+{
+    struct ao_stats *st = &ao->stats;
+    double avg = st->fill_count ? st->fill_sum / st->fill_count : 0;
+    MP_MSG(ao, msgl, "Stats: %d underruns, %d xruns recovered, %"PRId64" periods, "
+            "buffer %.3f/%.3f/%.3f s (min/avg/max), %.3f s blocked in play\n",
+            mp_atomic_load_acquire(&st->underruns),
+            mp_atomic_load_acquire(&st->xruns_recovered),
+            st->periods_written, st->fill_min, avg, st->fill_max,
+            st->play_time);
+    st->last_log = mp_time_sec();
+}
+
 bool ao_chmap_sel_adjust(struct ao *ao, const struct mp_chmap_sel *s,
                          struct mp_chmap *map)
 {
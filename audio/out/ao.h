@@ -47,6 +47,19 @@ typedef struct ao_control_vol {
 
 struct ao;
 
+// Playback statistics, see ao_report_underrun(), ao_play() and ao_get_delay().
+struct ao_stats {
+    int underruns;              // buffer ran empty (reported by the driver)
+    int xruns_recovered;        // driver restarted the device after an error
+    int64_t periods_written;    // number of ao_play() calls that wrote data
+    int64_t samples_written;
+    // Buffer fill in seconds, sampled on each ao_get_delay() call.
+    double fill_min, fill_max, fill_sum;
+    int64_t fill_count;
+    double play_time;           // time spent blocked in ao_play() (seconds)
+    double last_log;            // time of the last stats log line
+};
+
 struct ao_driver {
     bool encode;
     const char *name;
@@ -89,6 +102,7 @@ struct ao {
     struct MPOpts *opts;
     struct input_ctx *input_ctx;
     struct mp_log *log; // Using e.g. "[ao/coreaudio]" as prefix
+    struct ao_stats stats;
 };
 
 struct mpv_global;
@@ -107,6 +121,11 @@ void ao_resume(struct ao *ao);
 
 int ao_play_silence(struct ao *ao, int samples);
 
+// Can be called by the driver from any thread (e.g. an audio callback).
+void ao_report_underrun(struct ao *ao);
+void ao_report_xrun_recovered(struct ao *ao);
+void ao_print_stats(struct ao *ao, int msgl);
+
 bool ao_chmap_sel_adjust(struct ao *ao, const struct mp_chmap_sel *s,
                          struct mp_chmap *map);
 bool ao_chmap_sel_get_def(struct ao *ao, const struct mp_chmap_sel *s,
@@ -57,6 +57,7 @@ struct priv {
     float delay_before_pause;
     int buffersize; // in frames
     int outburst; // in frames
+    bool underrun; // underrun was reported, cleared on the next write
 
     int cfg_block;
     char *cfg_device;
@@ -602,6 +603,14 @@ static void audio_resume(struct ao *ao)
 alsa_error: ;
 }
 
+static void report_underrun(struct ao *ao)
+{
+    struct priv *p = ao->priv;
+    if (!p->underrun)
+        ao_report_underrun(ao);
+    p->underrun = true;
+}
+
 /* stop playing and empty buffers (for seeking/pause) */
 static void reset(struct ao *ao)
 {
@@ -610,6 +619,7 @@ static void reset(struct ao *ao)
 
     p->prepause_frames = 0;
     p->delay_before_pause = 0;
+    p->underrun = false;
     err = snd_pcm_drop(p->alsa);
     CHECK_ALSA_ERROR("pcm prepare error");
     err = snd_pcm_prepare(p->alsa);
@@ -642,16 +652,24 @@ static int play(struct ao *ao, void **data, int samples, int flags)
             MP_INFO(ao, "PCM in suspend mode, trying to resume.\n");
             while ((res = snd_pcm_resume(p->alsa)) == -EAGAIN)
                 sleep(1);
+            if (res == 0)
+                ao_report_xrun_recovered(ao);
         }
         if (res < 0) {
             MP_ERR(ao, "Write error: %s\n", snd_strerror(res));
+            if (res == -EPIPE)
+                report_underrun(ao);
             res = snd_pcm_prepare(p->alsa);
             int err = res;
             CHECK_ALSA_ERROR("pcm prepare error");
+            ao_report_xrun_recovered(ao);
             res = 0;
         }
     } while (res == 0);
 
+    // Running out of data after the final chunk is not an underrun.
+    p->underrun = flags & AOPLAY_FINAL_CHUNK;
+
     return res < 0 ? -1 : res;
 
 alsa_error:
@@ -671,8 +689,10 @@ static int get_space(struct ao *ao)
     CHECK_ALSA_ERROR("cannot get pcm status");
 
     unsigned space = snd_pcm_status_get_avail(status);
-    if (space > p->buffersize) // Buffer underrun?
+    if (space > p->buffersize) { // Buffer underrun?
+        report_underrun(ao);
         space = p->buffersize;
+    }
     return space;
 
 alsa_error:
@@ -693,6 +713,7 @@ static float get_delay(struct ao *ao)
 
     if (delay < 0) {
         /* underrun - move the application pointer forward to catch up */
+        report_underrun(ao);
         snd_pcm_forward(p->alsa, -delay);
         delay = 0;
     }
@@ -114,6 +114,7 @@ static OSStatus render_cb_lpcm(void *ctx, AudioUnitRenderActionFlags *aflags,
 
     if (mp_ring_buffered(p->buffer) < requested) {
         MP_VERBOSE(ao, "buffer underrun\n");
+        ao_report_underrun(ao);
         audio_pause(ao);
         memset(buf.mData, 0, requested);
     } else {
@@ -578,6 +578,7 @@ static int check_free_buffer_size(struct ao *ao)
     // and the buffer is only half-filled.
     if (space < p->underrun_check) {
         // there's no useful data in the buffers
+        ao_report_underrun(ao);
         space = p->buffer_size;
         reset(ao);
     }
@@ -128,8 +128,10 @@ process(jack_nframes_t nframes, void *arg)
             underrun = 1;
     }
 
-    if (underrun)
+    if (underrun) {
+        ao_report_underrun(ao);
         p->underrun = 1;
+    }
 
     if (p->estimate) {
         float now = mp_time_us() / 1000000.0;
@@ -40,14 +40,20 @@
 
 #include "common/encode_lavc.h"
 
+// Maximum number of audio frames queued for the encoder thread.
+#define ENCODE_QUEUE_SIZE 16
+
 struct priv {
+    // Only accessed by the encoder thread.
     uint8_t *buffer;
     size_t buffer_size;
+    int64_t savepts;
+
     AVStream *stream;
+    struct encode_worker *worker;
     int pcmhack;
     int aframesize;
     int aframecount;
-    int64_t savepts;
     int framecount;
     int64_t lastpts;
     int sample_size;
@@ -88,6 +94,8 @@ static void select_format(struct ao *ao, AVCodec *codec)
     }
 }
 
+static void process_job(void *priv, void *p);
+
 // open & setup audio device
 static int init(struct ao *ao)
 {
@@ -166,13 +174,16 @@ static int init(struct ao *ao)
     ac->savepts = MP_NOPTS_VALUE;
     ac->lastpts = MP_NOPTS_VALUE;
 
+    ac->worker = encode_worker_create(ao->encode_lavc_ctx, ENCODE_QUEUE_SIZE,
+                                      process_job, ao);
+
     ao->untimed = true;
 
     return 0;
 }
 
 // close audio device
-static int encode(struct ao *ao, double apts, void **data);
+static void encode(struct ao *ao, double apts, void **data);
 static void uninit(struct ao *ao, bool cut_audio)
 {
     struct priv *ac = ao->priv;
@@ -180,6 +191,7 @@ static void uninit(struct ao *ao, bool cut_audio)
 
     if (!encode_lavc_start(ectx)) {
         MP_WARN(ao, "not even ready to encode audio at end -> dropped");
+        encode_worker_destroy(ac->worker);
         return;
     }
 
@@ -188,9 +200,12 @@ static void uninit(struct ao *ao, bool cut_audio)
         if (!ectx->options->rawts && ectx->options->copyts)
             outpts += ectx->discontinuity_pts_offset;
         outpts += encode_lavc_getoffset(ectx, ac->stream);
-        while (encode(ao, outpts, NULL) > 0) ;
+        encode(ao, outpts, NULL);
     }
 
+    encode_worker_destroy(ac->worker);
+    ac->worker = NULL;
+
     ao->priv = NULL;
 }
 
@@ -202,68 +217,30 @@ static int get_space(struct ao *ao)
     return ac->aframesize * ac->framecount;
 }
 
-// must get exactly ac->aframesize amount of data
-static int encode(struct ao *ao, double apts, void **data)
+struct encode_job {
+    void *data[MP_NUM_CHANNELS];    // data[0] == NULL: flush the encoder
+    int64_t pts;                    // in codec time base
+    double apts, realapts;          // for logging only
+};
+
+// Encode the frame (or flush the encoder if frame is NULL), and write the
+// resulting packet. Runs on the encoder thread.
+// return: packet size, 0 if no packet was output, -1 on error
+static int encode_frame(struct ao *ao, AVFrame *frame, struct encode_job *job)
 {
-    AVFrame *frame;
     AVPacket packet;
     struct priv *ac = ao->priv;
-    struct encode_lavc_context *ectx = ao->encode_lavc_ctx;
-    double realapts = ac->aframecount * (double) ac->aframesize /
-                      ao->samplerate;
     int status, gotpacket;
 
-    ac->aframecount++;
-
-    if (data)
-        ectx->audio_pts_offset = realapts - apts;
-
     av_init_packet(&packet);
     packet.data = ac->buffer;
     packet.size = ac->buffer_size;
-    if(data)
-    {
-        frame = avcodec_alloc_frame();
-        frame->nb_samples = ac->aframesize;
-
-        assert(ao->channels.num <= AV_NUM_DATA_POINTERS);
-        for (int n = 0; n < ao->channels.num; n++)
-            frame->extended_data[n] = data[n];
 
-        frame->linesize[0] = frame->nb_samples * ao->sstride;
+    status = avcodec_encode_audio2(ac->stream->codec, &packet, frame, &gotpacket);
 
-        if (ectx->options->rawts || ectx->options->copyts) {
-            // real audio pts
-            frame->pts = floor(apts * ac->stream->codec->time_base.den / ac->stream->codec->time_base.num + 0.5);
-        } else {
-            // audio playback time
-            frame->pts = floor(realapts * ac->stream->codec->time_base.den / ac->stream->codec->time_base.num + 0.5);
-        }
-
-        int64_t frame_pts = av_rescale_q(frame->pts, ac->stream->codec->time_base, ac->worst_time_base);
-        if (ac->lastpts != MP_NOPTS_VALUE && frame_pts <= ac->lastpts) {
-            // this indicates broken video
-            // (video pts failing to increase fast enough to match audio)
-            MP_WARN(ao, "audio frame pts went backwards (%d <- %d), autofixed\n",
-                    (int)frame->pts, (int)ac->lastpts);
-            frame_pts = ac->lastpts + 1;
-            frame->pts = av_rescale_q(frame_pts, ac->worst_time_base, ac->stream->codec->time_base);
-        }
-        ac->lastpts = frame_pts;
-
-        frame->quality = ac->stream->codec->global_quality;
-        status = avcodec_encode_audio2(ac->stream->codec, &packet, frame, &gotpacket);
-
-        if (!status) {
-            if (ac->savepts == MP_NOPTS_VALUE)
-                ac->savepts = frame->pts;
-        }
-
-        avcodec_free_frame(&frame);
-    }
-    else
-    {
-        status = avcodec_encode_audio2(ac->stream->codec, &packet, NULL, &gotpacket);
+    if (frame && !status) {
+        if (ac->savepts == MP_NOPTS_VALUE)
+            ac->savepts = frame->pts;
     }
 
     if(status) {
@@ -275,7 +252,7 @@ static int encode(struct ao *ao, double apts, void **data)
         return 0;
 
     MP_DBG(ao, "got pts %f (playback time: %f); out size: %d\n",
-           apts, realapts, packet.size);
+           job->apts, job->realapts, packet.size);
 
     encode_lavc_write_stats(ao->encode_lavc_ctx, ac->stream);
 
@@ -304,7 +281,7 @@ static int encode(struct ao *ao, double apts, void **data)
 
     if (encode_lavc_write_frame(ao->encode_lavc_ctx, &packet) < 0) {
         MP_ERR(ao, "error writing at %f %f/%f\n",
-               realapts, (double) ac->stream->time_base.num,
+               job->realapts, (double) ac->stream->time_base.num,
                (double) ac->stream->time_base.den);
         return -1;
     }
@@ -312,6 +289,86 @@ static int encode(struct ao *ao, double apts, void **data)
     return packet.size;
 }
 
+// Runs on the encoder thread.
+static void process_job(void *priv, void *p)
+{
+    struct ao *ao = priv;
+    struct priv *ac = ao->priv;
+    struct encode_job *job = p;
+
+    if (job->data[0]) {
+        AVFrame *frame = avcodec_alloc_frame();
+        frame->nb_samples = ac->aframesize;
+
+        assert(ao->channels.num <= AV_NUM_DATA_POINTERS);
+        for (int n = 0; n < MP_NUM_CHANNELS && job->data[n]; n++)
+            frame->extended_data[n] = job->data[n];
+
+        frame->linesize[0] = frame->nb_samples * ao->sstride;
+        frame->pts = job->pts;
+        frame->quality = ac->stream->codec->global_quality;
+
+        encode_frame(ao, frame, job);
+
+        avcodec_free_frame(&frame);
+    } else {
+        while (encode_frame(ao, NULL, job) > 0) ;
+    }
+
+    talloc_free(job);
+}
+
+// must get exactly ac->aframesize amount of data
+// The data is copied and queued for the encoder thread.
+static void encode(struct ao *ao, double apts, void **data)
+{
+    struct priv *ac = ao->priv;
+    struct encode_lavc_context *ectx = ao->encode_lavc_ctx;
+    double realapts = ac->aframecount * (double) ac->aframesize /
+                      ao->samplerate;
+
+    ac->aframecount++;
+
+    struct encode_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct encode_job) {
+        .apts = apts,
+        .realapts = realapts,
+    };
+
+    if(data)
+    {
+        ectx->audio_pts_offset = realapts - apts;
+
+        size_t num_planes = af_fmt_is_planar(ao->format) ? ao->channels.num : 1;
+        for (int n = 0; n < num_planes; n++)
+            job->data[n] = talloc_memdup(job, data[n],
+                                         ac->aframesize * ao->sstride);
+
+        int64_t pts;
+        if (ectx->options->rawts || ectx->options->copyts) {
+            // real audio pts
+            pts = floor(apts * ac->stream->codec->time_base.den / ac->stream->codec->time_base.num + 0.5);
+        } else {
+            // audio playback time
+            pts = floor(realapts * ac->stream->codec->time_base.den / ac->stream->codec->time_base.num + 0.5);
+        }
+
+        int64_t frame_pts = av_rescale_q(pts, ac->stream->codec->time_base, ac->worst_time_base);
+        if (ac->lastpts != MP_NOPTS_VALUE && frame_pts <= ac->lastpts) {
+            // this indicates broken video
+            // (video pts failing to increase fast enough to match audio)
+            MP_WARN(ao, "audio frame pts went backwards (%d <- %d), autofixed\n",
+                    (int)pts, (int)ac->lastpts);
+            frame_pts = ac->lastpts + 1;
+            pts = av_rescale_q(frame_pts, ac->worst_time_base, ac->stream->codec->time_base);
+        }
+        ac->lastpts = frame_pts;
+        job->pts = pts;
+    }
+
+    encode_worker_queue(ac->worker, job);
+}
+
 // this should round samples down to frame sizes
 // return: number of samples played
 static int play(struct ao *ao, void **data, int samples, int flags)
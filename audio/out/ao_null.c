@@ -67,8 +67,10 @@ static void drain(struct ao *ao)
     if (priv->buffered > 0) {
         priv->buffered -= (now - priv->last_time) * ao->samplerate;
         if (priv->buffered < 0) {
-            if (!priv->playing_final)
+            if (!priv->playing_final) {
                 MP_ERR(ao, "buffer underrun\n");
+                ao_report_underrun(ao);
+            }
             priv->buffered = 0;
         }
     }
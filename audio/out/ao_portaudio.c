@@ -183,6 +183,7 @@ static int stream_callback(const void *input,
             priv->play_remaining = false;
         } else {
             MP_ERR(ao, "Buffer underflow!\n");
+            ao_report_underrun(ao);
         }
         fill_silence(output, len_bytes);
     }
@@ -145,6 +145,30 @@ static void mp_msg_av_log_callback(void *ptr, int level, const char *fmt,
     pthread_mutex_unlock(&log_lock);
 }
 
+// Needed for calling avcodec_open2() and avcodec_close() from multiple threads
+// (for example for writing images in the background).
+static int mp_av_lockmgr(void **mutex, enum AVLockOp op)
+{
+    switch (op) {
+    case AV_LOCK_CREATE:
+        *mutex = malloc(sizeof(pthread_mutex_t));
+        if (!*mutex)
+            return 1;
+        pthread_mutex_init(*mutex, NULL);
+        return 0;
+    case AV_LOCK_OBTAIN:
+        return !!pthread_mutex_lock(*mutex);
+    case AV_LOCK_RELEASE:
+        return !!pthread_mutex_unlock(*mutex);
+    case AV_LOCK_DESTROY:
+        pthread_mutex_destroy(*mutex);
+        free(*mutex);
+        *mutex = NULL;
+        return 0;
+    }
+    return 1;
+}
+
 void init_libav(struct mpv_global *global)
 {
     pthread_mutex_lock(&log_lock);
@@ -155,6 +179,7 @@ void init_libav(struct mpv_global *global)
         log_decvideo = mp_log_new(log_root, log_root, "video");
         log_demuxer = mp_log_new(log_root, log_root, "demuxer");
         av_log_set_callback(mp_msg_av_log_callback);
+        av_lockmgr_register(mp_av_lockmgr);
     }
     pthread_mutex_unlock(&log_lock);
 
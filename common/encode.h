@@ -16,8 +16,22 @@ void encode_lavc_free(struct encode_lavc_context *ctx);
 void encode_lavc_discontinuity(struct encode_lavc_context *ctx);
 bool encode_lavc_showhelp(struct mp_log *log, struct encode_output_conf *options);
 int encode_lavc_getstatus(struct encode_lavc_context *ctx, char *buf, int bufsize, float relative_position);
+
+struct encode_lavc_stats {
+    double elapsed;         // seconds since encoding started
+    unsigned int frames;
+    double audioseconds;
+    long long bytes;
+};
+void encode_lavc_format_status(char *buf, int bufsize,
+                               const struct encode_lavc_stats *st,
+                               float relative_position);
+// Write the stats to --oparallel-status-fd (set in parallel encoding workers).
+void encode_lavc_report_status(struct encode_lavc_context *ctx,
+                               float relative_position);
 void encode_lavc_expect_stream(struct encode_lavc_context *ctx, int mt);
 void encode_lavc_set_video_fps(struct encode_lavc_context *ctx, float fps);
 bool encode_lavc_didfail(struct encode_lavc_context *ctx); // check if encoding failed
+double encode_lavc_copy_end_pts(struct encode_lavc_context *ctx);
 
 #endif
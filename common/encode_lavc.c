@@ -20,6 +20,11 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
 #include <libavutil/avutil.h>
 
 #include "encode_lavc.h"
@@ -31,6 +36,8 @@
 #include "video/out/vo.h"
 #include "talloc.h"
 #include "stream/stream.h"
+#include "demux/packet.h"
+#include "demux/stheader.h"
 
 static int set_to_avdictionary(struct encode_lavc_context *ctx,
                                AVDictionary **dictp,
@@ -102,6 +109,151 @@ static bool value_has_flag(const char *value, const char *flag)
         return val; \
     }
 
+#define MUX_QUEUE_SIZE 64
+
+struct encode_worker {
+    struct encode_lavc_context *ctx;
+    void (*process)(void *priv, void *job);
+    void *priv;
+
+    pthread_t thread;
+    bool threaded;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    void **jobs;
+    int num_jobs;
+    int max_jobs;
+    bool busy;      // a job is currently being processed
+    bool terminate;
+};
+
+static void *worker_thread(void *arg)
+{
+    struct encode_worker *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+    while (1) {
+        if (w->num_jobs) {
+            void *job = w->jobs[0];
+            MP_TARRAY_REMOVE_AT(w->jobs, w->num_jobs, 0);
+            w->busy = true;
+            pthread_cond_broadcast(&w->wakeup);
+            pthread_mutex_unlock(&w->lock);
+            w->process(w->priv, job);
+            pthread_mutex_lock(&w->lock);
+            w->busy = false;
+            pthread_cond_broadcast(&w->wakeup);
+        } else if (w->terminate) {
+            break;
+        } else {
+            pthread_cond_wait(&w->wakeup, &w->lock);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static struct encode_worker *worker_create(struct encode_lavc_context *ctx,
+                                           int max_jobs,
+                                           void (*process)(void *, void *),
+                                           void *priv)
+{
+    // Not a child of ctx, because the thread allocates nothing from it.
+    struct encode_worker *w = talloc_ptrtype(NULL, w);
+    *w = (struct encode_worker) {
+        .ctx = ctx,
+        .process = process,
+        .priv = priv,
+        .max_jobs = max_jobs,
+    };
+    w->jobs = talloc_array(w, void *, max_jobs);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wakeup, NULL);
+    w->threaded = !pthread_create(&w->thread, NULL, worker_thread, w);
+    if (!w->threaded)
+        MP_WARN(ctx, "could not create encoder thread, encoding synchronously\n");
+    return w;
+}
+
+static void worker_free(struct encode_worker *w)
+{
+    if (w->threaded) {
+        pthread_mutex_lock(&w->lock);
+        w->terminate = true;
+        pthread_cond_broadcast(&w->wakeup);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+    }
+    assert(!w->num_jobs);
+    pthread_cond_destroy(&w->wakeup);
+    pthread_mutex_destroy(&w->lock);
+    talloc_free(w);
+}
+
+struct encode_worker *encode_worker_create(struct encode_lavc_context *ctx,
+                                           int max_jobs,
+                                           void (*process)(void *priv, void *job),
+                                           void *priv)
+{
+    struct encode_worker *w = worker_create(ctx, max_jobs, process, priv);
+    MP_TARRAY_APPEND(ctx, ctx->workers, ctx->num_workers, w);
+    return w;
+}
+
+void encode_worker_queue(struct encode_worker *w, void *job)
+{
+    if (!w->threaded) {
+        w->process(w->priv, job);
+        return;
+    }
+    pthread_mutex_lock(&w->lock);
+    while (w->num_jobs >= w->max_jobs)
+        pthread_cond_wait(&w->wakeup, &w->lock);
+    w->jobs[w->num_jobs++] = job;
+    pthread_cond_broadcast(&w->wakeup);
+    pthread_mutex_unlock(&w->lock);
+}
+
+void encode_worker_wait(struct encode_worker *w)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->num_jobs || w->busy)
+        pthread_cond_wait(&w->wakeup, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+}
+
+void encode_worker_destroy(struct encode_worker *w)
+{
+    if (!w)
+        return;
+    struct encode_lavc_context *ctx = w->ctx;
+    for (int n = 0; n < ctx->num_workers; n++) {
+        if (ctx->workers[n] == w) {
+            MP_TARRAY_REMOVE_AT(ctx->workers, ctx->num_workers, n);
+            break;
+        }
+    }
+    worker_free(w);
+}
+
+// Runs on the muxer thread.
+static void mux_packet(void *priv, void *job)
+{
+    struct encode_lavc_context *ctx = priv;
+    AVPacket *packet = job;
+
+    // libavformat takes over the packet data.
+    if (av_interleaved_write_frame(ctx->avc, packet) < 0)
+        MP_ERR(ctx, "error writing packet\n");
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->output_size = ctx->avc->pb ? avio_tell(ctx->avc->pb) : 0;
+    pthread_mutex_unlock(&ctx->lock);
+
+    talloc_free(packet);
+}
+
 int encode_lavc_available(struct encode_lavc_context *ctx)
 {
     CHECK_FAIL(ctx, 0);
@@ -133,6 +285,7 @@ struct encode_lavc_context *encode_lavc_init(struct encode_output_conf *options,
         mp_msg_force_stderr(global, true);
 
     ctx = talloc_zero(NULL, struct encode_lavc_context);
+    pthread_mutex_init(&ctx->lock, NULL);
     ctx->log = mp_log_new(ctx, global->log, "encode-lavc");
     ctx->global = global;
     encode_lavc_discontinuity(ctx);
@@ -224,6 +377,7 @@ struct encode_lavc_context *encode_lavc_init(struct encode_output_conf *options,
     ctx->abytes = 0;
     ctx->vbytes = 0;
     ctx->frames = 0;
+    ctx->copy_end_pts = 0;
 
     if (options->video_first)
         ctx->video_first = true;
@@ -295,6 +449,11 @@ int encode_lavc_start(struct encode_lavc_context *ctx)
         MP_WARN(ctx, "ofopts: key '%s' not found.\n", de->key);
     av_dict_free(&ctx->foptions);
 
+    // With AVFMT_RAWPICTURE, packets point to the image data of the encoder's
+    // current frame, so they can't be written asynchronously.
+    if (!(ctx->avc->oformat->flags & AVFMT_RAWPICTURE))
+        ctx->muxer = worker_create(ctx, MUX_QUEUE_SIZE, mux_packet, ctx);
+
     ctx->header_written = 1;
     return 1;
 }
@@ -308,6 +467,7 @@ void encode_lavc_free(struct encode_lavc_context *ctx)
         encode_lavc_fail(ctx,
                          "called encode_lavc_free without encode_lavc_finish\n");
 
+    pthread_mutex_destroy(&ctx->lock);
     talloc_free(ctx);
 }
 
@@ -321,6 +481,14 @@ void encode_lavc_finish(struct encode_lavc_context *ctx)
     if (ctx->finished)
         return;
 
+    // Let the encoders and the muxer process everything that was queued.
+    for (i = 0; i < ctx->num_workers; i++)
+        encode_worker_wait(ctx->workers[i]);
+    if (ctx->muxer) {
+        worker_free(ctx->muxer);
+        ctx->muxer = NULL;
+    }
+
     if (ctx->avc) {
         if (ctx->header_written > 0)
             av_write_trailer(ctx->avc);  // this is allowed to fail
@@ -704,7 +872,7 @@ void encode_lavc_write_stats(struct encode_lavc_context *ctx, AVStream *stream)
 
 int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVPacket *packet)
 {
-    int r;
+    int r = 0;
 
     CHECK_FAIL(ctx, -1);
 
@@ -724,6 +892,8 @@ int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVPacket *packet)
         / (double)ctx->avc->streams[packet->stream_index]->time_base.den,
         (int)packet->size);
 
+    pthread_mutex_lock(&ctx->lock);
+
     switch (ctx->avc->streams[packet->stream_index]->codec->codec_type) {
     case AVMEDIA_TYPE_VIDEO:
         ctx->vbytes += packet->size;
@@ -739,11 +909,128 @@ int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVPacket *packet)
         break;
     }
 
-    r = av_interleaved_write_frame(ctx->avc, packet);
+    if (ctx->muxer) {
+        pthread_mutex_unlock(&ctx->lock);
+        AVPacket *copy = talloc_ptrtype(NULL, copy);
+        *copy = *packet;
+        if (av_dup_packet(copy) < 0) {
+            talloc_free(copy);
+            return -1;
+        }
+        encode_worker_queue(ctx->muxer, copy);
+    } else {
+        // Serialize with the other encoder thread.
+        r = av_interleaved_write_frame(ctx->avc, packet);
+        if (ctx->avc->pb)
+            ctx->output_size = avio_tell(ctx->avc->pb);
+        pthread_mutex_unlock(&ctx->lock);
+    }
 
     return r;
 }
 
+AVStream *encode_lavc_copy_stream(struct encode_lavc_context *ctx,
+                                  struct sh_stream *sh)
+{
+    AVCodecContext *codec = sh->lav_headers;
+    AVStream *stream;
+    int i;
+
+    CHECK_FAIL(ctx, NULL);
+
+    if (!codec)
+        return NULL;
+
+    for (i = 0; i < ctx->avc->nb_streams; ++i) {
+        stream = ctx->avc->streams[i];
+        if (stream->codec->codec_type == codec->codec_type) {
+            // a later file of the playlist
+            if (stream->codec->codec_id != codec->codec_id) {
+                MP_ERR(ctx, "stream copy: codec changed between files\n");
+                return NULL;
+            }
+            return stream;
+        }
+    }
+
+    if (ctx->header_written)
+        return NULL;
+
+    stream = avformat_new_stream(ctx->avc, NULL);
+    if (!stream)
+        return NULL;
+
+    if (avcodec_copy_context(stream->codec, codec) < 0) {
+        encode_lavc_fail(ctx, "could not copy codec parameters\n");
+        return NULL;
+    }
+    // the fourcc is specific to the source container
+    stream->codec->codec_tag = 0;
+    if (stream->codec->time_base.num <= 0 || stream->codec->time_base.den <= 0)
+        stream->codec->time_base = (AVRational){1, AV_TIME_BASE};
+    stream->sample_aspect_ratio = stream->codec->sample_aspect_ratio;
+
+    if (ctx->avc->oformat->flags & AVFMT_GLOBALHEADER)
+        stream->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+    MP_INFO(ctx, "Copying %s stream: %s\n",
+            codec->codec_type == AVMEDIA_TYPE_VIDEO ? "video" : "audio",
+            sh->codec ? sh->codec : "unknown");
+
+    return stream;
+}
+
+static int64_t to_stream_time(AVStream *stream, double pts)
+{
+    if (pts == MP_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+    return floor(pts * stream->time_base.den / stream->time_base.num + 0.5);
+}
+
+int encode_lavc_write_demux_packet(struct encode_lavc_context *ctx,
+                                   AVStream *stream, struct demux_packet *dp,
+                                   double offset)
+{
+    AVPacket packet;
+
+    CHECK_FAIL(ctx, -1);
+
+    av_init_packet(&packet);
+    if (dp->avpacket) {
+        // keep flags and side data (e.g. palette changes)
+        packet.flags = dp->avpacket->flags;
+        packet.side_data = dp->avpacket->side_data;
+        packet.side_data_elems = dp->avpacket->side_data_elems;
+    } else if (dp->keyframe) {
+        packet.flags |= AV_PKT_FLAG_KEY;
+    }
+    packet.data = dp->buffer;
+    packet.size = dp->len;
+    packet.stream_index = stream->index;
+
+    double pts = dp->pts == MP_NOPTS_VALUE ? dp->pts : dp->pts - offset;
+    double dts = dp->dts == MP_NOPTS_VALUE ? dp->dts : dp->dts - offset;
+    packet.pts = to_stream_time(stream, pts);
+    packet.dts = to_stream_time(stream, dts);
+    packet.duration = dp->duration > 0
+                      ? to_stream_time(stream, dp->duration) : 0;
+
+    double end = pts != MP_NOPTS_VALUE ? pts : dts;
+    if (end != MP_NOPTS_VALUE) {
+        end += FFMAX(dp->duration, 0);
+        if (end > ctx->copy_end_pts)
+            ctx->copy_end_pts = end;
+    }
+
+    // the data and side data are copied by av_dup_packet()
+    return encode_lavc_write_frame(ctx, &packet);
+}
+
+double encode_lavc_copy_end_pts(struct encode_lavc_context *ctx)
+{
+    return ctx ? ctx->copy_end_pts : 0;
+}
+
 int encode_lavc_supports_pixfmt(struct encode_lavc_context *ctx,
                                 enum AVPixelFormat pix_fmt)
 {
@@ -994,35 +1281,79 @@ double encode_lavc_getoffset(struct encode_lavc_context *ctx, AVStream *stream)
     return 0;
 }
 
-int encode_lavc_getstatus(struct encode_lavc_context *ctx,
-                          char *buf, int bufsize,
-                          float relative_position)
+static void get_stats(struct encode_lavc_context *ctx,
+                      struct encode_lavc_stats *st)
+{
+    pthread_mutex_lock(&ctx->lock);
+    *st = (struct encode_lavc_stats) {
+        .elapsed = mp_time_sec() - ctx->t0,
+        .frames = ctx->frames,
+        .audioseconds = ctx->audioseconds,
+        .bytes = ctx->output_size,
+    };
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void encode_lavc_format_status(char *buf, int bufsize,
+                               const struct encode_lavc_stats *st,
+                               float relative_position)
 {
-    double now = mp_time_sec();
     float minutes, megabytes, fps, x;
     float f = FFMAX(0.0001, relative_position);
-    if (!ctx)
-        return -1;
 
-    CHECK_FAIL(ctx, -1);
-
-    minutes = (now - ctx->t0) / 60.0 * (1 - f) / f;
-    megabytes = ctx->avc->pb ? (avio_size(ctx->avc->pb) / 1048576.0 / f) : 0;
-    fps = ctx->frames / (now - ctx->t0);
-    x = ctx->audioseconds / (now - ctx->t0);
-    if (ctx->frames)
+    minutes = st->elapsed / 60.0 * (1 - f) / f;
+    megabytes = st->bytes / 1048576.0 / f;
+    fps = st->frames / st->elapsed;
+    x = st->audioseconds / st->elapsed;
+    if (st->frames)
         snprintf(buf, bufsize, "{%.1fmin %.1ffps %.1fMB}",
                  minutes, fps, megabytes);
-    else if (ctx->audioseconds)
+    else if (st->audioseconds)
         snprintf(buf, bufsize, "{%.1fmin %.2fx %.1fMB}",
                  minutes, x, megabytes);
     else
         snprintf(buf, bufsize, "{%.1fmin %.1fMB}",
                  minutes, megabytes);
     buf[bufsize - 1] = 0;
+}
+
+int encode_lavc_getstatus(struct encode_lavc_context *ctx,
+                          char *buf, int bufsize,
+                          float relative_position)
+{
+    struct encode_lavc_stats st;
+    if (!ctx)
+        return -1;
+
+    CHECK_FAIL(ctx, -1);
+
+    get_stats(ctx, &st);
+    encode_lavc_format_status(buf, bufsize, &st, relative_position);
     return 0;
 }
 
+void encode_lavc_report_status(struct encode_lavc_context *ctx,
+                               float relative_position)
+{
+    struct encode_lavc_stats st;
+    char buf[128];
+
+    if (!ctx || ctx->options->status_fd <= 0 || ctx->header_written <= 0 ||
+        ctx->failed || ctx->finished)
+        return;
+
+    double now = mp_time_sec();
+    if (now - ctx->status_time < 0.2)
+        return;
+    ctx->status_time = now;
+
+    get_stats(ctx, &st);
+    int len = snprintf(buf, sizeof(buf), "%f %u %f %lld\n", relative_position,
+                       st.frames, st.audioseconds, st.bytes);
+    if (write(ctx->options->status_fd, buf, len) < 0)
+        MP_VERBOSE(ctx, "could not write status: %s\n", strerror(errno));
+}
+
 void encode_lavc_expect_stream(struct encode_lavc_context *ctx, int mt)
 {
     CHECK_FAIL(ctx, );
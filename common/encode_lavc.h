@@ -22,6 +22,8 @@
 #ifndef MPLAYER_ENCODE_LAVC_H
 #define MPLAYER_ENCODE_LAVC_H
 
+#include <pthread.h>
+
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/avstring.h>
@@ -67,6 +69,12 @@ struct encode_lavc_context {
     unsigned int frames;
     double audioseconds;
 
+    // stream copy mode: end of the written packets, in output time
+    double copy_end_pts;
+
+    // last time the status was written to --oparallel-status-fd
+    double status_time;
+
     bool expect_video;
     bool expect_audio;
     bool video_first;
@@ -75,12 +83,53 @@ struct encode_lavc_context {
     // has encoding failed?
     bool failed;
     bool finished;
+
+    // Protects the statistics above (vbytes etc.) and output_size, which are
+    // updated by the encoder and muxer threads.
+    pthread_mutex_t lock;
+    long long output_size;
+
+    // Packets are written by this worker, unless the format needs
+    // synchronous writes (AVFMT_RAWPICTURE).
+    struct encode_worker *muxer;
+    // Encoder workers created by the vo/ao drivers.
+    struct encode_worker **workers;
+    int num_workers;
 };
 
+// Runs process(priv, job) on a separate thread for each queued job, in the
+// order they were queued. The process callback owns the job and must free it.
+// encode_worker_queue() blocks while max_jobs jobs are pending, which throttles
+// the caller to the speed of the encoder.
+struct encode_worker;
+struct encode_worker *encode_worker_create(struct encode_lavc_context *ctx,
+                                           int max_jobs,
+                                           void (*process)(void *priv, void *job),
+                                           void *priv);
+void encode_worker_queue(struct encode_worker *w, void *job);
+// Wait until all queued jobs have been processed.
+void encode_worker_wait(struct encode_worker *w);
+// Process all remaining jobs, then stop the thread and free the worker.
+void encode_worker_destroy(struct encode_worker *w);
+
 // interface for vo/ao drivers
 AVStream *encode_lavc_alloc_stream(struct encode_lavc_context *ctx, enum AVMediaType mt);
 void encode_lavc_write_stats(struct encode_lavc_context *ctx, AVStream *stream);
+// Queue the packet for muxing. The packet data is copied, unless the packet is
+// reference counted, in which case the reference is taken over.
 int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVPacket *packet);
+// Stream copy (--ocopy): create an output stream with the codec parameters of
+// the given demuxer stream, or return the existing one if the header was
+// already written and the codec is the same.
+struct sh_stream;
+struct demux_packet;
+AVStream *encode_lavc_copy_stream(struct encode_lavc_context *ctx,
+                                  struct sh_stream *sh);
+// Write the packet unchanged, with offset (in seconds) subtracted from its
+// timestamps.
+int encode_lavc_write_demux_packet(struct encode_lavc_context *ctx,
+                                   AVStream *stream, struct demux_packet *dp,
+                                   double offset);
 int encode_lavc_supports_pixfmt(struct encode_lavc_context *ctx, enum AVPixelFormat format);
 AVCodec *encode_lavc_get_codec(struct encode_lavc_context *ctx, AVStream *stream);
 int encode_lavc_open_codec(struct encode_lavc_context *ctx, AVStream *stream);
@@ -69,6 +69,13 @@ void playlist_insert(struct playlist *pl, struct playlist_entry *after,
     }
     add->pl = pl;
     talloc_steal(pl, add);
+
+    if (pl->index_valid && !add->next) {
+        add->pl_index = pl->num_entries;
+        MP_TARRAY_APPEND(pl, pl->entries, pl->num_entries, add);
+    } else {
+        pl->index_valid = false;
+    }
 }
 
 void playlist_add(struct playlist *pl, struct playlist_entry *add)
@@ -80,6 +87,12 @@ static void playlist_unlink(struct playlist *pl, struct playlist_entry *entry)
 {
     assert(pl && entry->pl == pl);
 
+    if (pl->index_valid && !entry->next) {
+        pl->num_entries--;
+    } else {
+        pl->index_valid = false;
+    }
+
     if (pl->current == entry) {
         pl->current = entry->next;
         pl->current_was_replaced = true;
@@ -133,36 +146,37 @@ void playlist_add_file(struct playlist *pl, const char *filename)
     playlist_add(pl, playlist_entry_new(filename));
 }
 
-static int playlist_count(struct playlist *pl)
+static void update_index(struct playlist *pl)
 {
-    int c = 0;
-    for (struct playlist_entry *e = pl->first; e; e = e->next)
-        c++;
-    return c;
+    if (pl->index_valid)
+        return;
+    pl->num_entries = 0;
+    for (struct playlist_entry *e = pl->first; e; e = e->next) {
+        e->pl_index = pl->num_entries;
+        MP_TARRAY_APPEND(pl, pl->entries, pl->num_entries, e);
+    }
+    pl->index_valid = true;
 }
 
 void playlist_shuffle(struct playlist *pl)
 {
-    struct playlist_entry *save_current = pl->current;
-    bool save_replaced = pl->current_was_replaced;
-    int count = playlist_count(pl);
-    struct playlist_entry **arr = talloc_array(NULL, struct playlist_entry *,
-                                               count);
-    for (int n = 0; n < count; n++) {
-        arr[n] = pl->first;
-        playlist_unlink(pl, pl->first);
-    }
+    update_index(pl);
+    struct playlist_entry **arr = pl->entries;
+    int count = pl->num_entries;
     for (int n = 0; n < count; n++) {
         int other = (int)((double)(count) * rand() / (RAND_MAX + 1.0));
         struct playlist_entry *tmp = arr[n];
         arr[n] = arr[other];
         arr[other] = tmp;
     }
-    for (int n = 0; n < count; n++)
-        playlist_add(pl, arr[n]);
-    talloc_free(arr);
-    pl->current = save_current;
-    pl->current_was_replaced = save_replaced;
+    // Relink the entries in the new order; current is unaffected.
+    for (int n = 0; n < count; n++) {
+        arr[n]->prev = n > 0 ? arr[n - 1] : NULL;
+        arr[n]->next = n < count - 1 ? arr[n + 1] : NULL;
+        arr[n]->pl_index = n;
+    }
+    pl->first = count ? arr[0] : NULL;
+    pl->last = count ? arr[count - 1] : NULL;
 }
 
 struct playlist_entry *playlist_get_next(struct playlist *pl, int direction)
@@ -211,31 +225,24 @@ void playlist_transfer_entries(struct playlist *pl, struct playlist *source_pl)
 // Return -1 if e is not on the list, or if e is NULL.
 int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e)
 {
-    struct playlist_entry *cur = pl->first;
-    int pos = 0;
-    if (!e)
+    if (!e || e->pl != pl)
         return -1;
-    while (cur && cur != e) {
-        cur = cur->next;
-        pos++;
-    }
-    return cur == e ? pos : -1;
+    update_index(pl);
+    return e->pl_index;
 }
 
 int playlist_entry_count(struct playlist *pl)
 {
-    return playlist_entry_to_index(pl, pl->last) + 1;
+    update_index(pl);
+    return pl->num_entries;
 }
 
 // Return entry for which playlist_entry_to_index() would return index.
 // Return NULL if not found.
 struct playlist_entry *playlist_entry_from_index(struct playlist *pl, int index)
 {
-    struct playlist_entry *e = pl->first;
-    for (int n = 0; ; n++) {
-        if (!e || n == index)
-            return e;
-        e = e->next;
-    }
+    update_index(pl);
+    if (index < 0 || index >= pl->num_entries)
+        return NULL;
+    return pl->entries[index];
 }
-
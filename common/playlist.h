@@ -34,6 +34,9 @@ struct playlist_entry {
     struct playlist_param *params;
     int num_params;
 
+    // Position in the playlist; valid only if pl->index_valid is set.
+    int pl_index;
+
     // Set to true if playback didn't seem to work, or if the file could be
     // played only for a very short time. This is used to make playlist
     // navigation just work in case the user has unplayable files in the
@@ -51,6 +54,13 @@ struct playlist {
     // current_was_replaced is set to true.
     struct playlist_entry *current;
     bool current_was_replaced;
+
+    // Array of all entries in list order, for O(1) access by index. Appending
+    // and removing the last entry keep it updated; other changes only mark it
+    // as invalid, and it's rebuilt on the next index access.
+    struct playlist_entry **entries;
+    int num_entries;
+    bool index_valid;
 };
 
 void playlist_entry_add_param(struct playlist_entry *e, bstr name, bstr value);
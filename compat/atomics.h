@@ -17,16 +17,26 @@
  */
 
 // At this point both gcc and clang had __sync_synchronize support for some
-// time. We only support a full memory barrier.
+// time. Besides a full memory barrier, only atomic loads with acquire and
+// stores with release semantics are provided.
 
 #include "config.h"
 
 #if HAVE_ATOMIC_BUILTINS
 # define mp_memory_barrier()           __atomic_thread_fence(__ATOMIC_SEQ_CST)
 # define mp_atomic_add_and_fetch(a, b) __atomic_add_fetch(a, b,__ATOMIC_SEQ_CST)
+# define mp_atomic_load_acquire(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+# define mp_atomic_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
 #elif HAVE_SYNC_BUILTINS
 # define mp_memory_barrier()           __sync_synchronize()
 # define mp_atomic_add_and_fetch(a, b) __sync_add_and_fetch(a, b)
+// No acquire/release semantics available; fall back to full barriers.
+# define mp_atomic_load_acquire(p) \
+    ({ __typeof__(*(p)) mp_v_ = *(volatile __typeof__(*(p)) *)(p); \
+       __sync_synchronize(); mp_v_; })
+# define mp_atomic_store_release(p, v) \
+    do { __sync_synchronize(); *(volatile __typeof__(*(p)) *)(p) = (v); \
+    } while (0)
 #else
 # error "this should have been a configuration error, report a bug please"
 #endif
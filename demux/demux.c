@@ -34,6 +34,7 @@
 #include "talloc.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "osdep/timer.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -88,6 +89,31 @@ const demuxer_desc_t *const demuxer_list[] = {
     NULL
 };
 
+// Demuxers that handle text formats only. They're not tried on files that
+// obviously contain binary data, which avoids charset detection and parsing
+// attempts (libass) on every media file.
+static const char *const text_demuxers[] = {
+    "edl", "cue", "libass", "playlist", "subreader", NULL
+};
+
+// Magic bytes of common formats. If one matches, the given demuxer is tried
+// first. If it fails, probing continues normally.
+static const struct demux_signature {
+    const char *demuxer;
+    int offset;
+    const char *magic;
+} demux_signatures[] = {
+    {"mkv",  0, "\x1A\x45\xDF\xA3"},                       // Matroska, WebM
+    {"lavf", 4, "ftyp"},                                    // MP4, MOV
+    {"lavf", 0, "RIFF"},                                    // AVI, WAV
+    {"lavf", 0, "OggS"},
+    {"lavf", 0, "fLaC"},
+    {"lavf", 0, "ID3"},                                     // MP3 + ID3v2
+    {"lavf", 0, "FLV"},
+    {"lavf", 0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11"},    // ASF, WMV
+    {0}
+};
+
 struct demux_stream {
     int selected;          // user wants packets from this stream
     int eof;               // end of demuxed stream? (true if all buffer empty)
@@ -529,7 +555,11 @@ static struct demuxer *open_given_type(struct mpv_global *global,
     mp_verbose(log, "Trying demuxer: %s (force-level: %s)\n",
                desc->name, d_level(check));
 
+    int64_t probe_start = mp_time_us();
     int ret = demuxer->desc->open(demuxer, check);
+    mp_verbose(log, "Demuxer %s %s after %.1f ms.\n", desc->name,
+               ret >= 0 ? "succeeded" : "failed",
+               (mp_time_us() - probe_start) / 1000.0);
     if (ret >= 0) {
         demuxer->params = NULL;
         if (demuxer->filetype)
@@ -565,6 +595,40 @@ static const int d_normal[]  = {DEMUX_CHECK_NORMAL, DEMUX_CHECK_UNSAFE, -1};
 static const int d_request[] = {DEMUX_CHECK_REQUEST, -1};
 static const int d_force[]   = {DEMUX_CHECK_FORCE, -1};
 
+static bool is_text_demuxer(const struct demuxer_desc *desc)
+{
+    for (int n = 0; text_demuxers[n]; n++) {
+        if (strcmp(text_demuxers[n], desc->name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Text files never contain 0 bytes, except UTF-16/32, which we expect to start
+// with a BOM.
+static bool looks_binary(bstr data)
+{
+    if (bstr_startswith0(data, "\xFF\xFE") || bstr_startswith0(data, "\xFE\xFF") ||
+        (data.len >= 4 && memcmp(data.start, "\0\0\xFE\xFF", 4) == 0))
+        return false;
+    return memchr(data.start, 0, data.len);
+}
+
+static const struct demuxer_desc *find_signature(bstr data)
+{
+    for (int n = 0; demux_signatures[n].demuxer; n++) {
+        const struct demux_signature *sig = &demux_signatures[n];
+        if (data.len < sig->offset ||
+            !bstr_startswith0(bstr_cut(data, sig->offset), sig->magic))
+            continue;
+        for (int i = 0; demuxer_list[i]; i++) {
+            if (strcmp(demuxer_list[i]->name, sig->demuxer) == 0)
+                return demuxer_list[i];
+        }
+    }
+    return NULL;
+}
+
 struct demuxer *demux_open(struct stream *stream, char *force_format,
                            struct demuxer_params *params,
                            struct mpv_global *global)
@@ -573,6 +637,7 @@ struct demuxer *demux_open(struct stream *stream, char *force_format,
     const struct demuxer_desc *check_desc = NULL;
     struct mp_log *log = mp_log_new(NULL, global->log, "!demux");
     struct demuxer *demuxer = NULL;
+    int64_t probe_start = mp_time_us();
 
     if (!force_format)
         force_format = stream->demuxer;
@@ -595,23 +660,46 @@ struct demuxer *demux_open(struct stream *stream, char *force_format,
 
     // Peek this much data to avoid that stream_read() run by some demuxers
     // or stream filters will flush previous peeked data.
-    stream_peek(stream, STREAM_BUFFER_SIZE);
+    bstr data = stream_peek(stream, STREAM_BUFFER_SIZE);
+
+    // Prefilter the candidates if the format is auto-detected.
+    const struct demuxer_desc *first_desc = NULL;
+    bool skip_text = false;
+    if (!check_desc) {
+        first_desc = find_signature(data);
+        skip_text = looks_binary(data);
+        if (first_desc)
+            mp_verbose(log, "File signature suggests demuxer %s.\n",
+                       first_desc->name);
+    }
 
     // Test demuxers from first to last, one pass for each check_levels[] entry
     for (int pass = 0; check_levels[pass] != -1; pass++) {
         enum demux_check level = check_levels[pass];
+        if (first_desc) {
+            demuxer = open_given_type(global, log, first_desc, stream, params,
+                                      level);
+            if (demuxer)
+                goto found;
+        }
         for (int n = 0; demuxer_list[n]; n++) {
             const struct demuxer_desc *desc = demuxer_list[n];
+            if (desc == first_desc || (skip_text && is_text_demuxer(desc)))
+                continue;
             if (!check_desc || desc == check_desc) {
                 demuxer = open_given_type(global, log, desc, stream, params, level);
-                if (demuxer) {
-                    talloc_steal(demuxer, log);
-                    log = NULL;
-                    goto done;
-                }
+                if (demuxer)
+                    goto found;
             }
         }
     }
+    goto done;
+
+found:
+    mp_verbose(log, "Probing took %.1f ms.\n",
+               (mp_time_us() - probe_start) / 1000.0);
+    talloc_steal(demuxer, log);
+    log = NULL;
 
 done:
     talloc_free(log);
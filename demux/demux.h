@@ -151,6 +151,8 @@ struct demuxer_params {
     struct matroska_segment_uid *matroska_wanted_uids;
     int matroska_wanted_segment;
     bool *matroska_was_valid;
+    // If set, only read the segment UID into it, and stop opening.
+    struct matroska_segment_uid *matroska_probe_uid;
     struct ass_library *ass_library;
 };
 
@@ -170,6 +170,12 @@ static int64_t mp_read_seek(void *opaque, int stream_idx, int64_t ts, int flags)
     return ret;
 }
 
+static int interrupt_cb(void *ctx)
+{
+    struct demuxer *demuxer = ctx;
+    return mp_cancel_test(demuxer->stream->cancel);
+}
+
 static void list_formats(struct demuxer *demuxer)
 {
     MP_INFO(demuxer, "Available lavf input formats:\n");
@@ -537,6 +543,11 @@ static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
     if (opts->index_mode == 0)
         avfc->flags |= AVFMT_FLAG_IGNIDX;
 
+    avfc->interrupt_callback = (AVIOInterruptCB){
+        .callback = interrupt_cb,
+        .opaque = demuxer,
+    };
+
     if (lavfdopts->probesize) {
         if (av_opt_set_int(avfc, "probesize", lavfdopts->probesize, 0) < 0)
             MP_ERR(demuxer, "demux_lavf, couldn't set option probesize to %u\n",
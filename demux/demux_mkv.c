@@ -392,6 +392,11 @@ static int demux_mkv_read_info(demuxer_t *demuxer)
             MP_VERBOSE(demuxer, "\n");
         }
     }
+    if (demuxer->params && demuxer->params->matroska_probe_uid) {
+        *demuxer->params->matroska_probe_uid = demuxer->matroska_data.uid;
+        res = -2;
+        goto out;
+    }
     if (demuxer->params && demuxer->params->matroska_wanted_uids) {
         if (info.n_segment_uid) {
             for (int i = 0; i < demuxer->params->matroska_num_wanted_uids; i++) {
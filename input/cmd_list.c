@@ -172,6 +172,8 @@ const struct mp_cmd_def mp_cmds[] = {
       { ARG_INT, ARG_INT, ARG_INT, ARG_STRING, ARG_INT, ARG_STRING, ARG_INT,
         ARG_INT, ARG_INT }},
   { MP_CMD_OVERLAY_REMOVE, "overlay_remove", { ARG_INT } },
+  { MP_CMD_THUMBNAIL, "thumbnail",
+      { ARG_INT, ARG_INT, ARG_INT, ARG_TIME, ARG_INT, ARG_INT }},
 
   {0}
 };
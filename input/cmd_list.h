@@ -101,6 +101,7 @@ enum mp_command_type {
 
     MP_CMD_OVERLAY_ADD,
     MP_CMD_OVERLAY_REMOVE,
+    MP_CMD_THUMBNAIL,
 
     // Internal
     MP_CMD_COMMAND_LIST, // list of sub-commands in args[0].v.p
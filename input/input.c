@@ -32,6 +32,11 @@
 #include <pthread.h>
 #include <assert.h>
 
+#if HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #include <libavutil/avstring.h>
 #include <libavutil/common.h>
 
@@ -99,6 +104,7 @@ struct input_fd {
     unsigned dead : 1;
     unsigned got_cmd : 1;
     unsigned select : 1;
+    unsigned polled : 1;    // in the epoll set
     // These fields are for the cmd fds.
     char *buffer;
     int pos, size;
@@ -176,7 +182,10 @@ struct input_ctx {
     struct cmd_queue cmd_queue;
 
     bool in_select;
+    // With eventfd, both entries are the same fd.
     int wakeup_pipe[2];
+    // Contains all fds with select set (epoll only).
+    int epoll_fd;
 };
 
 int async_quit_request;
@@ -195,6 +204,9 @@ static const m_option_t input_config[] = {
     OPT_PRINT("cmdlist", mp_print_cmd_list),
     OPT_STRING("js-dev", input.js_dev, CONF_GLOBAL),
     OPT_STRING("file", input.in_file, CONF_GLOBAL),
+#if HAVE_UNIX_SOCKET
+    OPT_STRING("unix-socket", input.ipc_path, CONF_GLOBAL),
+#endif
     OPT_FLAG("default-bindings", input.default_bindings, CONF_GLOBAL),
     OPT_FLAG("test", input.test, CONF_GLOBAL),
     { NULL, NULL, 0, 0, 0, 0, NULL}
@@ -843,6 +855,21 @@ int mp_input_add_fd(struct input_ctx *ictx, int unix_fd, int select,
         .ctx = ctx,
     };
     ictx->num_fds++;
+#if HAVE_EPOLL
+    // fds that can't be polled (like regular files, which epoll rejects with
+    // EPERM) are read on every iteration instead, like select() would do.
+    if (fd && select && ictx->epoll_fd >= 0) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = unix_fd };
+        if (epoll_ctl(ictx->epoll_fd, EPOLL_CTL_ADD, unix_fd, &ev) == 0 ||
+            errno == EEXIST)
+        {
+            fd->polled = 1;
+        } else if (errno != EPERM) {
+            MP_ERR(ictx, "Can't add fd %d to epoll: %s\n", unix_fd,
+                   strerror(errno));
+        }
+    }
+#endif
     input_unlock(ictx);
     return !!fd;
 }
@@ -858,6 +885,15 @@ static void mp_input_rm_fd(struct input_ctx *ictx, int fd)
     }
     if (i == ictx->num_fds)
         return;
+#if HAVE_EPOLL
+    // The fd must be removed before it's closed. Keep it if another entry
+    // still uses it.
+    bool shared = false;
+    for (int n = 0; n < ictx->num_fds; n++)
+        shared |= n != i && fds[n].fd == fd && fds[n].polled;
+    if (fds[i].polled && !shared)
+        epoll_ctl(ictx->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#endif
     if (fds[i].close_func)
         fds[i].close_func(fds[i].ctx, fds[i].fd);
     talloc_free(fds[i].buffer);
@@ -1012,9 +1048,46 @@ static void remove_dead_fds(struct input_ctx *ictx)
     }
 }
 
+#if HAVE_EPOLL
+
+// The set of fds is maintained incrementally by mp_input_add_fd() and
+// mp_input_rm_fd(), so waiting doesn't need to rebuild it every time.
+static void input_wait_epoll(struct input_ctx *ictx, int time)
+{
+    // Unpolled fds with select set are always readable (as with select()).
+    for (int i = 0; i < ictx->num_fds; i++) {
+        if (ictx->fds[i].select && !ictx->fds[i].polled)
+            time = 0;
+    }
+
+    struct epoll_event events[MP_MAX_FDS];
+    ictx->in_select = true;
+    input_unlock(ictx);
+    int num = epoll_wait(ictx->epoll_fd, events, MP_MAX_FDS, time);
+    if (num < 0) {
+        if (errno != EINTR)
+            MP_ERR(ictx, "epoll error: %s\n", strerror(errno));
+        num = 0;
+    }
+    input_lock(ictx);
+    ictx->in_select = false;
+    for (int n = 0; n < num; n++) {
+        for (int i = 0; i < ictx->num_fds; i++) {
+            if (ictx->fds[i].polled && ictx->fds[i].fd == events[n].data.fd)
+                read_fd(ictx, &ictx->fds[i]);
+        }
+    }
+    for (int i = 0; i < ictx->num_fds; i++) {
+        if (!ictx->fds[i].polled)
+            read_fd(ictx, &ictx->fds[i]);
+    }
+}
+
+#endif
+
 #if HAVE_POSIX_SELECT
 
-static void input_wait_read(struct input_ctx *ictx, int time)
+static void input_wait_select(struct input_ctx *ictx, int time)
 {
     fd_set fds;
     FD_ZERO(&fds);
@@ -1046,18 +1119,26 @@ static void input_wait_read(struct input_ctx *ictx, int time)
     }
 }
 
-#else
+#endif
 
 static void input_wait_read(struct input_ctx *ictx, int time)
 {
+#if HAVE_EPOLL
+    if (ictx->epoll_fd >= 0) {
+        input_wait_epoll(ictx, time);
+        return;
+    }
+#endif
+#if HAVE_POSIX_SELECT
+    input_wait_select(ictx, time);
+#else
     if (time > 0)
         mp_sleep_us(time * 1000);
 
     for (int i = 0; i < ictx->num_fds; i++)
         read_fd(ictx, &ictx->fds[i]);
-}
-
 #endif
+}
 
 /**
  * \param time time to wait at most for an event in milliseconds
@@ -1472,6 +1553,7 @@ struct input_ctx *mp_input_init(struct mpv_global *global)
         .mouse_section = "default",
         .test = input_conf->test,
         .wakeup_pipe = {-1, -1},
+        .epoll_fd = -1,
     };
 
     pthread_mutexattr_t attr;
@@ -1495,24 +1577,41 @@ struct input_ctx *mp_input_init(struct mpv_global *global)
             parse_config(ictx, true, line, "<builtin>", NULL);
     }
 
+#if HAVE_EPOLL
+    ictx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int efd = ictx->epoll_fd >= 0 ? eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) : -1;
+    if (efd < 0) {
+        MP_WARN(ictx, "Failed to initialize epoll, using select: %s\n",
+                strerror(errno));
+        if (ictx->epoll_fd >= 0)
+            close(ictx->epoll_fd);
+        ictx->epoll_fd = -1;
+    } else {
+        ictx->wakeup_pipe[0] = ictx->wakeup_pipe[1] = efd;
+        mp_input_add_fd(ictx, efd, true, NULL, read_wakeup, NULL, NULL);
+    }
+#endif
 #ifndef __MINGW32__
-    int ret = pipe(ictx->wakeup_pipe);
-    if (ret == 0) {
-        for (int i = 0; i < 2 && ret >= 0; i++) {
-            mp_set_cloexec(ictx->wakeup_pipe[i]);
-            ret = fcntl(ictx->wakeup_pipe[i], F_GETFL);
-            if (ret < 0)
-                break;
-            ret = fcntl(ictx->wakeup_pipe[i], F_SETFL, ret | O_NONBLOCK);
-            if (ret < 0)
-                break;
+    if (ictx->wakeup_pipe[0] < 0) {
+        int ret = pipe(ictx->wakeup_pipe);
+        if (ret == 0) {
+            for (int i = 0; i < 2 && ret >= 0; i++) {
+                mp_set_cloexec(ictx->wakeup_pipe[i]);
+                ret = fcntl(ictx->wakeup_pipe[i], F_GETFL);
+                if (ret < 0)
+                    break;
+                ret = fcntl(ictx->wakeup_pipe[i], F_SETFL, ret | O_NONBLOCK);
+                if (ret < 0)
+                    break;
+            }
         }
+        if (ret < 0)
+            MP_ERR(ictx, "Failed to initialize wakeup pipe: %s\n",
+                   strerror(errno));
+        else
+            mp_input_add_fd(ictx, ictx->wakeup_pipe[0], true, NULL,
+                            read_wakeup, NULL, NULL);
     }
-    if (ret < 0)
-        MP_ERR(ictx, "Failed to initialize wakeup pipe: %s\n", strerror(errno));
-    else
-        mp_input_add_fd(ictx, ictx->wakeup_pipe[0], true, NULL, read_wakeup,
-                        NULL, NULL);
 #endif
 
     bool config_ok = false;
@@ -1605,9 +1704,12 @@ void mp_input_uninit(struct input_ctx *ictx)
             ictx->fds[i].close_func(ictx->fds[i].ctx, ictx->fds[i].fd);
     }
     for (int i = 0; i < 2; i++) {
-        if (ictx->wakeup_pipe[i] != -1)
+        if (ictx->wakeup_pipe[i] != -1 &&
+            (i == 0 || ictx->wakeup_pipe[1] != ictx->wakeup_pipe[0]))
             close(ictx->wakeup_pipe[i]);
     }
+    if (ictx->epoll_fd >= 0)
+        close(ictx->epoll_fd);
     clear_queue(&ictx->cmd_queue);
     talloc_free(ictx->current_down_cmd);
     pthread_mutex_destroy(&ictx->mutex);
@@ -1621,8 +1723,13 @@ void mp_input_wakeup(struct input_ctx *ictx)
     ictx->got_new_events = true;
     input_unlock(ictx);
     // Safe without locking
-    if (send_wakeup && ictx->wakeup_pipe[1] >= 0)
-        write(ictx->wakeup_pipe[1], &(char){0}, 1);
+    if (send_wakeup && ictx->wakeup_pipe[1] >= 0) {
+        if (ictx->wakeup_pipe[0] == ictx->wakeup_pipe[1]) { // eventfd
+            write(ictx->wakeup_pipe[1], &(uint64_t){1}, sizeof(uint64_t));
+        } else {
+            write(ictx->wakeup_pipe[1], &(char){0}, 1);
+        }
+    }
 }
 
 static bool test_abort(struct input_ctx *ictx)
@@ -0,0 +1,278 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "talloc.h"
+#include "common/common.h"
+#include "json.h"
+
+static void eat_ws(char **src)
+{
+    while (**src == ' ' || **src == '\t' || **src == '\n' || **src == '\r')
+        *src += 1;
+}
+
+static bool eat_literal(char **src, const char *lit)
+{
+    size_t len = strlen(lit);
+    if (strncmp(*src, lit, len) != 0)
+        return false;
+    *src += len;
+    return true;
+}
+
+static int read_hex4(const char *s)
+{
+    int r = 0;
+    for (int n = 0; n < 4; n++) {
+        char c = s[n];
+        int v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            v = c - 'A' + 10;
+        } else {
+            return -1;
+        }
+        r = r * 16 + v;
+    }
+    return r;
+}
+
+static const char *skip_digits(const char *s)
+{
+    while (*s >= '0' && *s <= '9')
+        s++;
+    return s;
+}
+
+// Return the end of the JSON number starting at s, or NULL if it's not a valid
+// JSON number (strtod() also accepts hex, inf, nan, leading '+' etc.).
+static const char *number_end(const char *s)
+{
+    if (*s == '-')
+        s++;
+    if (*s == '0') {
+        s++;
+    } else if (*s >= '1' && *s <= '9') {
+        s = skip_digits(s);
+    } else {
+        return NULL;
+    }
+    if (*s == '.') {
+        const char *frac = s + 1;
+        s = skip_digits(frac);
+        if (s == frac)
+            return NULL;
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        if (*s == '+' || *s == '-')
+            s++;
+        const char *exp = s;
+        s = skip_digits(exp);
+        if (s == exp)
+            return NULL;
+    }
+    return s;
+}
+
+// *src points to the opening '"'.
+static char *parse_string(void *talloc_ctx, char **src)
+{
+    char *cur = *src + 1;
+    bstr res = {talloc_strdup(talloc_ctx, ""), 0};
+    while (1) {
+        char *end = cur;
+        while (*end && *end != '"' && *end != '\\')
+            end++;
+        bstr_xappend(talloc_ctx, &res, (bstr){cur, end - cur});
+        cur = end;
+        if (*cur == '"')
+            break;
+        if (*cur != '\\')
+            return NULL;
+        cur++;
+        const char *replace = NULL;
+        switch (*cur) {
+        case '"':  replace = "\""; break;
+        case '\\': replace = "\\"; break;
+        case '/':  replace = "/";  break;
+        case 'b':  replace = "\b"; break;
+        case 'f':  replace = "\f"; break;
+        case 'n':  replace = "\n"; break;
+        case 'r':  replace = "\r"; break;
+        case 't':  replace = "\t"; break;
+        case 'u': {
+            int c = read_hex4(cur + 1);
+            if (c < 0)
+                return NULL;
+            cur += 5;
+            // Combine UTF-16 surrogate pairs.
+            if (c >= 0xD800 && c < 0xDC00 && cur[0] == '\\' && cur[1] == 'u') {
+                int c2 = read_hex4(cur + 2);
+                if (c2 >= 0xDC00 && c2 < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+                    cur += 6;
+                }
+            }
+            mp_append_utf8_bstr(talloc_ctx, &res, c);
+            continue;
+        }
+        default:
+            return NULL;
+        }
+        bstr_xappend(talloc_ctx, &res, bstr0(replace));
+        cur++;
+    }
+    *src = cur + 1;
+    return res.start;
+}
+
+static bool parse_list(void *talloc_ctx, struct json_node *dst, char **src,
+                       int max_depth, bool is_object)
+{
+    char term = is_object ? '}' : ']';
+    if (max_depth < 1)
+        return false;
+    *src += 1;
+    eat_ws(src);
+    if (**src == term) {
+        *src += 1;
+        return true;
+    }
+    while (1) {
+        char *key = NULL;
+        if (is_object) {
+            if (**src != '"')
+                return false;
+            key = parse_string(talloc_ctx, src);
+            if (!key)
+                return false;
+            eat_ws(src);
+            if (**src != ':')
+                return false;
+            *src += 1;
+        }
+        struct json_node val;
+        if (!json_parse(talloc_ctx, &val, src, max_depth - 1))
+            return false;
+        int num = dst->num_values;
+        MP_TARRAY_APPEND(talloc_ctx, dst->values, dst->num_values, val);
+        if (is_object)
+            MP_TARRAY_APPEND(talloc_ctx, dst->keys, num, key);
+        eat_ws(src);
+        if (**src == term) {
+            *src += 1;
+            return true;
+        }
+        if (**src != ',')
+            return false;
+        *src += 1;
+        eat_ws(src);
+    }
+}
+
+bool json_parse(void *talloc_ctx, struct json_node *dst, char **src,
+                int max_depth)
+{
+    *dst = (struct json_node){0};
+    eat_ws(src);
+    char c = **src;
+    if (c == '{' || c == '[') {
+        dst->type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+        return parse_list(talloc_ctx, dst, src, max_depth, c == '{');
+    } else if (c == '"') {
+        dst->type = JSON_STRING;
+        dst->string = parse_string(talloc_ctx, src);
+        return !!dst->string;
+    } else if (eat_literal(src, "null")) {
+        dst->type = JSON_NULL;
+        return true;
+    } else if (eat_literal(src, "true")) {
+        dst->type = JSON_FLAG;
+        dst->flag = true;
+        return true;
+    } else if (eat_literal(src, "false")) {
+        dst->type = JSON_FLAG;
+        return true;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        const char *valid_end = number_end(*src);
+        char *end;
+        dst->type = JSON_NUMBER;
+        dst->number = strtod(*src, &end);
+        if (!valid_end || end != valid_end)
+            return false;
+        *src = end;
+        return true;
+    }
+    return false;
+}
+
+struct json_node *json_get(struct json_node *obj, const char *key)
+{
+    if (!obj || obj->type != JSON_OBJECT)
+        return NULL;
+    for (int n = 0; n < obj->num_values; n++) {
+        if (strcmp(obj->keys[n], key) == 0)
+            return &obj->values[n];
+    }
+    return NULL;
+}
+
+void json_write_string(void *talloc_ctx, bstr *dst, const char *str)
+{
+    bstr_xappend(talloc_ctx, dst, bstr0("\""));
+    while (*str) {
+        const char *end = str;
+        while (*end && *end != '"' && *end != '\\' && (unsigned char)*end >= 32)
+            end++;
+        bstr_xappend(talloc_ctx, dst, (bstr){(char *)str, end - str});
+        if (!*end)
+            break;
+        unsigned char c = *end;
+        if (c == '"' || c == '\\') {
+            bstr_xappend_asprintf(talloc_ctx, dst, "\\%c", c);
+        } else if (c == '\n') {
+            bstr_xappend(talloc_ctx, dst, bstr0("\\n"));
+        } else {
+            bstr_xappend_asprintf(talloc_ctx, dst, "\\u%04x", c);
+        }
+        str = end + 1;
+    }
+    bstr_xappend(talloc_ctx, dst, bstr0("\""));
+}
+
+void json_write_number(void *talloc_ctx, bstr *dst, double num)
+{
+    if (isfinite(num)) {
+        // Use the shortest representation that reads back as the same value.
+        char buf[40];
+        snprintf(buf, sizeof(buf), "%.15g", num);
+        if (strtod(buf, NULL) != num)
+            snprintf(buf, sizeof(buf), "%.17g", num);
+        bstr_xappend(talloc_ctx, dst, bstr0(buf));
+    } else {
+        bstr_xappend(talloc_ctx, dst, bstr0("null"));
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_JSON_H
+#define MP_JSON_H
+
+#include <stdbool.h>
+
+#include "bstr/bstr.h"
+
+// Minimal JSON support, as needed for the IPC protocol.
+
+enum json_type {
+    JSON_NULL,
+    JSON_FLAG,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+};
+
+struct json_node {
+    enum json_type type;
+    bool flag;                  // JSON_FLAG
+    double number;              // JSON_NUMBER
+    char *string;               // JSON_STRING
+    // JSON_ARRAY and JSON_OBJECT
+    struct json_node *values;
+    char **keys;                // JSON_OBJECT only
+    int num_values;
+};
+
+// Parse a JSON value at *src, and make *src point to the text following it
+// (the caller must check for trailing garbage if the value is the whole text).
+// All memory is allocated with talloc_ctx as parent. max_depth limits the
+// nesting of arrays and objects. Returns false on syntax errors.
+bool json_parse(void *talloc_ctx, struct json_node *dst, char **src,
+                int max_depth);
+
+// Return the value of the given key, or NULL if obj is not an object, or if
+// the key doesn't exist.
+struct json_node *json_get(struct json_node *obj, const char *key);
+
+// Append str as quoted and escaped JSON string.
+void json_write_string(void *talloc_ctx, bstr *dst, const char *str);
+// Append the number, or null if it can't be represented in JSON.
+void json_write_number(void *talloc_ctx, bstr *dst, double num);
+
+#endif
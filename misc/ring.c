@@ -18,14 +18,29 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
 #include <libavutil/common.h>
 #include <assert.h>
+#include "config.h"
 #include "talloc.h"
+#include "common/common.h"
 #include "compat/atomics.h"
 #include "ring.h"
 
+#if HAVE_SYS_MMAN_H && !defined(_WIN32)
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define HAVE_MIRRORING 1
+#else
+#define HAVE_MIRRORING 0
+#endif
+
 struct mp_ring {
     uint8_t  *buffer;
+    int size;
+    // buffer is mapped twice in a row (2 * size bytes of address space)
+    bool mirrored;
 
     /* Positions of the first readable/writeable chunks. Do not read this
      * fields but use the atomic private accessors `mp_ring_get_wpos`
@@ -51,12 +66,126 @@ struct mp_ring *mp_ring_new(void *talloc_ctx, int size)
         talloc_zero(talloc_ctx, struct mp_ring);
 
     *ringbuffer = (struct mp_ring) {
-        .buffer = talloc_size(talloc_ctx, size),
+        .buffer = talloc_size(ringbuffer, size),
+        .size   = size,
     };
 
     return ringbuffer;
 }
 
+#if HAVE_MIRRORING
+static void mp_ring_unmap(void *ptr)
+{
+    struct mp_ring *buffer = ptr;
+    munmap(buffer->buffer, buffer->size * 2);
+}
+
+// Map a file of the given size twice into consecutive address space.
+static uint8_t *map_mirrored(int size)
+{
+    static const char *const templates[] = {
+        "/dev/shm/mpv-ring-XXXXXX", "/tmp/mpv-ring-XXXXXX",
+    };
+    int fd = -1;
+    for (int n = 0; n < MP_ARRAY_SIZE(templates) && fd < 0; n++) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s", templates[n]);
+        fd = mkstemp(path);
+        if (fd >= 0)
+            unlink(path);
+    }
+    if (fd < 0)
+        return NULL;
+
+    uint8_t *res = NULL;
+    if (ftruncate(fd, size) < 0)
+        goto done;
+    // Reserve address space for both mappings, then replace it.
+    uint8_t *base = mmap(NULL, size * 2, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        goto done;
+    for (int n = 0; n < 2; n++) {
+        void *p = mmap(base + size * n, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, fd, 0);
+        if (p != base + size * n) {
+            munmap(base, size * 2);
+            goto done;
+        }
+    }
+    res = base;
+done:
+    close(fd);
+    return res;
+}
+#endif
+
+struct mp_ring *mp_ring_new_mirrored(void *talloc_ctx, int size)
+{
+#if HAVE_MIRRORING
+    // Page size times a power of 2, so that the wrapping of rpos/wpos is
+    // consistent (assuming the page size is a power of 2).
+    int alloc = FFMAX(sysconf(_SC_PAGESIZE), 1);
+    while (alloc < size)
+        alloc *= 2;
+    uint8_t *mem = map_mirrored(alloc);
+    if (mem) {
+        struct mp_ring *ringbuffer = talloc_zero(talloc_ctx, struct mp_ring);
+        *ringbuffer = (struct mp_ring) {
+            .buffer   = mem,
+            .size     = alloc,
+            .mirrored = true,
+        };
+        talloc_set_destructor(ringbuffer, mp_ring_unmap);
+        return ringbuffer;
+    }
+#endif
+    return mp_ring_new(talloc_ctx, size);
+}
+
+// Split the region [pos, pos + len) of the buffer into up to 2 spans.
+static int mp_ring_get_spans(struct mp_ring *buffer, uint32_t pos, int len,
+                             struct mp_ring_span spans[2])
+{
+    int ptr  = pos % buffer->size;
+    int len1 = buffer->mirrored ? len : FFMIN(buffer->size - ptr, len);
+    spans[0] = (struct mp_ring_span){buffer->buffer + ptr, len1};
+    spans[1] = (struct mp_ring_span){buffer->buffer, len - len1};
+    return len;
+}
+
+int mp_ring_reserve(struct mp_ring *buffer, int len,
+                    struct mp_ring_span spans[2])
+{
+    // Only the producer modifies wpos, so it doesn't need to be synchronized
+    // here; rpos must be read with acquire semantics, so that the consumer
+    // is done with the memory we're going to write to.
+    uint32_t wpos = buffer->wpos;
+    uint32_t rpos = mp_atomic_load_acquire(&buffer->rpos);
+    int free = buffer->size - (int)(wpos - rpos);
+    return mp_ring_get_spans(buffer, wpos, FFMIN(len, free), spans);
+}
+
+void mp_ring_commit(struct mp_ring *buffer, int len)
+{
+    assert(len >= 0 && len <= mp_ring_available(buffer));
+    mp_atomic_store_release(&buffer->wpos, buffer->wpos + len);
+}
+
+int mp_ring_peek(struct mp_ring *buffer, int len, struct mp_ring_span spans[2])
+{
+    uint32_t rpos = buffer->rpos;
+    uint32_t wpos = mp_atomic_load_acquire(&buffer->wpos);
+    int buffered = wpos - rpos;
+    return mp_ring_get_spans(buffer, rpos, FFMIN(len, buffered), spans);
+}
+
+void mp_ring_consume(struct mp_ring *buffer, int len)
+{
+    assert(len >= 0 && len <= mp_ring_buffered(buffer));
+    mp_atomic_store_release(&buffer->rpos, buffer->rpos + len);
+}
+
 int mp_ring_drain(struct mp_ring *buffer, int len)
 {
     int buffered  = mp_ring_buffered(buffer);
@@ -119,7 +248,7 @@ int mp_ring_available(struct mp_ring *buffer)
 
 int mp_ring_size(struct mp_ring *buffer)
 {
-    return talloc_get_size(buffer->buffer);
+    return buffer->size;
 }
 
 int mp_ring_buffered(struct mp_ring *buffer)
@@ -25,8 +25,20 @@
  * implementation. Thread safety is accomplished through atomic operations.
  */
 
+#include <stdint.h>
+
 struct mp_ring;
 
+/**
+ * A contiguous region of the ringbuffer memory, as returned by
+ * mp_ring_reserve() and mp_ring_peek(). The data of a ringbuffer region
+ * can be split into two spans if it wraps around the end of the buffer.
+ */
+struct mp_ring_span {
+    uint8_t *data;
+    int len;
+};
+
 /**
  * Instantiate a new ringbuffer
  *
@@ -36,6 +48,19 @@ struct mp_ring;
  */
 struct mp_ring *mp_ring_new(void *talloc_ctx, int size);
 
+/**
+ * Instantiate a new ringbuffer whose memory is mapped twice in a row, so
+ * that the region after the end of the buffer aliases its start. Then any
+ * readable or writeable region is a single contiguous span. The size is
+ * rounded up to the page size. Falls back to a normal ringbuffer if
+ * mirroring is not supported by the OS.
+ *
+ * talloc_ctx: talloc context of the newly created object
+ * size:       minimum total size in bytes
+ * return:     the newly created ringbuffer
+ */
+struct mp_ring *mp_ring_new_mirrored(void *talloc_ctx, int size);
+
 /**
  * Read data from the ringbuffer
  *
@@ -56,6 +81,51 @@ int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len);
  */
 int mp_ring_write(struct mp_ring *buffer, unsigned char *src, int len);
 
+/**
+ * Get direct access to the free space of the ringbuffer, so that the
+ * producer can write the data in place. Must be followed by
+ * mp_ring_commit() to make the data visible to the consumer.
+ *
+ * buffer: target ringbuffer instance
+ * len:    maximum number of bytes to reserve
+ * spans:  set to the writeable regions; spans[1] is empty unless the
+ *         reserved region wraps around the end of a non-mirrored buffer
+ * return: number of bytes reserved (sum of the span lengths)
+ */
+int mp_ring_reserve(struct mp_ring *buffer, int len,
+                    struct mp_ring_span spans[2]);
+
+/**
+ * Make data written to reserved space visible to the consumer
+ *
+ * buffer: target ringbuffer instance
+ * len:    number of bytes written, at most the value returned by the
+ *         previous mp_ring_reserve() call
+ */
+void mp_ring_commit(struct mp_ring *buffer, int len);
+
+/**
+ * Get direct access to the buffered data, without removing it from the
+ * ringbuffer. Call mp_ring_consume() when done with the data.
+ *
+ * buffer: target ringbuffer instance
+ * len:    maximum number of bytes to access
+ * spans:  set to the readable regions; spans[1] is empty unless the
+ *         region wraps around the end of a non-mirrored buffer
+ * return: number of bytes accessible (sum of the span lengths)
+ */
+int mp_ring_peek(struct mp_ring *buffer, int len, struct mp_ring_span spans[2]);
+
+/**
+ * Remove data returned by mp_ring_peek() from the ringbuffer, which makes
+ * the space available to the producer again.
+ *
+ * buffer: target ringbuffer instance
+ * len:    number of bytes to remove, at most the value returned by the
+ *         previous mp_ring_peek() call
+ */
+void mp_ring_consume(struct mp_ring *buffer, int len);
+
 /**
  * Drain data from the ringbuffer
  *
@@ -274,6 +274,17 @@ void m_config_restore_backups(struct m_config *config)
     }
 }
 
+void m_config_swap_backups(struct m_config *config)
+{
+    for (struct m_opt_backup *bc = config->backup_opts; bc; bc = bc->next) {
+        int size = bc->co->opt->type->size;
+        union m_option_value tmp;
+        memcpy(&tmp, bc->co->data, size);
+        memcpy(bc->co->data, bc->backup, size);
+        memcpy(bc->backup, &tmp, size);
+    }
+}
+
 void m_config_backup_opt(struct m_config *config, const char *opt)
 {
     struct m_config_option *co = m_config_get_co(config, bstr0(opt));
@@ -751,3 +762,79 @@ void *m_config_alloc_struct(void *talloc_ctx,
         memcpy(substruct, subopts->defaults, subopts->size);
     return substruct;
 }
+
+struct struct_copy {
+    const struct m_option *options;
+    void *data;
+};
+
+// Deep-copy the option values in src to dst, which was memcpy'd from src.
+// Sub-structs are allocated as children of ta_parent.
+static void copy_struct_options(void *ta_parent, void *dst, const void *src,
+                                const struct m_option *defs)
+{
+    for (int i = 0; defs && defs[i].name; i++) {
+        const struct m_option *opt = &defs[i];
+        int flags = opt->type->flags;
+        if ((flags & M_OPT_TYPE_HAS_CHILD) &&
+            !(flags & M_OPT_TYPE_USE_SUBSTRUCT))
+        {
+            copy_struct_options(ta_parent, dst, src, opt->p);
+        } else if (!opt->is_new_option) {
+            // Value is stored in a global variable, not in the struct.
+        } else if (flags & M_OPT_TYPE_USE_SUBSTRUCT) {
+            const struct m_sub_options *subopts = opt->priv;
+            void *src_sub = substruct_read_ptr((char *)src + opt->offset);
+            void *dst_sub = NULL;
+            if (src_sub) {
+                dst_sub = talloc_memdup(ta_parent, src_sub, subopts->size);
+                copy_struct_options(ta_parent, dst_sub, src_sub, subopts->opts);
+            }
+            substruct_write_ptr((char *)dst + opt->offset, dst_sub);
+        } else if (flags & M_OPT_TYPE_DYNAMIC) {
+            void *data = (char *)dst + opt->offset;
+            memset(data, 0, opt->type->size);
+            m_option_copy(opt, data, (char *)src + opt->offset);
+        }
+    }
+}
+
+static void free_struct_options(void *data, const struct m_option *defs)
+{
+    for (int i = 0; defs && defs[i].name; i++) {
+        const struct m_option *opt = &defs[i];
+        int flags = opt->type->flags;
+        if ((flags & M_OPT_TYPE_HAS_CHILD) &&
+            !(flags & M_OPT_TYPE_USE_SUBSTRUCT))
+        {
+            free_struct_options(data, opt->p);
+        } else if (!opt->is_new_option) {
+            // not part of the struct
+        } else if (flags & M_OPT_TYPE_USE_SUBSTRUCT) {
+            const struct m_sub_options *subopts = opt->priv;
+            void *sub = substruct_read_ptr((char *)data + opt->offset);
+            if (sub)
+                free_struct_options(sub, subopts->opts);
+        } else if (flags & M_OPT_TYPE_DYNAMIC) {
+            m_option_free(opt, (char *)data + opt->offset);
+        }
+    }
+}
+
+static void struct_copy_destroy(void *p)
+{
+    struct struct_copy *c = p;
+    free_struct_options(c->data, c->options);
+}
+
+void *m_config_copy_struct(void *talloc_ctx, const void *optstruct,
+                           size_t size, const struct m_option *options)
+{
+    void *data = talloc_memdup(talloc_ctx, (void *)optstruct, size);
+    // Freed before the data it references; owns the sub-structs.
+    struct struct_copy *c = talloc_ptrtype(data, c);
+    *c = (struct struct_copy){ .options = options, .data = data };
+    copy_struct_options(c, data, optstruct, options);
+    talloc_set_destructor(c, struct_copy_destroy);
+    return data;
+}
@@ -109,6 +109,10 @@ void m_config_backup_all_opts(struct m_config *config);
 // backups afterwards.
 void m_config_restore_backups(struct m_config *config);
 
+// Exchange the current values of all backed up options with their backups.
+// Calling it twice restores the original state.
+void m_config_swap_backups(struct m_config *config);
+
 enum {
     M_SETOPT_PRE_PARSE_ONLY = 1,    // Silently ignore non-M_OPT_PRE_PARSE opt.
     M_SETOPT_CHECK_ONLY = 2,        // Don't set, just check name/value
@@ -218,4 +222,10 @@ void m_config_set_profile(struct m_config *config, struct m_profile *p,
 void *m_config_alloc_struct(void *talloc_ctx,
                             const struct m_sub_options *subopts);
 
+// Return a deep copy of an option struct (such as struct MPOpts). Option values
+// stored in global variables are not copied. The copy is independent from the
+// original, and can be passed to other threads.
+void *m_config_copy_struct(void *talloc_ctx, const void *optstruct,
+                           size_t size, const struct m_option *options);
+
 #endif /* MPLAYER_M_CONFIG_H */
@@ -83,29 +83,112 @@ static bool translate_legacy_property(struct mp_log *log, const char *name,
     return true;
 }
 
-static int do_action(const m_option_t *prop_list, const char *name,
+struct m_property_index {
+    // Properties without wildcard, sorted by name.
+    const struct m_option **sorted;
+    int num_sorted;
+    // Properties with wildcard (like "vf*"), in list order.
+    const struct m_option **wildcards;
+    int num_wildcards;
+};
+
+struct m_property_handle {
+    const struct m_option *prop;
+    char *key;      // for "name/key" paths, NULL otherwise
+    char *name;     // full property path, with legacy names translated
+};
+
+static bool is_wildcard(const struct m_option *opt)
+{
+    return (opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD) &&
+           bstr_endswith0(bstr0(opt->name), "*");
+}
+
+static int compare_prop_name(const void *a, const void *b)
+{
+    const struct m_option *pa = *(const struct m_option **)a;
+    const struct m_option *pb = *(const struct m_option **)b;
+    return strcmp(pa->name, pb->name);
+}
+
+struct m_property_index *m_property_index_new(void *talloc_ctx,
+                                              const struct m_option *prop_list)
+{
+    struct m_property_index *index = talloc_zero(talloc_ctx,
+                                                 struct m_property_index);
+    for (int n = 0; prop_list[n].name; n++) {
+        const struct m_option *opt = &prop_list[n];
+        if (is_wildcard(opt)) {
+            MP_TARRAY_APPEND(index, index->wildcards, index->num_wildcards, opt);
+        } else {
+            MP_TARRAY_APPEND(index, index->sorted, index->num_sorted, opt);
+        }
+    }
+    qsort(index->sorted, index->num_sorted, sizeof(index->sorted[0]),
+          compare_prop_name);
+    return index;
+}
+
+// Same result as m_option_list_find() on the original list: if there are
+// several matches, the one that comes first in the list wins.
+static const struct m_option *index_find(struct m_property_index *index,
+                                         bstr name)
+{
+    const struct m_option *res = NULL;
+    int lo = 0, hi = index->num_sorted;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = bstrcmp(bstr0(index->sorted[mid]->name), name);
+        if (c == 0) {
+            res = index->sorted[mid];
+            break;
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (int n = 0; n < index->num_wildcards; n++) {
+        const struct m_option *opt = index->wildcards[n];
+        bstr prefix = bstr0(opt->name);
+        prefix.len--;
+        if (bstr_startswith(name, prefix)) {
+            if (!res || opt < res)
+                res = opt;
+            break;
+        }
+    }
+    return res;
+}
+
+// Split "name/key" and look up the property. *key is set to NULL, or points
+// into name.
+static const struct m_option *resolve(struct m_property_index *index,
+                                      const char *name, const char **key)
+{
+    const char *sep = strchr(name, '/');
+    *key = NULL;
+    if (sep && sep[1]) {
+        *key = sep + 1;
+        return index_find(index, (bstr){(unsigned char *)name, sep - name});
+    }
+    return index_find(index, bstr0(name));
+}
+
+static int do_action(const struct m_option *prop, const char *key,
                      int action, void *arg, void *ctx)
 {
-    const char *sep;
-    const m_option_t *prop;
     struct m_property_action_arg ka;
-    if ((sep = strchr(name, '/')) && sep[1]) {
-        int len = sep - name;
-        char base[len + 1];
-        memcpy(base, name, len);
-        base[len] = 0;
-        prop = m_option_list_find(prop_list, base);
+    if (key) {
         ka = (struct m_property_action_arg) {
-            .key = sep + 1,
+            .key = key,
             .action = action,
             .arg = arg,
         };
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
-    } else
-        prop = m_option_list_find(prop_list, name);
-    if (!prop)
-        return M_PROPERTY_UNKNOWN;
+    }
     int (*control)(const m_option_t*, int, void*, void*) = prop->p;
     int r = control(prop, action, arg, ctx);
     if (action == M_PROPERTY_GET_TYPE && r < 0 &&
@@ -117,29 +200,26 @@ static int do_action(const m_option_t *prop_list, const char *name,
     return r;
 }
 
-// (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const m_option_t *prop_list,
-                  const char *in_name, int action, void *arg, void *ctx)
+// name is the full property path, and used for messages only.
+static int do_property(struct mp_log *log, const struct m_option *prop,
+                       const char *key, const char *name, int action,
+                       void *arg, void *ctx)
 {
     union m_option_value val = {0};
     int r;
 
-    char name[64];
-    if (!translate_legacy_property(log, in_name, name, sizeof(name)))
-        return M_PROPERTY_UNKNOWN;
-
     struct m_option opt = {0};
-    r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, &opt, ctx);
+    r = do_action(prop, key, M_PROPERTY_GET_TYPE, &opt, ctx);
     if (r <= 0)
         return r;
     assert(opt.type);
 
     switch (action) {
     case M_PROPERTY_PRINT: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_PRINT, arg, ctx)) >= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_PRINT, arg, ctx)) >= 0)
             return r;
         // Fallback to m_option
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_pretty_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -147,7 +227,7 @@ int m_property_do(struct mp_log *log, const m_option_t *prop_list,
         return str != NULL;
     }
     case M_PROPERTY_GET_STRING: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -160,7 +240,7 @@ int m_property_do(struct mp_log *log, const m_option_t *prop_list,
         // (reject 0 return value: success, but empty string with flag)
         if (m_option_parse(log, &opt, bstr0(name), bstr0(arg), &val) <= 0)
             return M_PROPERTY_ERROR;
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(prop, key, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
@@ -168,16 +248,16 @@ int m_property_do(struct mp_log *log, const m_option_t *prop_list,
         if (!log)
             return M_PROPERTY_ERROR;
         struct m_property_switch_arg *sarg = arg;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SWITCH, arg, ctx)) !=
+        if ((r = do_action(prop, key, M_PROPERTY_SWITCH, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // Fallback to m_option
         if (!opt.type->add)
             return M_PROPERTY_NOT_IMPLEMENTED;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(prop, key, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         opt.type->add(&opt, &val, sarg->inc, sarg->wrap);
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(prop, key, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
@@ -195,21 +275,64 @@ int m_property_do(struct mp_log *log, const m_option_t *prop_list,
                 return M_PROPERTY_ERROR;
             }
         }
-        return do_action(prop_list, name, M_PROPERTY_SET, arg, ctx);
+        return do_action(prop, key, M_PROPERTY_SET, arg, ctx);
     }
     default:
-        return do_action(prop_list, name, action, arg, ctx);
+        return do_action(prop, key, action, arg, ctx);
     }
 }
 
-static int m_property_do_bstr(const m_option_t *prop_list, bstr name,
+// (as a hack, log can be NULL on read-only paths)
+int m_property_do(struct mp_log *log, struct m_property_index *index,
+                  const char *in_name, int action, void *arg, void *ctx)
+{
+    char name[64];
+    if (!translate_legacy_property(log, in_name, name, sizeof(name)))
+        return M_PROPERTY_UNKNOWN;
+
+    const char *key;
+    const struct m_option *prop = resolve(index, name, &key);
+    if (!prop)
+        return M_PROPERTY_UNKNOWN;
+    return do_property(log, prop, key, name, action, arg, ctx);
+}
+
+struct m_property_handle *m_property_resolve(void *talloc_ctx,
+                                             struct mp_log *log,
+                                             struct m_property_index *index,
+                                             const char *in_name)
+{
+    char name[64];
+    if (!translate_legacy_property(log, in_name, name, sizeof(name)))
+        return NULL;
+
+    const char *key;
+    const struct m_option *prop = resolve(index, name, &key);
+    if (!prop)
+        return NULL;
+    struct m_property_handle *h = talloc_ptrtype(talloc_ctx, h);
+    *h = (struct m_property_handle) {
+        .prop = prop,
+        .name = talloc_strdup(h, name),
+        .key = key ? talloc_strdup(h, key) : NULL,
+    };
+    return h;
+}
+
+int m_property_do_handle(struct mp_log *log, struct m_property_handle *h,
+                         int action, void *arg, void *ctx)
+{
+    return do_property(log, h->prop, h->key, h->name, action, arg, ctx);
+}
+
+static int m_property_do_bstr(struct m_property_index *index, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
     if (name.len >= sizeof(name0))
         return M_PROPERTY_UNKNOWN;
     snprintf(name0, sizeof(name0), "%.*s", BSTR_P(name));
-    return m_property_do(NULL, prop_list, name0, action, arg, ctx);
+    return m_property_do(NULL, index, name0, action, arg, ctx);
 }
 
 static void append_str(char **s, int *len, bstr append)
@@ -219,8 +342,8 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const m_option_t *prop_list, char **ret, int *ret_len,
-                           bstr prop, bool silent_error, void *ctx)
+static int expand_property(struct m_property_index *index, char **ret,
+                           int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
     bool cond_no = !cond_yes && bstr_eatstart0(&prop, "!");
@@ -233,7 +356,7 @@ static int expand_property(const m_option_t *prop_list, char **ret, int *ret_len
     int method = raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
 
     char *s = NULL;
-    int r = m_property_do_bstr(prop_list, prop, method, &s, ctx);
+    int r = m_property_do_bstr(index, prop, method, &s, ctx);
     bool skip;
     if (comp) {
         skip = ((s && bstr_equals0(comp_with, s)) != cond_yes);
@@ -250,7 +373,7 @@ static int expand_property(const m_option_t *prop_list, char **ret, int *ret_len
     return skip;
 }
 
-char *m_properties_expand_string(const m_option_t *prop_list,
+char *m_properties_expand_string(struct m_property_index *index,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
@@ -276,7 +399,7 @@ char *m_properties_expand_string(const m_option_t *prop_list,
             bool have_fallback = bstr_eatstart0(&str, ":");
 
             if (!skip) {
-                skip = expand_property(prop_list, &ret, &ret_len, name,
+                skip = expand_property(index, &ret, &ret_len, name,
                                        have_fallback, ctx);
                 if (skip)
                     skip_level = level;
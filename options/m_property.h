@@ -103,13 +103,32 @@ enum mp_property_return {
     M_PROPERTY_UNKNOWN = -3,
 };
 
+// Lookup structure for a property list. Create it once, and use it for all
+// accesses to properties from that list.
+struct m_property_index;
+struct m_property_index *m_property_index_new(void *talloc_ctx,
+                                              const struct m_option *prop_list);
+
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_option* prop_list,
+int m_property_do(struct mp_log *log, struct m_property_index *index,
                   const char* property_name, int action, void* arg, void *ctx);
 
+// A property name (including "name/key" sub-properties) resolved in advance,
+// to avoid the lookup on every access. Valid as long as the index is.
+// Returns NULL if the property doesn't exist.
+struct m_property_handle;
+struct m_property_handle *m_property_resolve(void *talloc_ctx,
+                                             struct mp_log *log,
+                                             struct m_property_index *index,
+                                             const char *property_name);
+
+// Like m_property_do(), with a resolved property.
+int m_property_do_handle(struct mp_log *log, struct m_property_handle *h,
+                         int action, void *arg, void *ctx);
+
 // Print a list of properties.
 void m_properties_print_help_list(struct mp_log *log,
                                   const struct m_option* list);
@@ -126,7 +145,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_option* prop_list,
+char* m_properties_expand_string(struct m_property_index *index,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
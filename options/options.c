@@ -440,6 +440,7 @@ const m_option_t mp_opts[] = {
                ({"simple", 0}, {"complex", 1})),
     OPT_CHOICE("ass-style-override", ass_style_override, 0,
                ({"no", 0}, {"yes", 1})),
+    OPT_FLAG("ass-render-ahead", ass_render_ahead, 0),
     OPT_FLAG("osd-bar", osd_bar_visible, 0),
     OPT_FLOATRANGE("osd-bar-align-x", osd_bar_align_x, 0, -1.0, +1.0),
     OPT_FLOATRANGE("osd-bar-align-y", osd_bar_align_y, 0, -1.0, +1.0),
@@ -471,6 +472,7 @@ const m_option_t mp_opts[] = {
                 {"yes", 1}, {"", 1})),
     OPT_STRING("volume-restore-data", mixer_restore_volume_data, 0),
     OPT_FLAG("gapless-audio", gapless_audio, 0),
+    OPT_FLOATRANGE("ao-stats-interval", ao_stats_interval, 0, 0, 3600),
 
     // set screen dimensions (when not detectable or virtual!=visible)
     OPT_INTRANGE("screenw", vo.screenwidth, CONF_GLOBAL, 0, 4096),
@@ -568,6 +570,7 @@ const m_option_t mp_opts[] = {
     OPT_CHOICE_OR_INT("loop", loop_times, M_OPT_GLOBAL, 2, 10000,
                       ({"no", -1}, {"1", -1},
                        {"inf", 0})),
+    OPT_FLOATRANGE("prefetch-playlist", prefetch_playlist, 0, 0, 3600),
 
     OPT_FLAG("resume-playback", position_resume, 0),
     OPT_FLAG("save-position-on-quit", position_save_on_quit, 0),
@@ -589,6 +592,7 @@ const m_option_t mp_opts[] = {
     OPT_CHOICE("hr-seek", hr_seek, 0,
                ({"no", -1}, {"absolute", 0}, {"always", 1}, {"yes", 1})),
     OPT_FLOATRANGE("hr-seek-demuxer-offset", hr_seek_demuxer_offset, 0, -9, 99),
+    OPT_INTRANGE("backstep-cache", backstep_cache, 0, 0, 65536),
     OPT_CHOICE_OR_INT("autosync", autosync, 0, 0, 10000,
                       ({"no", -1})),
 
@@ -643,6 +647,9 @@ const m_option_t mp_opts[] = {
     OPT_FLAG("oneverdrop", encode_output.neverdrop, CONF_GLOBAL),
     OPT_FLAG("ovfirst", encode_output.video_first, CONF_GLOBAL),
     OPT_FLAG("oafirst", encode_output.audio_first, CONF_GLOBAL),
+    OPT_FLAG("ocopy", encode_output.copy, CONF_GLOBAL),
+    OPT_INTRANGE("oparallel", encode_output.parallel, CONF_GLOBAL, 0, 64),
+    OPT_INT("oparallel-status-fd", encode_output.status_fd, CONF_GLOBAL),
 #endif
 
     {NULL, NULL, 0, 0, 0, 0, NULL}
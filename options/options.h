@@ -64,6 +64,7 @@ typedef struct MPOpts {
     int volstep;
     float softvol_max;
     int gapless_audio;
+    float ao_stats_interval;
 
     mp_vo_opts vo;
 
@@ -95,6 +96,7 @@ typedef struct MPOpts {
     char *stream_capture;
     char *stream_dump;
     int loop_times;
+    float prefetch_playlist;
     int shuffle;
     int ordered_chapters;
     char *ordered_chapters_files;
@@ -118,6 +120,7 @@ typedef struct MPOpts {
     int initial_audio_sync;
     int hr_seek;
     float hr_seek_demuxer_offset;
+    int backstep_cache;
     float audio_delay;
     float default_max_pts_correction;
     int autosync;
@@ -214,6 +217,7 @@ typedef struct MPOpts {
     int ass_style_override;
     int ass_hinting;
     int ass_shaper;
+    int ass_render_ahead;
 
     int hwdec_api;
     char *hwdec_codecs;
@@ -265,6 +269,7 @@ typedef struct MPOpts {
         int ar_rate;
         char *js_dev;
         char *in_file;
+        char *ipc_path;
         int use_joystick;
         int use_lirc;
         char *lirc_configfile;
@@ -295,6 +300,9 @@ typedef struct MPOpts {
         int neverdrop;
         int video_first;
         int audio_first;
+        int copy;
+        int parallel;
+        int status_fd;
     } encode_output;
 } MPOpts;
 
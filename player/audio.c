@@ -54,9 +54,10 @@ static int build_afilter_chain(struct MPContext *mpctx)
 
     int new_srate;
     if (af_control_any_rev(d_audio->afilter, AF_CONTROL_SET_PLAYBACK_SPEED,
-                           &opts->playback_speed))
+                           &opts->playback_speed)) {
         new_srate = in_format.rate;
-    else {
+        mpctx->audio_resample_speed = 0;
+    } else {
         new_srate = in_format.rate * opts->playback_speed;
         if (new_srate != ao->samplerate) {
             // limits are taken from libaf/af_resample.c
@@ -66,9 +67,16 @@ static int build_afilter_chain(struct MPContext *mpctx)
                 new_srate = 192000;
             opts->playback_speed = new_srate / (double)in_format.rate;
         }
+        mpctx->audio_resample_speed = opts->playback_speed;
     }
-    return audio_init_filters(d_audio, new_srate,
-                              &ao->samplerate, &ao->channels, &ao->format);
+    if (!audio_init_filters(d_audio, new_srate,
+                            &ao->samplerate, &ao->channels, &ao->format))
+        return 0;
+    // Reset the speed factor of filters that were not recreated.
+    double factor = 1.0;
+    af_control_all(d_audio->afilter, AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE,
+                   &factor);
+    return 1;
 }
 
 static int recreate_audio_filters(struct MPContext *mpctx)
@@ -101,6 +109,19 @@ int reinit_audio_filters(struct MPContext *mpctx)
     return 0;
 }
 
+// Try to apply a playback speed change by adjusting the resampler, instead of
+// rebuilding the audio filter chain. This is cheap and glitch-free, but only
+// works for small changes. Returns false if the chain has to be rebuilt.
+bool update_audio_speed(struct MPContext *mpctx)
+{
+    struct dec_audio *d_audio = mpctx->d_audio;
+    if (!d_audio || !d_audio->afilter || !mpctx->audio_resample_speed)
+        return false;
+    double factor = mpctx->opts->playback_speed / mpctx->audio_resample_speed;
+    return af_control_any_rev(d_audio->afilter,
+                              AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE, &factor);
+}
+
 void reinit_audio_chain(struct MPContext *mpctx)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -278,6 +299,34 @@ static int write_silence_to_ao(struct MPContext *mpctx, int samples, int flags,
     return r;
 }
 
+// Audio decoded before the sync position, to give decoders time to settle.
+#define AUDIO_SEEK_PREROLL 0.5
+
+// After a seek, drop audio packets that are far before the sync position,
+// instead of decoding and filtering audio that is thrown away anyway.
+static void skip_audio_packets(struct MPContext *mpctx, double sync_pts)
+{
+    struct dec_audio *d_audio = mpctx->d_audio;
+
+    // Only if nothing was decoded since the decoder was reset.
+    if (sync_pts == MP_NOPTS_VALUE || d_audio->pts != MP_NOPTS_VALUE ||
+        mp_audio_buffer_samples(mpctx->ao->buffer))
+        return;
+
+    // Packet timestamps don't include the offset (see written_audio_pts()).
+    double target = sync_pts - mpctx->video_offset - AUDIO_SEEK_PREROLL;
+    int skipped = 0;
+    while (1) {
+        double pts = demux_get_next_pts(d_audio->header);
+        if (pts == MP_NOPTS_VALUE || pts >= target)
+            break;
+        talloc_free(demux_read_packet(d_audio->header));
+        skipped++;
+    }
+    if (skipped)
+        MP_DBG(mpctx, "Skipped %d audio packets before %f.\n", skipped, target);
+}
+
 #define ASYNC_PLAY_DONE -3
 static int audio_start_sync(struct MPContext *mpctx, int playsize)
 {
@@ -288,6 +337,14 @@ static int audio_start_sync(struct MPContext *mpctx, int playsize)
 
     assert(d_audio);
 
+    bool hrseek = mpctx->hrseek_active;   // audio only hrseek
+    if (hrseek) {
+        skip_audio_packets(mpctx, mpctx->hrseek_pts);
+    } else if (mpctx->video_next_pts != MP_NOPTS_VALUE) {
+        skip_audio_packets(mpctx, mpctx->video_next_pts + mpctx->delay +
+                                  mpctx->audio_delay);
+    }
+
     // Timing info may not be set without
     res = audio_decode(d_audio, ao->buffer, 1);
     if (res < 0)
@@ -297,7 +354,6 @@ static int audio_start_sync(struct MPContext *mpctx, int playsize)
     bool did_retry = false;
     double written_pts;
     double real_samplerate = ao->samplerate / opts->playback_speed;
-    bool hrseek = mpctx->hrseek_active;   // audio only hrseek
     mpctx->hrseek_active = false;
     while (1) {
         written_pts = written_audio_pts(mpctx);
@@ -73,6 +73,7 @@
 
 #include "core.h"
 #include "lua.h"
+#include "ipc.h"
 
 struct command_ctx {
     int events;
@@ -84,7 +85,33 @@ struct command_ctx {
     int num_cycle_counters;
 
 #define OVERLAY_MAX_ID 64
-    void *overlay_map[OVERLAY_MAX_ID];
+    struct overlay {
+        void *bitmap;
+        // Memory backing the bitmap: either mmap'ed, or an image.
+        void *map_start;
+        size_t map_size;
+        struct mp_image *image;
+    } overlays[OVERLAY_MAX_ID];
+
+    struct m_property_index *properties;
+
+    struct mp_property_observer **observers;
+    int num_observers;
+    bool updating_observers;
+};
+
+struct mp_property_observer {
+    char *name;
+    struct m_property_handle *handle;   // NULL if property doesn't exist
+    mp_property_observer_cb cb;
+    void *cb_ctx;
+    struct m_option type;
+    union m_option_value value;
+    bool valid;         // value is set (property was available)
+    bool delivered;     // callback was called at least once
+    bool dead;          // unobserved while iterating the observer list
+    bool dirty;         // value needs to be read again
+    bool on_tick;       // property changes during playback without notification
 };
 
 static int edit_filters(struct MPContext *mpctx, enum stream_type mediatype,
@@ -146,7 +173,7 @@ static int mp_property_playback_speed(m_option_t *prop, int action,
         opts->playback_speed = *(double *) arg;
         // Adjust time until next frame flip for nosound mode
         mpctx->time_frame *= orig_speed / opts->playback_speed;
-        if (mpctx->d_audio)
+        if (mpctx->d_audio && !update_audio_speed(mpctx))
             reinit_audio_chain(mpctx);
         return M_PROPERTY_OK;
     }
@@ -947,6 +974,80 @@ static int mp_property_channels(m_option_t *prop, int action, void *arg,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+/// AO underrun counter (RO)
+static int mp_property_ao_underruns(m_option_t *prop, int action, void *arg,
+                                    MPContext *mpctx)
+{
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int_ro(prop, action, arg, mpctx->ao->stats.underruns);
+}
+
+/// AO xruns the driver recovered from (RO)
+static int mp_property_ao_xruns(m_option_t *prop, int action, void *arg,
+                                MPContext *mpctx)
+{
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int_ro(prop, action, arg,
+                             mpctx->ao->stats.xruns_recovered);
+}
+
+/// Number of writes to the AO (RO)
+static int mp_property_ao_periods(m_option_t *prop, int action, void *arg,
+                                  MPContext *mpctx)
+{
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int64_ro(prop, action, arg,
+                               mpctx->ao->stats.periods_written);
+}
+
+/// AO buffer fill in seconds (RO)
+static int mp_property_ao_buffer(m_option_t *prop, int action, void *arg,
+                                 MPContext *mpctx)
+{
+    if (!mpctx->ao || !mpctx->ao->stats.fill_count)
+        return M_PROPERTY_UNAVAILABLE;
+    struct ao_stats *st = &mpctx->ao->stats;
+    double v = st->fill_sum / st->fill_count;
+    if (strcmp(prop->name, "ao-buffer-min") == 0)
+        v = st->fill_min;
+    if (strcmp(prop->name, "ao-buffer-max") == 0)
+        v = st->fill_max;
+    return m_property_double_ro(prop, action, arg, v);
+}
+
+/// Time spent blocking in the AO (RO)
+static int mp_property_ao_play_time(m_option_t *prop, int action, void *arg,
+                                    MPContext *mpctx)
+{
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(prop, action, arg, mpctx->ao->stats.play_time);
+}
+
+/// CPU time used by Lua scripts (RO)
+static int mp_property_script_cpu_time(m_option_t *prop, int action, void *arg,
+                                       MPContext *mpctx)
+{
+#if HAVE_LUA
+    if (!mpctx->lua_ctx)
+        return M_PROPERTY_UNAVAILABLE;
+    if (action == M_PROPERTY_KEY_ACTION) {
+        struct m_property_action_arg *ka = arg;
+        double t = mp_lua_get_cpu_time(mpctx, ka->key);
+        if (t < 0)
+            return M_PROPERTY_UNKNOWN;
+        return m_property_double_ro(prop, ka->action, ka->arg, t);
+    }
+    return m_property_double_ro(prop, action, arg,
+                                mp_lua_get_cpu_time(mpctx, NULL));
+#else
+    return M_PROPERTY_UNAVAILABLE;
+#endif
+}
+
 /// Balance (RW)
 static int mp_property_balance(m_option_t *prop, int action, void *arg,
                                MPContext *mpctx)
@@ -1576,6 +1677,13 @@ static int mp_property_osd_par(m_option_t *prop, int action, void *arg,
                                 mpctx->osd->last_vo_res.display_par);
 }
 
+/// Number of overlays waiting for a thumbnail (RO)
+static int mp_property_thumbnail_pending(m_option_t *prop, int action,
+                                         void *arg, MPContext *mpctx)
+{
+    return m_property_int_ro(prop, action, arg, thumbnail_get_pending(mpctx));
+}
+
 /// Video fps (RO)
 static int mp_property_fps(m_option_t *prop, int action, void *arg,
                            MPContext *mpctx)
@@ -1957,6 +2065,13 @@ static const m_option_t mp_properties[] = {
       0, 0, 0, NULL },
     { "channels", mp_property_channels, CONF_TYPE_INT,
       0, 0, 0, NULL },
+    { "ao-underruns", mp_property_ao_underruns, CONF_TYPE_INT },
+    { "ao-xruns-recovered", mp_property_ao_xruns, CONF_TYPE_INT },
+    { "ao-periods-written", mp_property_ao_periods, CONF_TYPE_INT64 },
+    { "ao-buffer-min", mp_property_ao_buffer, CONF_TYPE_DOUBLE },
+    { "ao-buffer-avg", mp_property_ao_buffer, CONF_TYPE_DOUBLE },
+    { "ao-buffer-max", mp_property_ao_buffer, CONF_TYPE_DOUBLE },
+    { "ao-play-time", mp_property_ao_play_time, CONF_TYPE_DOUBLE },
     M_OPTION_PROPERTY_CUSTOM("aid", mp_property_audio),
     { "balance", mp_property_balance, CONF_TYPE_FLOAT,
       M_OPT_RANGE, -1, 1, NULL },
@@ -2011,6 +2126,7 @@ static const m_option_t mp_properties[] = {
     { "osd-width", mp_property_osd_w, CONF_TYPE_INT },
     { "osd-height", mp_property_osd_h, CONF_TYPE_INT },
     { "osd-par", mp_property_osd_par, CONF_TYPE_DOUBLE },
+    { "thumbnail-pending", mp_property_thumbnail_pending, CONF_TYPE_INT },
 
     // Subs
     M_OPTION_PROPERTY_CUSTOM("sid", mp_property_sub),
@@ -2040,6 +2156,8 @@ static const m_option_t mp_properties[] = {
       M_OPT_RANGE, -100, 100, .offset = TV_COLOR_HUE },
 #endif
 
+    { "script-cpu-time", mp_property_script_cpu_time, CONF_TYPE_DOUBLE },
+
     M_PROPERTY_ALIAS("video", "vid"),
     M_PROPERTY_ALIAS("audio", "aid"),
     M_PROPERTY_ALIAS("sub", "sid"),
@@ -2054,15 +2172,41 @@ const struct m_option *mp_get_property_list(void)
     return mp_properties;
 }
 
+static bool is_property_write(int action)
+{
+    return action == M_PROPERTY_SET || action == M_PROPERTY_SET_STRING ||
+           action == M_PROPERTY_SWITCH || action == M_PROPERTY_KEY_ACTION;
+}
+
 int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
-    return m_property_do(ctx->log, mp_properties, name, action, val, ctx);
+    if (is_property_write(action))
+        mp_notify_property(ctx, NULL);
+    return m_property_do(ctx->log, ctx->command_ctx->properties, name, action,
+                         val, ctx);
+}
+
+struct m_property_handle *mp_property_resolve(void *talloc_ctx,
+                                              struct MPContext *mpctx,
+                                              const char *name)
+{
+    return m_property_resolve(talloc_ctx, mpctx->log,
+                              mpctx->command_ctx->properties, name);
+}
+
+int mp_property_do_handle(struct m_property_handle *h, int action, void *val,
+                          struct MPContext *mpctx)
+{
+    if (is_property_write(action))
+        mp_notify_property(mpctx, NULL);
+    return m_property_do_handle(mpctx->log, h, action, val, mpctx);
 }
 
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
-    return m_properties_expand_string(mp_properties, str, mpctx);
+    return m_properties_expand_string(mpctx->command_ctx->properties, str,
+                                      mpctx);
 }
 
 void property_print_help(struct mp_log *log)
@@ -2338,15 +2482,13 @@ static int edit_filters_osd(struct MPContext *mpctx, enum stream_type mediatype,
     return r;
 }
 
-#if HAVE_SYS_MMAN_H
-
 static int ext2_sub_find(struct MPContext *mpctx, int id)
 {
     struct command_ctx *cmd = mpctx->command_ctx;
     struct sub_bitmaps *sub = &mpctx->osd->external2;
     void *p = NULL;
     if (id >= 0 && id < OVERLAY_MAX_ID)
-        p = cmd->overlay_map[id];
+        p = cmd->overlays[id].bitmap;
     if (sub && p) {
         for (int n = 0; n < sub->num_parts; n++) {
             if (sub->parts[n].bitmap == p)
@@ -2365,12 +2507,71 @@ static int ext2_sub_alloc(struct MPContext *mpctx)
     return sub->num_parts - 1;
 }
 
+// Release the memory backing the overlay (but don't touch the OSD).
+static void overlay_free(struct overlay *ov)
+{
+#if HAVE_SYS_MMAN_H
+    if (ov->map_start)
+        munmap(ov->map_start, ov->map_size);
+#endif
+    talloc_free(ov->image);
+    *ov = (struct overlay){0};
+}
+
+// Show the given BGRA bitmap as overlay with the given ID. On success, the
+// overlay takes over ownership of the memory described by ov.
+static int overlay_set(struct MPContext *mpctx, int id, int x, int y,
+                       struct overlay *ov, int w, int h, int stride)
+{
+    struct command_ctx *cmd = mpctx->command_ctx;
+    struct osd_state *osd = mpctx->osd;
+    int index = ext2_sub_find(mpctx, id);
+    if (index < 0)
+        index = ext2_sub_alloc(mpctx);
+    if (index < 0)
+        return -1;
+    overlay_free(&cmd->overlays[id]);
+    cmd->overlays[id] = *ov;
+    osd->external2.parts[index] = (struct sub_bitmap) {
+        .bitmap = ov->bitmap,
+        .stride = stride,
+        .x = x, .y = y,
+        .w = w, .h = h,
+        .dw = w, .dh = h,
+    };
+    osd->external2.bitmap_id = osd->external2.bitmap_pos_id = 1;
+    osd->external2.format = SUBBITMAP_RGBA;
+    osd->want_redraw = true;
+    return 0;
+}
+
+// Show a premultiplied IMGFMT_BGRA image as overlay (used for thumbnails).
+// Takes ownership of img.
+int mp_overlay_set_image(struct MPContext *mpctx, int id, int x, int y,
+                         struct mp_image *img)
+{
+    if (id < 0 || id >= OVERLAY_MAX_ID || img->imgfmt != IMGFMT_BGRA) {
+        talloc_free(img);
+        return -1;
+    }
+    struct overlay ov = {
+        .bitmap = img->planes[0],
+        .image = img,
+    };
+    if (overlay_set(mpctx, id, x, y, &ov, img->w, img->h, img->stride[0]) < 0)
+    {
+        talloc_free(img);
+        return -1;
+    }
+    return 0;
+}
+
+#if HAVE_SYS_MMAN_H
+
 static int overlay_add(struct MPContext *mpctx, int id, int x, int y,
                        char *file, int offset, char *fmt, int w, int h,
                        int stride)
 {
-    struct command_ctx *cmd = mpctx->command_ctx;
-    struct osd_state *osd = mpctx->osd;
     if (strcmp(fmt, "bgra") != 0) {
         MP_ERR(mpctx, "overlay_add: unsupported OSD format '%s'\n", fmt);
         return -1;
@@ -2397,39 +2598,32 @@ static int overlay_add(struct MPContext *mpctx, int id, int x, int y,
         MP_ERR(mpctx, "overlay_add: could not open or map '%s'\n", file);
         return -1;
     }
-    int index = ext2_sub_find(mpctx, id);
-    if (index < 0)
-        index = ext2_sub_alloc(mpctx);
-    if (index < 0) {
+    struct overlay ov = {
+        .bitmap = p,
+        .map_start = p,
+        .map_size = h * stride,
+    };
+    if (overlay_set(mpctx, id, x, y, &ov, w, h, stride) < 0) {
         munmap(p, h * stride);
         return -1;
     }
-    cmd->overlay_map[id] = p;
-    osd->external2.parts[index] = (struct sub_bitmap) {
-        .bitmap = p,
-        .stride = stride,
-        .x = x, .y = y,
-        .w = w, .h = h,
-        .dw = w, .dh = h,
-    };
-    osd->external2.bitmap_id = osd->external2.bitmap_pos_id = 1;
-    osd->external2.format = SUBBITMAP_RGBA;
-    osd->want_redraw = true;
     return 0;
 }
 
+#endif
+
 static void overlay_remove(struct MPContext *mpctx, int id)
 {
     struct command_ctx *cmd = mpctx->command_ctx;
     struct osd_state *osd = mpctx->osd;
+    thumbnail_cancel(mpctx, id);
     int index = ext2_sub_find(mpctx, id);
     if (index >= 0) {
         struct sub_bitmaps *sub = &osd->external2;
-        struct sub_bitmap *part = &sub->parts[index];
-        munmap(part->bitmap, part->h * part->stride);
         MP_TARRAY_REMOVE_AT(sub->parts, sub->num_parts, index);
-        cmd->overlay_map[id] = NULL;
+        overlay_free(&cmd->overlays[id]);
         sub->bitmap_id = sub->bitmap_pos_id = 1;
+        osd->want_redraw = true;
     }
 }
 
@@ -2439,12 +2633,6 @@ static void overlay_uninit(struct MPContext *mpctx)
         overlay_remove(mpctx, id);
 }
 
-#else
-
-static void overlay_uninit(struct MPContext *mpctx){}
-
-#endif
-
 struct cycle_counter {
     char **args;
     int counter;
@@ -2523,7 +2711,7 @@ static bool check_property_autorepeat(char *property,  struct MPContext *mpctx)
     return true;
 }
 
-void run_command(MPContext *mpctx, mp_cmd_t *cmd)
+int run_command(MPContext *mpctx, mp_cmd_t *cmd)
 {
     struct command_ctx *cmdctx = mpctx->command_ctx;
     struct MPOpts *opts = mpctx->opts;
@@ -2534,6 +2722,7 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
     bool bar_osd = auto_osd || (on_osd & MP_ON_OSD_BAR);
     bool msg_or_nobar_osd = msg_osd && !(auto_osd && opts->osd_bar_visible);
     int osdl = msg_osd ? 1 : OSD_LEVEL_INVISIBLE;
+    int ret = 0;
 
     if (cmd->flags & MP_EXPAND_PROPERTIES) {
         for (int n = 0; n < cmd->nargs; n++) {
@@ -2541,12 +2730,15 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
                 cmd->args[n].v.s =
                     mp_property_expand_string(mpctx, cmd->args[n].v.s);
                 if (!cmd->args[n].v.s)
-                    return;
+                    return -1;
                 talloc_steal(cmd, cmd->args[n].v.s);
             }
         }
     }
 
+    // Commands can change about any property, directly or as side-effect.
+    mp_notify_property(mpctx, NULL);
+
     switch (cmd->id) {
     case MP_CMD_SEEK: {
         double v = cmd->args[0].v.d * cmd->scale;
@@ -2591,9 +2783,11 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         if (r == M_PROPERTY_OK || r == M_PROPERTY_UNAVAILABLE) {
             show_property_osd(mpctx, cmd->args[0].v.s, on_osd);
         } else if (r == M_PROPERTY_UNKNOWN) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Unknown property: '%s'", cmd->args[0].v.s);
         } else if (r <= 0) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Failed to set property '%s' to '%s'",
                         cmd->args[0].v.s, cmd->args[1].v.s);
@@ -2620,9 +2814,11 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         if (r == M_PROPERTY_OK || r == M_PROPERTY_UNAVAILABLE) {
             show_property_osd(mpctx, property, on_osd);
         } else if (r == M_PROPERTY_UNKNOWN) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Unknown property: '%s'", property);
         } else if (r <= 0) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Failed to increment property '%s' by %g",
                         property, s.inc);
@@ -2638,9 +2834,11 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         if (r == M_PROPERTY_OK || r == M_PROPERTY_UNAVAILABLE) {
             show_property_osd(mpctx, property, on_osd);
         } else if (r == M_PROPERTY_UNKNOWN) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Unknown property: '%s'", property);
         } else if (r <= 0) {
+            ret = -1;
             set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                         "Failed to multiply property '%s' by %g", property, f);
         }
@@ -2671,9 +2869,11 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
             if (r == M_PROPERTY_OK || r == M_PROPERTY_UNAVAILABLE) {
                 show_property_osd(mpctx, property, on_osd);
             } else if (r == M_PROPERTY_UNKNOWN) {
+                ret = -1;
                 set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                             "Unknown property: '%s'", property);
             } else if (r <= 0) {
+                ret = -1;
                 set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration,
                             "Failed to set property '%s' to '%s'",
                             property, value);
@@ -2687,6 +2887,7 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         int r = mp_property_do(cmd->args[0].v.s, M_PROPERTY_GET_STRING,
                                &tmp, mpctx);
         if (r <= 0) {
+            ret = -1;
             MP_WARN(mpctx, "Failed to get value of property '%s'.\n",
                     cmd->args[0].v.s);
             MP_INFO(mpctx, "ANS_ERROR=%s\n", property_error_string(r));
@@ -2826,6 +3027,7 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
             }
         } else {
             MP_ERR(mpctx, "Unable to load playlist %s.\n", filename);
+            ret = -1;
         }
         break;
     }
@@ -3020,7 +3222,8 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
 #endif /* HAVE_TV */
 
     case MP_CMD_SUB_ADD:
-        mp_add_subtitles(mpctx, cmd->args[0].v.s);
+        if (!mp_add_subtitles(mpctx, cmd->args[0].v.s))
+            ret = -1;
         break;
 
     case MP_CMD_SUB_REMOVE: {
@@ -3093,6 +3296,7 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
                 set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration, "vo='%s'", s);
             } else {
                 set_osd_msg(mpctx, OSD_MSG_TEXT, osdl, osd_duration, "Failed!");
+                ret = -1;
             }
         }
         break;
@@ -3123,15 +3327,31 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
                     cmd->args[3].v.s, cmd->args[4].v.i, cmd->args[5].v.s,
                     cmd->args[6].v.i, cmd->args[7].v.i, cmd->args[8].v.i);
         break;
+#endif
 
     case MP_CMD_OVERLAY_REMOVE:
         overlay_remove(mpctx, cmd->args[0].v.i);
         break;
-#endif
+
+    case MP_CMD_THUMBNAIL: {
+        int id = cmd->args[0].v.i;
+        if (id < 0 || id >= OVERLAY_MAX_ID) {
+            MP_ERR(mpctx, "thumbnail: invalid id %d\n", id);
+            ret = -1;
+            break;
+        }
+        if (thumbnail_request(mpctx, id, cmd->args[1].v.i, cmd->args[2].v.i,
+                              cmd->args[3].v.d, cmd->args[4].v.i,
+                              cmd->args[5].v.i) < 0)
+            ret = -1;
+        break;
+    }
 
     case MP_CMD_COMMAND_LIST: {
-        for (struct mp_cmd *sub = cmd->args[0].v.p; sub; sub = sub->queue_next)
-            run_command(mpctx, sub);
+        for (struct mp_cmd *sub = cmd->args[0].v.p; sub; sub = sub->queue_next) {
+            if (run_command(mpctx, sub) < 0)
+                ret = -1;
+        }
         break;
     }
 
@@ -3140,6 +3360,7 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
 
     default:
         MP_VERBOSE(mpctx, "Received unknown cmd %s\n", cmd->name);
+        ret = -1;
     }
 
     if (cmd->flags & MP_PAUSING)
@@ -3150,10 +3371,15 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         else
             pause_player(mpctx);
     }
+
+    return ret;
 }
 
 void command_uninit(struct MPContext *mpctx)
 {
+    struct command_ctx *ctx = mpctx->command_ctx;
+    while (ctx->num_observers)
+        mp_unobserve_property(mpctx, ctx->observers[0]);
     overlay_uninit(mpctx);
     talloc_free(mpctx->command_ctx);
     mpctx->command_ctx = NULL;
@@ -3165,18 +3391,177 @@ void command_init(struct MPContext *mpctx)
     *mpctx->command_ctx = (struct command_ctx){
         .last_seek_pts = MP_NOPTS_VALUE,
     };
+    mpctx->command_ctx->properties =
+        m_property_index_new(mpctx->command_ctx, mp_properties);
+}
+
+// Properties that change while playing, or because of things that happen
+// outside of the player, without anything calling mp_notify_property().
+// Observers of these are updated on every tick.
+static const char *const tick_properties[] = {
+    "stream-pos", "stream-end", "stream-length", "stream-time-pos", "length",
+    "avsync", "percent-pos", "time-pos", "time-remaining",
+    "playtime-remaining", "chapter", "angle", "metadata", "chapter-metadata",
+    "cache", "clock", "volume", "mute", "audio-bitrate", "video-bitrate",
+    "ao-underruns", "ao-xruns-recovered", "ao-periods-written",
+    "ao-buffer-min", "ao-buffer-avg", "ao-buffer-max", "ao-play-time",
+    "fullscreen", "width", "height", "dwidth", "dheight", "window-scale",
+    "fps", "aspect", "osd-width", "osd-height", "osd-par", "script-cpu-time",
+    NULL
+};
+
+// Whether the property "name" (or a sub-property of it) is "prop".
+static bool property_name_matches(const char *prop, const char *name)
+{
+    size_t len = strlen(prop);
+    return strncmp(name, prop, len) == 0 && (!name[len] || name[len] == '/');
 }
 
-// Notify that a property might have changed.
+static bool changes_on_tick(const char *name)
+{
+    for (int n = 0; tick_properties[n]; n++) {
+        if (property_name_matches(tick_properties[n], name))
+            return true;
+    }
+    return false;
+}
+
+// Notify that a property might have changed. NULL means any property.
 void mp_notify_property(struct MPContext *mpctx, const char *property)
 {
     mp_notify(mpctx, MP_EVENT_PROPERTY, (void *)property);
 }
 
+struct mp_property_observer *mp_observe_property(struct MPContext *mpctx,
+                                                 const char *name,
+                                                 mp_property_observer_cb cb,
+                                                 void *cb_ctx)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    struct mp_property_observer *obs = talloc_ptrtype(ctx, obs);
+    *obs = (struct mp_property_observer) {
+        .name = talloc_strdup(obs, name),
+        .cb = cb,
+        .cb_ctx = cb_ctx,
+        .dirty = true,
+        .on_tick = changes_on_tick(name),
+    };
+    obs->handle = mp_property_resolve(obs, mpctx, name);
+    MP_TARRAY_APPEND(ctx, ctx->observers, ctx->num_observers, obs);
+    return obs;
+}
+
+static void free_observer(struct mp_property_observer *obs)
+{
+    if (obs->valid)
+        m_option_free(&obs->type, &obs->value);
+    talloc_free(obs);
+}
+
+void mp_unobserve_property(struct MPContext *mpctx,
+                           struct mp_property_observer *obs)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    if (!obs)
+        return;
+    if (ctx->updating_observers) {
+        obs->dead = true;
+        return;
+    }
+    for (int n = 0; n < ctx->num_observers; n++) {
+        if (ctx->observers[n] == obs) {
+            MP_TARRAY_REMOVE_AT(ctx->observers, ctx->num_observers, n);
+            break;
+        }
+    }
+    free_observer(obs);
+}
+
+// Mark observers of the given property (or all if NULL) for re-reading.
+static void mark_observers(struct command_ctx *ctx, const char *name)
+{
+    for (int n = 0; n < ctx->num_observers; n++) {
+        struct mp_property_observer *obs = ctx->observers[n];
+        if (!name || property_name_matches(name, obs->name))
+            obs->dirty = true;
+    }
+}
+
+static bool property_value_equal(struct m_option *type, void *a, void *b)
+{
+    if (!type->type->free)
+        return memcmp(a, b, type->type->size) == 0;
+    if (type->type == CONF_TYPE_STRING) {
+        char *sa = *(char **)a, *sb = *(char **)b;
+        return sa == sb || (sa && sb && strcmp(sa, sb) == 0);
+    }
+    char *sa = m_option_print(type, a);
+    char *sb = m_option_print(type, b);
+    bool r = sa && sb && strcmp(sa, sb) == 0;
+    talloc_free(sa);
+    talloc_free(sb);
+    return r;
+}
+
+// Read the new value, and return whether it changed.
+static bool update_observer(struct MPContext *mpctx,
+                            struct mp_property_observer *obs)
+{
+    struct m_option type = {0};
+    union m_option_value val = {0};
+    bool valid = obs->handle &&
+        mp_property_do_handle(obs->handle, M_PROPERTY_GET_TYPE, &type,
+                              mpctx) > 0 &&
+        mp_property_do_handle(obs->handle, M_PROPERTY_GET, &val, mpctx) > 0;
+    bool changed = valid != obs->valid ||
+                   (valid && (type.type != obs->type.type ||
+                              !property_value_equal(&type, &val, &obs->value)));
+    if (obs->valid)
+        m_option_free(&obs->type, &obs->value);
+    obs->valid = valid;
+    obs->type = type;
+    obs->value = val;
+    return changed || !obs->delivered;
+}
+
+// Check the observed properties that might have changed since the last call,
+// and call the callbacks of those that did. Several changes between two calls
+// result in a single notification with the latest value.
+static void update_observers(struct MPContext *mpctx)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    ctx->updating_observers = true;
+    for (int n = 0; n < ctx->num_observers; n++) {
+        struct mp_property_observer *obs = ctx->observers[n];
+        if (obs->dead || !(obs->dirty || obs->on_tick))
+            continue;
+        obs->dirty = false;
+        if (update_observer(mpctx, obs)) {
+            obs->delivered = true;
+            obs->cb(obs->cb_ctx, obs->name, obs->valid ? &obs->type : NULL,
+                    obs->valid ? &obs->value : NULL);
+        }
+    }
+    ctx->updating_observers = false;
+    for (int n = ctx->num_observers - 1; n >= 0; n--) {
+        struct mp_property_observer *obs = ctx->observers[n];
+        if (obs->dead) {
+            MP_TARRAY_REMOVE_AT(ctx->observers, ctx->num_observers, n);
+            free_observer(obs);
+        }
+    }
+}
+
 void mp_notify(struct MPContext *mpctx, enum mp_event event, void *arg)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
     ctx->events |= 1u << event;
+    if (event == MP_EVENT_PROPERTY) {
+        mark_observers(ctx, arg);
+    } else if (event != MP_EVENT_TICK) {
+        // File and track changes affect most properties.
+        mark_observers(ctx, NULL);
+    }
 }
 
 static void handle_script_event(struct MPContext *mpctx, const char *name,
@@ -3185,6 +3570,25 @@ static void handle_script_event(struct MPContext *mpctx, const char *name,
 #if HAVE_LUA
     mp_lua_event(mpctx, name, arg);
 #endif
+#if HAVE_UNIX_SOCKET
+    if (strcmp(name, "tick") != 0)
+        mp_ipc_event(mpctx, name);
+#endif
+}
+
+// Run the functions script threads are waiting on, and handle requests from
+// IPC clients. Returns whether there were any.
+bool mp_handle_script_requests(struct MPContext *mpctx)
+{
+    bool r = false;
+#if HAVE_LUA
+    r |= mp_lua_process_requests(mpctx);
+#endif
+#if HAVE_UNIX_SOCKET
+    r |= mp_ipc_process_requests(mpctx);
+#endif
+    r |= thumbnail_process_results(mpctx);
+    return r;
 }
 
 void mp_flush_events(struct MPContext *mpctx)
@@ -3214,4 +3618,8 @@ void mp_flush_events(struct MPContext *mpctx)
                 ctx->last_seek_pts = MP_NOPTS_VALUE;
         }
     }
+
+    update_observers(mpctx);
+
+    mp_handle_script_requests(mpctx);
 }
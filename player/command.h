@@ -19,18 +19,28 @@
 #ifndef MPLAYER_COMMAND_H
 #define MPLAYER_COMMAND_H
 
+#include <stdbool.h>
+
 struct MPContext;
 struct mp_cmd;
 struct mp_log;
+struct m_property_handle;
+struct m_option;
 
 void command_init(struct MPContext *mpctx);
 void command_uninit(struct MPContext *mpctx);
 
-void run_command(struct MPContext *mpctx, struct mp_cmd *cmd);
+// Returns < 0 if the command failed.
+int run_command(struct MPContext *mpctx, struct mp_cmd *cmd);
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str);
 void property_print_help(struct mp_log *log);
 int mp_property_do(const char* name, int action, void* val,
                    struct MPContext *mpctx);
+struct m_property_handle *mp_property_resolve(void *talloc_ctx,
+                                              struct MPContext *mpctx,
+                                              const char *name);
+int mp_property_do_handle(struct m_property_handle *h, int action, void *val,
+                          struct MPContext *mpctx);
 
 const struct m_option *mp_get_property_list(void);
 
@@ -46,6 +56,29 @@ enum mp_event {
 void mp_notify(struct MPContext *mpctx, enum mp_event event, void *arg);
 void mp_notify_property(struct MPContext *mpctx, const char *property);
 
+// Called with the new value if an observed property changes (and once after
+// mp_observe_property() with the initial value). type and value are NULL if
+// the property is unavailable. value is freed after the callback returns.
+typedef void (*mp_property_observer_cb)(void *cb_ctx, const char *name,
+                                        struct m_option *type, void *value);
+
+// Changes are detected in mp_flush_events() by comparing the native property
+// values. A property is read again only after mp_notify_property(), a player
+// event or a command, except for the few that change continuously while
+// playing (see tick_properties in command.c).
+struct mp_property_observer;
+struct mp_property_observer *mp_observe_property(struct MPContext *mpctx,
+                                                 const char *name,
+                                                 mp_property_observer_cb cb,
+                                                 void *cb_ctx);
+void mp_unobserve_property(struct MPContext *mpctx,
+                           struct mp_property_observer *obs);
+
 void mp_flush_events(struct MPContext *mpctx);
+bool mp_handle_script_requests(struct MPContext *mpctx);
+
+struct mp_image;
+int mp_overlay_set_image(struct MPContext *mpctx, int id, int x, int y,
+                         struct mp_image *img);
 
 #endif /* MPLAYER_COMMAND_H */
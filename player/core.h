@@ -63,7 +63,8 @@ enum exit_reason {
 struct timeline_part {
     double start;
     double source_start;
-    struct demuxer *source;
+    struct demuxer *source;     // NULL if the source is currently closed
+    int source_id;              // index into timeline_sources, or -1
 };
 
 struct chapter {
@@ -184,6 +185,12 @@ typedef struct MPContext {
 
     struct demuxer **sources;
     int num_sources;
+    // Segment UIDs of the files last searched for ordered chapter sources.
+    struct mkv_uid_cache *mkv_uid_cache;
+    // Timeline sources which can be closed and reopened during playback.
+    struct timeline_source **timeline_sources;
+    int num_timeline_sources;
+    struct timeline_prefetch *timeline_prefetch;
 
     struct timeline_part *timeline;
     int num_timeline_parts;
@@ -283,7 +290,22 @@ typedef struct MPContext {
     uint64_t backstep_start_seek_ts;
     bool backstep_active;
 
+    // Recently decoded video frames (--backstep-cache), oldest first.
+    struct frame_cache_entry *frame_cache;
+    int num_frame_cache;
+    size_t frame_cache_bytes;
+    // pts of the frame last added by the decoder, MP_NOPTS_VALUE after a
+    // discontinuity.
+    double frame_cache_last_pts;
+    // Set while frames are shown from the cache. frame_cache_pos is the pts of
+    // the frame shown last; the decoder is still at frame_cache_last_pts.
+    bool frame_cache_active;
+    double frame_cache_pos;
+
     double audio_delay;
+    // Playback speed the audio filter chain's resampler was configured for,
+    // or 0 if the speed is handled by a filter like scaletempo.
+    double audio_resample_speed;
 
     double last_heartbeat;
     double last_metadata_update;
@@ -322,6 +344,11 @@ typedef struct MPContext {
     struct ass_renderer *ass_renderer;
     struct ass_library *ass_library;
     struct mp_log *ass_log;
+    // Copies of the fonts added to ass_library (for --ass-render-ahead). Only
+    // made if copy_ass_fonts was set when the file was loaded.
+    bool copy_ass_fonts;
+    struct demux_attachment *ass_fonts;
+    int num_ass_fonts;
 
     int last_dvb_step;
 
@@ -340,14 +367,26 @@ typedef struct MPContext {
 
     struct screenshot_ctx *screenshot_ctx;
     struct command_ctx *command_ctx;
+    struct thumbnail_ctx *thumbnail_ctx;
     struct encode_lavc_context *encode_lavc_ctx;
+    // Temporary files written by --oparallel, removed on exit.
+    char **encode_segments;
+    int num_encode_segments;
     struct lua_ctx *lua_ctx;
+    struct ipc_ctx *ipc_ctx;
     struct mp_nav_state *nav_state;
+
+    // Next playlist entry being opened in the background
+    struct prefetch_state *prefetch;
+
+    // Directory listings for external subtitle file discovery
+    struct mp_subfile_cache *subfile_cache;
 } MPContext;
 
 // audio.c
 void reinit_audio_chain(struct MPContext *mpctx);
 int reinit_audio_filters(struct MPContext *mpctx);
+bool update_audio_speed(struct MPContext *mpctx);
 double playing_audio_pts(struct MPContext *mpctx);
 int fill_audio_out_buffers(struct MPContext *mpctx, double endpts);
 double written_audio_pts(struct MPContext *mpctx);
@@ -389,6 +428,9 @@ struct playlist_entry *mp_next_file(struct MPContext *mpctx, int direction,
                                     bool force);
 void mp_set_playlist_entry(struct MPContext *mpctx, struct playlist_entry *e);
 void mp_play_files(struct MPContext *mpctx);
+void mp_prefetch_next(struct MPContext *mpctx);
+void mp_prefetch_cancel(struct MPContext *mpctx);
+void add_subtitle_fonts(struct MPContext *mpctx, struct demuxer *d);
 
 // main.c
 void mp_print_version(struct mp_log *log, int always);
@@ -403,8 +445,15 @@ double get_relative_time(struct MPContext *mpctx);
 void merge_playlist_files(struct playlist *pl);
 int mp_get_cache_percent(struct MPContext *mpctx);
 bool mp_get_cache_idle(struct MPContext *mpctx);
+struct mpv_global *mp_copy_global(void *talloc_ctx, struct MPContext *mpctx,
+                                  bool without_file_local);
 void update_window_title(struct MPContext *mpctx, bool force);
 void stream_dump(struct MPContext *mpctx);
+bool remux_file(struct MPContext *mpctx);
+
+// encode_parallel.c
+bool encode_parallel(struct MPContext *mpctx, int argc, char **argv);
+void encode_parallel_cleanup(struct MPContext *mpctx);
 
 // osd.c
 void write_status_line(struct MPContext *mpctx, const char *line);
@@ -446,6 +495,36 @@ void reinit_subs(struct MPContext *mpctx, int order);
 void update_osd_msg(struct MPContext *mpctx);
 void update_subtitles(struct MPContext *mpctx);
 
+// thumbnail.c
+int thumbnail_request(struct MPContext *mpctx, int id, int x, int y,
+                      double time, int w, int h);
+void thumbnail_cancel(struct MPContext *mpctx, int id);
+int thumbnail_get_pending(struct MPContext *mpctx);
+bool thumbnail_process_results(struct MPContext *mpctx);
+void thumbnail_uninit(struct MPContext *mpctx);
+
+// timeline/tl_open.c
+struct tl_open_request {
+    char *filename;                 // NULL to skip the request
+    char *demuxer_name;             // forced demuxer, or NULL to probe
+    struct demuxer_params *params;  // can be NULL
+    bool cache;                     // enable the stream cache
+    // Results
+    struct demuxer *demuxer;        // NULL on failure
+    bool was_valid;                 // see demuxer_params.matroska_was_valid
+};
+void tl_run_parallel(void (*fn)(void *ctx, int n), void *ctx, int num);
+void tl_open_sources(struct MPContext *mpctx, struct tl_open_request *reqs,
+                     int num_reqs);
+int timeline_add_source(struct MPContext *mpctx, struct tl_open_request *req,
+                        bool cache);
+void timeline_close_source(struct MPContext *mpctx, int id);
+void timeline_init_sources(struct MPContext *mpctx);
+bool timeline_open_part_source(struct MPContext *mpctx, int part);
+void timeline_update_sources(struct MPContext *mpctx);
+void timeline_prefetch_next(struct MPContext *mpctx);
+void timeline_uninit_sources(struct MPContext *mpctx);
+
 // timeline/tl_matroska.c
 void build_ordered_chapter_timeline(struct MPContext *mpctx);
 // timeline/tl_mpv_edl.c
@@ -460,5 +539,10 @@ double update_video(struct MPContext *mpctx, double endpts);
 void mp_force_video_refresh(struct MPContext *mpctx);
 void update_fps(struct MPContext *mpctx);
 void video_execute_format_change(struct MPContext *mpctx);
+void video_cache_clear(struct MPContext *mpctx);
+void video_cache_reset(struct MPContext *mpctx);
+struct mp_image *video_cache_get_prev(struct MPContext *mpctx, double pts);
+struct mp_image *video_cache_get_seek_target(struct MPContext *mpctx,
+                                             double pts);
 
 #endif /* MPLAYER_MP_CORE_H */
@@ -0,0 +1,438 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * --oparallel: the input is split into keyframe aligned segments, which are
+ * encoded by separate mpv processes. The segments are then concatenated into
+ * the real output file with stream copy (--ocopy), by playing them as a
+ * playlist.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifndef __MINGW32__
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "config.h"
+#include "talloc.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "common/encode.h"
+#include "common/playlist.h"
+#include "options/options.h"
+#include "options/m_config.h"
+#include "options/path.h"
+#include "demux/demux.h"
+#include "demux/stheader.h"
+#include "stream/stream.h"
+#include "osdep/io.h"
+#include "osdep/timer.h"
+#include "core.h"
+
+// fd number of the status pipe in the worker processes
+#define STATUS_FD 3
+
+struct segment {
+    double start, end;
+    char *filename;
+    int pid;
+    int status_fd;      // read end of the status pipe, -1 if closed
+    char buf[256];      // incomplete status line
+    int buf_len;
+    float pos;          // progress within the segment
+    struct encode_lavc_stats stats;
+    bool done;
+};
+
+#ifndef __MINGW32__
+
+// Find up to num segments between start and end (both can be MP_NOPTS_VALUE
+// for the file's start/end), and split them at video keyframes.
+// Returns the number of segments, or -1 on error.
+static int find_segments(struct MPContext *mpctx, const char *filename,
+                         double start, double end, int num,
+                         struct segment *segs)
+{
+    struct MPOpts *opts = mpctx->opts;
+    int count = -1;
+
+    struct stream *stream = stream_open(filename, mpctx->global);
+    if (!stream)
+        return -1;
+    struct demuxer *demuxer = demux_open(stream, opts->demuxer_name, NULL,
+                                         mpctx->global);
+    if (!demuxer)
+        goto done;
+
+    if (start == MP_NOPTS_VALUE)
+        start = demuxer_get_start_time(demuxer);
+    if (end == MP_NOPTS_VALUE) {
+        double len = demuxer_get_time_length(demuxer);
+        if (len <= 0)
+            goto done;
+        end = demuxer_get_start_time(demuxer) + len;
+    }
+    if (end <= start)
+        goto done;
+
+    struct sh_stream *video = NULL;
+    for (int n = 0; n < demuxer->num_streams; n++) {
+        struct sh_stream *sh = demuxer->streams[n];
+        if (!video && sh->type == STREAM_VIDEO && !sh->attached_picture)
+            video = sh;
+    }
+    for (int n = 0; n < demuxer->num_streams; n++) {
+        struct sh_stream *sh = demuxer->streams[n];
+        demuxer_select_track(demuxer, sh, sh == video);
+    }
+
+    count = 0;
+    segs[0].start = start;
+    for (int n = 1; n < num; n++) {
+        double pts = start + (end - start) * n / num;
+        if (video) {
+            // The worker starts decoding on the keyframe, so the segments
+            // don't need to overlap.
+            double keyframe = MP_NOPTS_VALUE;
+            demux_seek(demuxer, pts, SEEK_ABSOLUTE | SEEK_BACKWARD);
+            for (int i = 0; i < 1000; i++) {
+                struct demux_packet *dp = demux_read_packet(video);
+                if (!dp)
+                    break;
+                bool found = dp->keyframe && dp->pts != MP_NOPTS_VALUE;
+                if (found)
+                    keyframe = dp->pts;
+                talloc_free(dp);
+                if (found)
+                    break;
+            }
+            pts = keyframe;
+        }
+        if (pts == MP_NOPTS_VALUE || pts <= segs[count].start + 1.0 ||
+            pts >= end)
+            continue;
+        segs[count].end = pts;
+        count++;
+        segs[count].start = pts;
+    }
+    segs[count].end = end;
+    count++;
+
+done:
+    free_demuxer(demuxer);
+    free_stream(stream);
+    return count;
+}
+
+static bool start_worker(struct MPContext *mpctx, struct segment *seg,
+                         int argc, char **argv)
+{
+    void *tmp = talloc_new(NULL);
+    char **args = NULL;
+    int num_args = 0;
+
+    for (int n = 0; n < argc; n++)
+        MP_TARRAY_APPEND(tmp, args, num_args, argv[n]);
+    // These override the user's options, because they come last.
+    char *extra[] = {
+        talloc_asprintf(tmp, "--o=%s", seg->filename),
+        talloc_asprintf(tmp, "--start=%f", seg->start),
+        talloc_asprintf(tmp, "--end=%f", seg->end),
+        talloc_asprintf(tmp, "--oparallel-status-fd=%d", STATUS_FD),
+        "--oparallel=0",
+        "--ocopy=no",
+        "--quiet",
+        "--msglevel=all=warn",
+        "--no-consolecontrols",
+        "--no-resume-playback",
+#if HAVE_UNIX_SOCKET
+        "--input-unix-socket=",
+#endif
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(extra); n++)
+        MP_TARRAY_APPEND(tmp, args, num_args, extra[n]);
+    MP_TARRAY_APPEND(tmp, args, num_args, NULL);
+
+    int fds[2];
+    if (pipe(fds)) {
+        talloc_free(tmp);
+        return false;
+    }
+    mp_set_cloexec(fds[0]);
+    mp_set_cloexec(fds[1]);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // dup2() clears the CLOEXEC flag, unless the fd is already the same.
+        if (fds[1] == STATUS_FD) {
+            fcntl(STATUS_FD, F_SETFD, 0);
+        } else {
+            dup2(fds[1], STATUS_FD);
+        }
+        execvp(args[0], args);
+        _exit(1);
+    }
+    close(fds[1]);
+    talloc_free(tmp);
+    if (pid < 0) {
+        close(fds[0]);
+        return false;
+    }
+
+    seg->pid = pid;
+    seg->status_fd = fds[0];
+    return true;
+}
+
+// Read status lines written by encode_lavc_report_status().
+static void read_status(struct segment *seg)
+{
+    int r = read(seg->status_fd, seg->buf + seg->buf_len,
+                 sizeof(seg->buf) - 1 - seg->buf_len);
+    if (r < 0 && errno == EINTR)
+        return;
+    if (r <= 0) {
+        close(seg->status_fd);
+        seg->status_fd = -1;
+        return;
+    }
+    seg->buf_len += r;
+    seg->buf[seg->buf_len] = '\0';
+
+    char *end;
+    while ((end = strchr(seg->buf, '\n'))) {
+        *end = '\0';
+        float pos;
+        unsigned int frames;
+        double audioseconds;
+        long long bytes;
+        if (sscanf(seg->buf, "%f %u %lf %lld", &pos, &frames, &audioseconds,
+                   &bytes) == 4)
+        {
+            seg->pos = pos;
+            seg->stats.frames = frames;
+            seg->stats.audioseconds = audioseconds;
+            seg->stats.bytes = bytes;
+        }
+        seg->buf_len -= end + 1 - seg->buf;
+        memmove(seg->buf, end + 1, seg->buf_len + 1);
+    }
+    // Drop garbage that isn't a status line.
+    if (seg->buf_len >= sizeof(seg->buf) - 1)
+        seg->buf_len = 0;
+}
+
+static void print_progress(struct MPContext *mpctx, struct segment *segs,
+                           int num_segs, double start_time)
+{
+    struct encode_lavc_stats total = { .elapsed = mp_time_sec() - start_time };
+    double length = segs[num_segs - 1].end - segs[0].start;
+    double pos = 0;
+    int done = 0;
+
+    for (int n = 0; n < num_segs; n++) {
+        struct segment *seg = &segs[n];
+        double seg_pos = seg->done ? 1.0 : MPCLAMP(seg->pos, 0.0, 1.0);
+        pos += seg_pos * (seg->end - seg->start) / length;
+        total.frames += seg->stats.frames;
+        total.audioseconds += seg->stats.audioseconds;
+        total.bytes += seg->stats.bytes;
+        done += seg->done;
+    }
+
+    char lavcbuf[80];
+    encode_lavc_format_status(lavcbuf, sizeof(lavcbuf), &total, pos);
+    char *line = talloc_asprintf(NULL, "Encoding: %d/%d segments done, "
+                                 "%d%% %s", done, num_segs, (int)(pos * 100),
+                                 lavcbuf);
+    write_status_line(mpctx, line);
+    talloc_free(line);
+}
+
+// Run the workers, and wait until they are all done.
+static bool run_workers(struct MPContext *mpctx, struct segment *segs,
+                        int num_segs, int argc, char **argv)
+{
+    struct MPOpts *opts = mpctx->opts;
+    double start_time = mp_time_sec();
+    bool ok = true;
+
+    for (int n = 0; n < num_segs; n++) {
+        if (!start_worker(mpctx, &segs[n], argc, argv)) {
+            MP_FATAL(mpctx, "Could not start encoding worker: %s\n",
+                     strerror(errno));
+            segs[n].done = true;
+            ok = false;
+        }
+    }
+
+    struct pollfd *fds = talloc_array(NULL, struct pollfd, num_segs);
+    struct segment **fd_segs = talloc_array(NULL, struct segment *, num_segs);
+    while (1) {
+        int num_fds = 0;
+        for (int n = 0; n < num_segs; n++) {
+            if (segs[n].status_fd >= 0) {
+                fds[num_fds] = (struct pollfd){ .fd = segs[n].status_fd,
+                                                .events = POLLIN };
+                fd_segs[num_fds++] = &segs[n];
+            }
+        }
+        if (!num_fds)
+            break;
+        if (poll(fds, num_fds, 500) < 0 && errno != EINTR)
+            break;
+        for (int n = 0; n < num_fds; n++) {
+            if (fds[n].revents)
+                read_status(fd_segs[n]);
+        }
+        if (!opts->quiet)
+            print_progress(mpctx, segs, num_segs, start_time);
+    }
+    talloc_free(fds);
+    talloc_free(fd_segs);
+
+    // All status pipes are closed, so the workers have exited.
+    for (int n = 0; n < num_segs; n++) {
+        struct segment *seg = &segs[n];
+        if (!seg->pid)
+            continue;
+        int status = 0;
+        pid_t res;
+        while ((res = waitpid(seg->pid, &status, 0)) < 0 && errno == EINTR) {}
+        seg->done = true;
+        if (res < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            MP_FATAL(mpctx, "Encoding segment %d failed.\n", n + 1);
+            ok = false;
+        }
+    }
+    if (!opts->quiet)
+        print_progress(mpctx, segs, num_segs, start_time);
+    MP_INFO(mpctx, "\n");
+
+    return ok;
+}
+
+#endif
+
+// argc/argv: the full command line, including the program name.
+// Returns false on fatal errors. If parallel encoding is not possible, the
+// file is encoded normally.
+bool encode_parallel(struct MPContext *mpctx, int argc, char **argv)
+{
+#ifdef __MINGW32__
+    MP_WARN(mpctx, "--oparallel is not supported on this platform.\n");
+    return true;
+#else
+    struct MPOpts *opts = mpctx->opts;
+    struct encode_output_conf *eopts = &opts->encode_output;
+    int num_workers = eopts->parallel;
+    char *output = eopts->file;
+
+    if (playlist_entry_count(mpctx->playlist) != 1 || eopts->copy ||
+        eopts->rawts || !strcmp(output, "-") ||
+        !strncmp(output, "pipe:", 5) || !strcmp(output, "/dev/stdout"))
+    {
+        MP_WARN(mpctx, "Parallel encoding requires a single input file and "
+                "a regular output file, and can't be combined with --ocopy "
+                "or --orawts. Encoding normally.\n");
+        return true;
+    }
+    if (!(opts->play_start.type == REL_TIME_NONE ||
+          opts->play_start.type == REL_TIME_ABSOLUTE) ||
+        !(opts->play_end.type == REL_TIME_NONE ||
+          opts->play_end.type == REL_TIME_ABSOLUTE) ||
+        !(opts->play_length.type == REL_TIME_NONE ||
+          opts->play_length.type == REL_TIME_ABSOLUTE))
+    {
+        MP_WARN(mpctx, "Parallel encoding supports only absolute "
+                "--start/--end/--length times. Encoding normally.\n");
+        return true;
+    }
+
+    double start = MP_NOPTS_VALUE, end = MP_NOPTS_VALUE;
+    if (opts->play_start.type)
+        start = opts->play_start.pos;
+    if (opts->play_end.type) {
+        end = opts->play_end.pos;
+    } else if (opts->play_length.type) {
+        end = (start == MP_NOPTS_VALUE ? 0 : start) + opts->play_length.pos;
+    }
+
+    char *filename = mpctx->playlist->first->filename;
+    struct segment *segs = talloc_zero_array(NULL, struct segment, num_workers);
+    int num_segs = find_segments(mpctx, filename, start, end, num_workers,
+                                 segs);
+    if (num_segs < 2) {
+        MP_WARN(mpctx, "Could not split the file into segments. "
+                "Encoding normally.\n");
+        talloc_free(segs);
+        return true;
+    }
+
+    bstr root;
+    char *ext = mp_splitext(output, &root);
+    if (!ext)
+        root = bstr0(output);
+    for (int n = 0; n < num_segs; n++) {
+        segs[n].filename = talloc_asprintf(segs, "%.*s.part%d%s%s",
+                                           BSTR_P(root), n + 1,
+                                           ext ? "." : "", ext ? ext : "");
+        segs[n].status_fd = -1;
+        MP_VERBOSE(mpctx, "Segment %d: %f - %f -> %s\n", n + 1,
+                   segs[n].start, segs[n].end, segs[n].filename);
+    }
+
+    MP_INFO(mpctx, "Encoding %d segments in parallel.\n", num_segs);
+    bool ok = run_workers(mpctx, segs, num_segs, argc, argv);
+
+    // Concatenate the segments by remuxing them as a playlist.
+    playlist_clear(mpctx->playlist);
+    for (int n = 0; n < num_segs; n++) {
+        MP_TARRAY_APPEND(mpctx, mpctx->encode_segments,
+                         mpctx->num_encode_segments,
+                         talloc_strdup(mpctx, segs[n].filename));
+        playlist_add_file(mpctx->playlist, segs[n].filename);
+    }
+    // --ocopy works only with streams demuxed by libavformat.
+    m_config_set_option0(mpctx->mconfig, "demuxer", "lavf");
+    m_config_set_option0(mpctx->mconfig, "ocopy", "yes");
+    opts->play_start = opts->play_end = opts->play_length =
+        (struct m_rel_time){0};
+
+    talloc_free(segs);
+    return ok;
+#endif
+}
+
+// Remove the temporary segment files.
+void encode_parallel_cleanup(struct MPContext *mpctx)
+{
+    for (int n = 0; n < mpctx->num_encode_segments; n++) {
+        if (unlink(mpctx->encode_segments[n]) && errno != ENOENT)
+            MP_WARN(mpctx, "Could not remove %s\n", mpctx->encode_segments[n]);
+    }
+    mpctx->num_encode_segments = 0;
+}
@@ -0,0 +1,758 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "talloc.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_option.h"
+#include "options/m_property.h"
+#include "options/options.h"
+#include "input/input.h"
+#include "input/cmd_parse.h"
+#include "misc/json.h"
+#include "osdep/io.h"
+#include "core.h"
+#include "command.h"
+#include "ipc.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Clients sending longer lines, or not reading their replies, are dropped.
+#define MAX_LINE_SIZE (1024 * 1024)
+#define MAX_OUT_SIZE (16 * 1024 * 1024)
+
+struct ipc_ctx {
+    struct MPContext *mpctx;
+    struct mp_log *log;
+    char *path;
+    int listen_fd;
+    int wakeup_pipe[2];
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    // --- protected by lock
+    bool terminate;
+    struct ipc_request **requests;  // not a talloc child of ipc_ctx
+    int num_requests;
+    // Changed by the IPC thread only, which can read it without locking.
+    struct ipc_client **clients;
+    int num_clients;
+};
+
+// Created and read by the IPC thread, freed by the core (after the IPC thread
+// sent IPC_DISCONNECT, it doesn't access the client anymore).
+struct ipc_client {
+    struct ipc_ctx *ipc;
+    int fd;
+    bstr in;                        // IPC thread only; not a talloc child
+    bool eof;                       // IPC thread only; client stopped sending
+    // --- protected by ipc->lock
+    bstr out;                       // not a talloc child
+    bool overflow;
+    int pending;                    // queued requests not yet handled
+    // --- core only
+    struct ipc_observer **observers;
+    int num_observers;
+};
+
+struct ipc_observer {
+    struct ipc_client *client;
+    double id;
+    struct mp_property_observer *obs;
+};
+
+enum ipc_request_type {
+    IPC_COMMAND,
+    IPC_GET_PROPERTY,
+    IPC_GET_PROPERTY_STRING,
+    IPC_SET_PROPERTY,
+    IPC_OBSERVE_PROPERTY,
+    IPC_UNOBSERVE_PROPERTY,
+    IPC_DISCONNECT,
+    IPC_ERROR,                      // invalid request, reply with error
+};
+
+struct ipc_request {
+    enum ipc_request_type type;
+    struct ipc_client *client;
+    char *request_id;               // JSON text, or NULL
+    bool silent;                    // don't send a reply
+    struct mp_cmd *cmd;
+    char *name;
+    char *value;
+    double observe_id;
+    const char *error;
+};
+
+static void wakeup_thread(struct ipc_ctx *ipc)
+{
+    write(ipc->wakeup_pipe[1], &(char){0}, 1);
+}
+
+// --- Core side
+
+static void send_msg(struct ipc_client *client, bstr *msg)
+{
+    struct ipc_ctx *ipc = client->ipc;
+    bstr_xappend(NULL, msg, bstr0("\n"));
+    pthread_mutex_lock(&ipc->lock);
+    if (client->out.len + msg->len > MAX_OUT_SIZE) {
+        client->overflow = true;
+    } else {
+        bstr_xappend(NULL, &client->out, *msg);
+    }
+    pthread_mutex_unlock(&ipc->lock);
+    talloc_free(msg->start);
+    *msg = (bstr){0};
+    wakeup_thread(ipc);
+}
+
+static void write_value(bstr *dst, struct m_option *type, void *value)
+{
+    if (!type) {
+        bstr_xappend(NULL, dst, bstr0("null"));
+    } else if (type->type == CONF_TYPE_FLAG) {
+        bstr_xappend(NULL, dst, bstr0(*(int *)value ? "true" : "false"));
+    } else if (type->type == CONF_TYPE_INT) {
+        json_write_number(NULL, dst, *(int *)value);
+    } else if (type->type == CONF_TYPE_INT64) {
+        json_write_number(NULL, dst, *(int64_t *)value);
+    } else if (type->type == CONF_TYPE_FLOAT) {
+        json_write_number(NULL, dst, *(float *)value);
+    } else if (type->type == CONF_TYPE_DOUBLE ||
+               type->type == CONF_TYPE_TIME) {
+        json_write_number(NULL, dst, *(double *)value);
+    } else if (type->type == CONF_TYPE_STRING) {
+        char *s = *(char **)value;
+        if (s) {
+            json_write_string(NULL, dst, s);
+        } else {
+            bstr_xappend(NULL, dst, bstr0("null"));
+        }
+    } else if (type->type == CONF_TYPE_STRING_LIST) {
+        char **list = *(char ***)value;
+        bstr_xappend(NULL, dst, bstr0("["));
+        for (int n = 0; list && list[n]; n++) {
+            if (n)
+                bstr_xappend(NULL, dst, bstr0(","));
+            json_write_string(NULL, dst, list[n]);
+        }
+        bstr_xappend(NULL, dst, bstr0("]"));
+    } else {
+        char *s = m_option_print(type, value);
+        json_write_string(NULL, dst, s ? s : "");
+        talloc_free(s);
+    }
+}
+
+static const char *property_error(int r)
+{
+    switch (r) {
+    case M_PROPERTY_OK:                 return "success";
+    case M_PROPERTY_UNAVAILABLE:        return "property unavailable";
+    case M_PROPERTY_NOT_IMPLEMENTED:    return "property not implemented";
+    case M_PROPERTY_UNKNOWN:            return "property not found";
+    default:                            return "error running command";
+    }
+}
+
+// Send a reply. data is JSON text, or empty if the reply has no data.
+static void send_reply(struct ipc_request *req, const char *error, bstr data)
+{
+    if (req->silent)
+        return;
+    bstr msg = {0};
+    bstr_xappend(NULL, &msg, bstr0("{\"error\":"));
+    json_write_string(NULL, &msg, error);
+    if (data.len) {
+        bstr_xappend(NULL, &msg, bstr0(",\"data\":"));
+        bstr_xappend(NULL, &msg, data);
+    }
+    if (req->request_id) {
+        bstr_xappend(NULL, &msg, bstr0(",\"request_id\":"));
+        bstr_xappend(NULL, &msg, bstr0(req->request_id));
+    }
+    bstr_xappend(NULL, &msg, bstr0("}"));
+    send_msg(req->client, &msg);
+}
+
+static void observer_cb(void *cb_ctx, const char *name, struct m_option *type,
+                        void *value)
+{
+    struct ipc_observer *o = cb_ctx;
+    bstr msg = {0};
+    bstr_xappend(NULL, &msg, bstr0("{\"event\":\"property-change\",\"id\":"));
+    json_write_number(NULL, &msg, o->id);
+    bstr_xappend(NULL, &msg, bstr0(",\"name\":"));
+    json_write_string(NULL, &msg, name);
+    bstr_xappend(NULL, &msg, bstr0(",\"data\":"));
+    write_value(&msg, type, value);
+    bstr_xappend(NULL, &msg, bstr0("}"));
+    send_msg(o->client, &msg);
+}
+
+static void free_client(struct MPContext *mpctx, struct ipc_client *client)
+{
+    for (int n = 0; n < client->num_observers; n++)
+        mp_unobserve_property(mpctx, client->observers[n]->obs);
+    talloc_free(client->in.start);
+    talloc_free(client->out.start);
+    talloc_free(client);
+}
+
+static void handle_request(struct MPContext *mpctx, struct ipc_request *req)
+{
+    struct ipc_client *client = req->client;
+    bstr data = {0};
+    int r;
+
+    switch (req->type) {
+    case IPC_COMMAND:
+        // Run it right away, so that the reply has the actual result, and
+        // the client's following requests see its effects.
+        r = run_command(mpctx, req->cmd);
+        send_reply(req, r >= 0 ? "success" : "error running command", data);
+        break;
+    case IPC_GET_PROPERTY: {
+        struct m_option type = {0};
+        union m_option_value val = {0};
+        r = mp_property_do(req->name, M_PROPERTY_GET_TYPE, &type, mpctx);
+        if (r > 0)
+            r = mp_property_do(req->name, M_PROPERTY_GET, &val, mpctx);
+        if (r > 0) {
+            write_value(&data, &type, &val);
+            m_option_free(&type, &val);
+        }
+        send_reply(req, property_error(r), data);
+        break;
+    }
+    case IPC_GET_PROPERTY_STRING: {
+        char *s = NULL;
+        r = mp_property_do(req->name, M_PROPERTY_GET_STRING, &s, mpctx);
+        if (r > 0)
+            json_write_string(NULL, &data, s);
+        talloc_free(s);
+        send_reply(req, property_error(r), data);
+        break;
+    }
+    case IPC_SET_PROPERTY:
+        r = mp_property_do(req->name, M_PROPERTY_SET_STRING, req->value, mpctx);
+        send_reply(req, property_error(r), data);
+        break;
+    case IPC_OBSERVE_PROPERTY: {
+        struct ipc_observer *o = talloc_ptrtype(client, o);
+        *o = (struct ipc_observer){ .client = client, .id = req->observe_id };
+        o->obs = mp_observe_property(mpctx, req->name, observer_cb, o);
+        MP_TARRAY_APPEND(client, client->observers, client->num_observers, o);
+        send_reply(req, "success", data);
+        break;
+    }
+    case IPC_UNOBSERVE_PROPERTY: {
+        bool found = false;
+        for (int n = client->num_observers - 1; n >= 0; n--) {
+            struct ipc_observer *o = client->observers[n];
+            if (o->id == req->observe_id) {
+                mp_unobserve_property(mpctx, o->obs);
+                MP_TARRAY_REMOVE_AT(client->observers, client->num_observers, n);
+                talloc_free(o);
+                found = true;
+            }
+        }
+        send_reply(req, found ? "success" : "invalid parameter", data);
+        break;
+    }
+    case IPC_DISCONNECT:
+        free_client(mpctx, client);
+        break;
+    case IPC_ERROR:
+        send_reply(req, req->error, data);
+        break;
+    }
+    talloc_free(data.start);
+}
+
+static void free_request(struct ipc_request *req)
+{
+    if (req->cmd)
+        mp_cmd_free(req->cmd);
+    talloc_free(req);
+}
+
+// Handle all requests queued by the IPC thread. Returns whether there were
+// any.
+bool mp_ipc_process_requests(struct MPContext *mpctx)
+{
+    struct ipc_ctx *ipc = mpctx->ipc_ctx;
+    if (!ipc)
+        return false;
+
+    pthread_mutex_lock(&ipc->lock);
+    struct ipc_request **requests = ipc->requests;
+    int num_requests = ipc->num_requests;
+    ipc->requests = NULL;
+    ipc->num_requests = 0;
+    pthread_mutex_unlock(&ipc->lock);
+
+    for (int n = 0; n < num_requests; n++) {
+        struct ipc_request *req = requests[n];
+        handle_request(mpctx, req);
+        if (req->type != IPC_DISCONNECT) {
+            pthread_mutex_lock(&ipc->lock);
+            req->client->pending--;
+            pthread_mutex_unlock(&ipc->lock);
+            wakeup_thread(ipc);
+        }
+        free_request(req);
+    }
+    talloc_free(requests);
+    return num_requests > 0;
+}
+
+void mp_ipc_event(struct MPContext *mpctx, const char *name)
+{
+    struct ipc_ctx *ipc = mpctx->ipc_ctx;
+    if (!ipc)
+        return;
+
+    bstr msg = {0};
+    bstr_xappend(NULL, &msg, bstr0("{\"event\":"));
+    json_write_string(NULL, &msg, name);
+    bstr_xappend(NULL, &msg, bstr0("}\n"));
+    pthread_mutex_lock(&ipc->lock);
+    for (int n = 0; n < ipc->num_clients; n++) {
+        struct ipc_client *client = ipc->clients[n];
+        if (client->out.len + msg.len > MAX_OUT_SIZE) {
+            client->overflow = true;
+        } else {
+            bstr_xappend(NULL, &client->out, msg);
+        }
+    }
+    pthread_mutex_unlock(&ipc->lock);
+    talloc_free(msg.start);
+    wakeup_thread(ipc);
+}
+
+// --- IPC thread
+
+static void queue_request(struct ipc_ctx *ipc, struct ipc_request *req)
+{
+    pthread_mutex_lock(&ipc->lock);
+    if (req->type != IPC_DISCONNECT)
+        req->client->pending++;
+    MP_TARRAY_APPEND(NULL, ipc->requests, ipc->num_requests, req);
+    pthread_mutex_unlock(&ipc->lock);
+}
+
+// Return the argument as string, or NULL if it's not a string or number.
+static char *arg_to_string(void *talloc_ctx, struct json_node *arg)
+{
+    switch (arg->type) {
+    case JSON_STRING:
+        return arg->string;
+    case JSON_NUMBER: {
+        bstr s = {0};
+        json_write_number(talloc_ctx, &s, arg->number);
+        return s.start;
+    }
+    case JSON_FLAG:
+        return arg->flag ? "yes" : "no";
+    default:
+        return NULL;
+    }
+}
+
+// Parse a request and queue it. Errors are queued as well, so that a client
+// gets the replies in the order of its requests.
+static void parse_request(struct ipc_client *client, bstr line)
+{
+    struct ipc_ctx *ipc = client->ipc;
+    struct ipc_request *req = talloc_ptrtype(NULL, req);
+    *req = (struct ipc_request){ .client = client };
+    const char *error = NULL;
+
+    line = bstr_strip(line);
+    if (!line.len)
+        goto done;
+
+    // Plain text commands, as in input.conf, get no reply.
+    if (!bstr_startswith0(line, "{")) {
+        req->cmd = mp_input_parse_cmd_(ipc->log, line, "<ipc>");
+        req->silent = true;
+        if (!req->cmd)
+            goto done;
+        queue_request(ipc, req);
+        return;
+    }
+
+    char *src = bstrdup0(req, line);
+    struct json_node root;
+    // Nothing but whitespace may follow the root value.
+    if (!json_parse(req, &root, &src, 5) || root.type != JSON_OBJECT ||
+        src[strspn(src, " \t\r\n")])
+    {
+        error = "invalid JSON";
+        goto done;
+    }
+
+    struct json_node *id = json_get(&root, "request_id");
+    if (id && (id->type == JSON_NUMBER || id->type == JSON_STRING)) {
+        bstr s = {0};
+        if (id->type == JSON_NUMBER) {
+            json_write_number(req, &s, id->number);
+        } else {
+            json_write_string(req, &s, id->string);
+        }
+        req->request_id = s.start;
+    }
+
+    struct json_node *cmd = json_get(&root, "command");
+    if (!cmd || cmd->type != JSON_ARRAY || cmd->num_values < 1 ||
+        cmd->values[0].type != JSON_STRING)
+    {
+        error = "invalid parameter";
+        goto done;
+    }
+    int num_args = cmd->num_values - 1;
+    struct json_node *args = cmd->values + 1;
+    bstr *argv = talloc_array(req, bstr, cmd->num_values);
+    for (int n = 0; n < cmd->num_values; n++) {
+        char *s = arg_to_string(req, &cmd->values[n]);
+        if (!s) {
+            error = "invalid parameter";
+            goto done;
+        }
+        argv[n] = bstr0(s);
+    }
+
+    char *name = cmd->values[0].string;
+    if (strcmp(name, "get_property") == 0 && num_args == 1) {
+        req->type = IPC_GET_PROPERTY;
+        req->name = argv[1].start;
+    } else if (strcmp(name, "get_property_string") == 0 && num_args == 1) {
+        req->type = IPC_GET_PROPERTY_STRING;
+        req->name = argv[1].start;
+    } else if (strcmp(name, "set_property") == 0 && num_args == 2) {
+        req->type = IPC_SET_PROPERTY;
+        req->name = argv[1].start;
+        req->value = argv[2].start;
+    } else if (strcmp(name, "observe_property") == 0 && num_args == 2 &&
+               args[0].type == JSON_NUMBER)
+    {
+        req->type = IPC_OBSERVE_PROPERTY;
+        req->observe_id = args[0].number;
+        req->name = argv[2].start;
+    } else if (strcmp(name, "unobserve_property") == 0 && num_args == 1 &&
+               args[0].type == JSON_NUMBER)
+    {
+        req->type = IPC_UNOBSERVE_PROPERTY;
+        req->observe_id = args[0].number;
+    } else {
+        req->type = IPC_COMMAND;
+        req->cmd = mp_input_parse_cmd_bstrv(ipc->log, 0, cmd->num_values,
+                                            argv, "<ipc>");
+        if (!req->cmd) {
+            error = "invalid parameter";
+            goto done;
+        }
+    }
+    queue_request(ipc, req);
+    return;
+
+done:
+    if (error) {
+        if (req->cmd)
+            mp_cmd_free(req->cmd);
+        req->cmd = NULL;
+        req->type = IPC_ERROR;
+        req->error = error;
+        queue_request(ipc, req);
+        return;
+    }
+    free_request(req);
+}
+
+// Returns false on errors. Sets client->eof if the client stopped sending;
+// all input it sent before is still handled.
+static bool read_client(struct ipc_client *client)
+{
+    char buf[4096];
+    while (1) {
+        ssize_t r = read(client->fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (r < 0)
+            return false;
+        if (r == 0) {
+            client->eof = true;
+            break;
+        }
+        bstr_xappend(NULL, &client->in, (bstr){buf, r});
+    }
+
+    bstr rest = client->in;
+    while (1) {
+        int nl = bstrchr(rest, '\n');
+        if (nl < 0)
+            break;
+        parse_request(client, bstr_splice(rest, 0, nl));
+        rest = bstr_cut(rest, nl + 1);
+    }
+    // An unterminated last line is complete at EOF.
+    if (client->eof && rest.len) {
+        parse_request(client, rest);
+        rest.len = 0;
+    }
+    if (rest.len > MAX_LINE_SIZE)
+        return false;
+    memmove(client->in.start, rest.start, rest.len);
+    client->in.len = rest.len;
+    return true;
+}
+
+// Returns false if the client disconnected. Call with ipc->lock held.
+static bool write_client(struct ipc_client *client)
+{
+    while (client->out.len) {
+        ssize_t r = send(client->fd, client->out.start, client->out.len,
+                         MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (r < 0)
+            return false;
+        memmove(client->out.start, client->out.start + r, client->out.len - r);
+        client->out.len -= r;
+    }
+    return !client->overflow;
+}
+
+static void disconnect_client(struct ipc_ctx *ipc, int index)
+{
+    struct ipc_client *client = ipc->clients[index];
+    MP_VERBOSE(ipc, "Client %d disconnected.\n", client->fd);
+    close(client->fd);
+    pthread_mutex_lock(&ipc->lock);
+    MP_TARRAY_REMOVE_AT(ipc->clients, ipc->num_clients, index);
+    pthread_mutex_unlock(&ipc->lock);
+    struct ipc_request *req = talloc_ptrtype(NULL, req);
+    *req = (struct ipc_request){ .type = IPC_DISCONNECT, .client = client };
+    queue_request(ipc, req);
+}
+
+static void accept_client(struct ipc_ctx *ipc)
+{
+    int fd = accept(ipc->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    mp_set_cloexec(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct ipc_client *client = talloc_ptrtype(NULL, client);
+    *client = (struct ipc_client){ .ipc = ipc, .fd = fd };
+    pthread_mutex_lock(&ipc->lock);
+    MP_TARRAY_APPEND(ipc, ipc->clients, ipc->num_clients, client);
+    pthread_mutex_unlock(&ipc->lock);
+    MP_VERBOSE(ipc, "Client %d connected.\n", fd);
+}
+
+static void *ipc_thread(void *p)
+{
+    struct ipc_ctx *ipc = p;
+    struct pollfd *fds = NULL;
+
+    while (1) {
+        pthread_mutex_lock(&ipc->lock);
+        if (ipc->terminate) {
+            pthread_mutex_unlock(&ipc->lock);
+            break;
+        }
+        int num_fds = 2 + ipc->num_clients;
+        fds = talloc_realloc(NULL, fds, struct pollfd, num_fds);
+        fds[0] = (struct pollfd){ .fd = ipc->wakeup_pipe[0], .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = ipc->listen_fd, .events = POLLIN };
+        for (int n = 0; n < ipc->num_clients; n++) {
+            struct ipc_client *client = ipc->clients[n];
+            fds[2 + n] = (struct pollfd){
+                .fd = client->fd,
+                .events = (client->eof ? 0 : POLLIN) |
+                          (client->out.len ? POLLOUT : 0),
+            };
+            // Don't get woken up by the hangup while replies are pending.
+            if (!fds[2 + n].events)
+                fds[2 + n].fd = -1;
+        }
+        pthread_mutex_unlock(&ipc->lock);
+
+        if (poll(fds, num_fds, -1) < 0 && errno != EINTR) {
+            MP_ERR(ipc, "poll error: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buf[100];
+            read(ipc->wakeup_pipe[0], buf, sizeof(buf));
+        }
+
+        if (fds[1].revents & POLLIN)
+            accept_client(ipc);
+
+        // Clients are only added at the end, so fds[] still matches.
+        pthread_mutex_lock(&ipc->lock);
+        int num_requests = ipc->num_requests;
+        pthread_mutex_unlock(&ipc->lock);
+
+        for (int n = num_fds - 3; n >= 0; n--) {
+            struct ipc_client *client = ipc->clients[n];
+            bool ok = true;
+            if (!client->eof &&
+                (fds[2 + n].revents & (POLLIN | POLLHUP | POLLERR)))
+                ok = read_client(client);
+            if (ok) {
+                pthread_mutex_lock(&ipc->lock);
+                ok = write_client(client);
+                // After EOF, keep the client until all replies were sent.
+                if (client->eof && !client->pending && !client->out.len)
+                    ok = false;
+                pthread_mutex_unlock(&ipc->lock);
+            }
+            if (!ok)
+                disconnect_client(ipc, n);
+        }
+
+        pthread_mutex_lock(&ipc->lock);
+        bool new_requests = ipc->num_requests != num_requests;
+        pthread_mutex_unlock(&ipc->lock);
+        if (new_requests)
+            mp_input_wakeup(ipc->mpctx->input);
+    }
+
+    talloc_free(fds);
+    return NULL;
+}
+
+void mp_ipc_init(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    const char *path = opts->input.ipc_path;
+    if (!path || !path[0])
+        return;
+
+    struct ipc_ctx *ipc = talloc_ptrtype(NULL, ipc);
+    *ipc = (struct ipc_ctx){
+        .mpctx = mpctx,
+        .log = mp_log_new(ipc, mpctx->log, "ipc"),
+        .path = talloc_strdup(ipc, path),
+        .listen_fd = -1,
+        .wakeup_pipe = {-1, -1},
+    };
+    pthread_mutex_init(&ipc->lock, NULL);
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        MP_ERR(ipc, "Socket path too long: %s\n", path);
+        goto error;
+    }
+    strcpy(addr.sun_path, path);
+
+    ipc->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ipc->listen_fd < 0)
+        goto error_errno;
+    mp_set_cloexec(ipc->listen_fd);
+
+    // Remove a stale socket left by a previous instance.
+    unlink(path);
+    if (bind(ipc->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(ipc->listen_fd, 16) < 0)
+        goto error_errno;
+
+    if (pipe(ipc->wakeup_pipe) < 0)
+        goto error_errno;
+    for (int n = 0; n < 2; n++) {
+        mp_set_cloexec(ipc->wakeup_pipe[n]);
+        int fl = fcntl(ipc->wakeup_pipe[n], F_GETFL);
+        fcntl(ipc->wakeup_pipe[n], F_SETFL, fl | O_NONBLOCK);
+    }
+
+    if (pthread_create(&ipc->thread, NULL, ipc_thread, ipc))
+        goto error;
+
+    MP_VERBOSE(ipc, "Listening on %s\n", path);
+    mpctx->ipc_ctx = ipc;
+    return;
+
+error_errno:
+    MP_ERR(ipc, "Could not create IPC socket %s: %s\n", path, strerror(errno));
+error:
+    if (ipc->listen_fd >= 0)
+        close(ipc->listen_fd);
+    for (int n = 0; n < 2; n++) {
+        if (ipc->wakeup_pipe[n] >= 0)
+            close(ipc->wakeup_pipe[n]);
+    }
+    pthread_mutex_destroy(&ipc->lock);
+    talloc_free(ipc);
+}
+
+void mp_ipc_uninit(struct MPContext *mpctx)
+{
+    struct ipc_ctx *ipc = mpctx->ipc_ctx;
+    if (!ipc)
+        return;
+
+    pthread_mutex_lock(&ipc->lock);
+    ipc->terminate = true;
+    pthread_mutex_unlock(&ipc->lock);
+    wakeup_thread(ipc);
+    pthread_join(ipc->thread, NULL);
+
+    // Requests for clients that disconnected are the last references to them.
+    for (int n = 0; n < ipc->num_requests; n++) {
+        struct ipc_request *req = ipc->requests[n];
+        if (req->type == IPC_DISCONNECT)
+            free_client(mpctx, req->client);
+        free_request(req);
+    }
+    talloc_free(ipc->requests);
+    for (int n = 0; n < ipc->num_clients; n++) {
+        close(ipc->clients[n]->fd);
+        free_client(mpctx, ipc->clients[n]);
+    }
+
+    close(ipc->listen_fd);
+    unlink(ipc->path);
+    for (int n = 0; n < 2; n++)
+        close(ipc->wakeup_pipe[n]);
+    pthread_mutex_destroy(&ipc->lock);
+    talloc_free(ipc);
+    mpctx->ipc_ctx = NULL;
+}
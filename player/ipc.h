@@ -0,0 +1,13 @@
+#ifndef MP_IPC_H
+#define MP_IPC_H
+
+#include <stdbool.h>
+
+struct MPContext;
+
+void mp_ipc_init(struct MPContext *mpctx);
+void mp_ipc_uninit(struct MPContext *mpctx);
+bool mp_ipc_process_requests(struct MPContext *mpctx);
+void mp_ipc_event(struct MPContext *mpctx, const char *name);
+
+#endif
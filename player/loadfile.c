@@ -20,6 +20,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/avutil.h>
 
@@ -38,6 +39,7 @@
 #include "options/options.h"
 #include "options/m_property.h"
 #include "common/common.h"
+#include "common/global.h"
 #include "common/encode.h"
 #include "input/input.h"
 
@@ -104,6 +106,9 @@ void uninit_player(struct MPContext *mpctx, unsigned int mask)
             ass_renderer_done(mpctx->ass_renderer);
         mpctx->ass_renderer = NULL;
         ass_clear_fonts(mpctx->ass_library);
+        talloc_free(mpctx->ass_fonts);
+        mpctx->ass_fonts = NULL;
+        mpctx->num_ass_fonts = 0;
 #endif
     }
 
@@ -112,6 +117,7 @@ void uninit_player(struct MPContext *mpctx, unsigned int mask)
         if (mpctx->d_video)
             video_uninit(mpctx->d_video);
         mpctx->d_video = NULL;
+        video_cache_clear(mpctx);
         mpctx->sync_audio_to_video = false;
         reselect_demux_streams(mpctx);
     }
@@ -132,6 +138,7 @@ void uninit_player(struct MPContext *mpctx, unsigned int mask)
         assert(!mpctx->d_video && !mpctx->d_audio &&
                !mpctx->d_sub[0] && !mpctx->d_sub[1]);
         mpctx->master_demuxer = NULL;
+        timeline_uninit_sources(mpctx);
         for (int i = 0; i < mpctx->num_sources; i++) {
             uninit_subs(mpctx->sources[i]);
             struct demuxer *demuxer = mpctx->sources[i];
@@ -326,12 +333,18 @@ static struct sh_stream *select_fallback_stream(struct demuxer *d,
 
 bool timeline_set_part(struct MPContext *mpctx, int i, bool force)
 {
+    if (!timeline_open_part_source(mpctx, i)) {
+        mpctx->stop_play = AT_END_OF_FILE;
+        return false;
+    }
     struct timeline_part *p = mpctx->timeline + mpctx->timeline_part;
     struct timeline_part *n = mpctx->timeline + i;
     mpctx->timeline_part = i;
     mpctx->video_offset = n->start - n->source_start;
-    if (n->source == p->source && !force)
+    if (n->source == p->source && !force) {
+        timeline_update_sources(mpctx);
         return false;
+    }
     enum stop_play_reason orig_stop_play = mpctx->stop_play;
     if (!mpctx->d_video && mpctx->stop_play == KEEP_PLAYING)
         mpctx->stop_play = AT_END_OF_FILE;  // let audio uninit drain data
@@ -359,6 +372,7 @@ bool timeline_set_part(struct MPContext *mpctx, int i, bool force)
         }
     }
     reselect_demux_streams(mpctx);
+    timeline_update_sources(mpctx);
 
     return true;
 }
@@ -736,7 +750,11 @@ static void open_subtitles_from_options(struct MPContext *mpctx)
         if (stream_control(mpctx->stream, STREAM_CTRL_GET_BASE_FILENAME,
                            &stream_filename) > 0)
             base_filename = talloc_steal(tmp, stream_filename);
-        struct subfn *list = find_text_subtitles(mpctx->global, base_filename);
+        if (!mpctx->subfile_cache)
+            mpctx->subfile_cache = mp_subfile_cache_create(mpctx);
+        struct subfn *list = find_text_subtitles(mpctx->global,
+                                                 mpctx->subfile_cache,
+                                                 base_filename);
         talloc_steal(tmp, list);
         for (int i = 0; list && list[i].fname; i++) {
             char *filename = list[i].fname;
@@ -875,19 +893,26 @@ static bool attachment_is_font(struct mp_log *log, struct demux_attachment *att)
     return false;
 }
 
-static void add_subtitle_fonts_from_sources(struct MPContext *mpctx)
+// Add the font attachments of the demuxer to the libass library.
+void add_subtitle_fonts(struct MPContext *mpctx, struct demuxer *d)
 {
 #if HAVE_LIBASS
-    if (mpctx->opts->ass_enabled) {
-        for (int j = 0; j < mpctx->num_sources; j++) {
-            struct demuxer *d = mpctx->sources[j];
-            for (int i = 0; i < d->num_attachments; i++) {
-                struct demux_attachment *att = d->attachments + i;
-                if (mpctx->opts->use_embedded_fonts &&
-                    attachment_is_font(mpctx->log, att))
-                {
-                    ass_add_font(mpctx->ass_library, att->name, att->data,
-                                 att->data_size);
+    if (mpctx->opts->ass_enabled && mpctx->opts->use_embedded_fonts) {
+        for (int i = 0; i < d->num_attachments; i++) {
+            struct demux_attachment *att = d->attachments + i;
+            if (attachment_is_font(mpctx->log, att)) {
+                ass_add_font(mpctx->ass_library, att->name, att->data,
+                             att->data_size);
+                // The source might be closed before the fonts are used.
+                if (mpctx->copy_ass_fonts) {
+                    MP_TARRAY_APPEND(mpctx, mpctx->ass_fonts,
+                                     mpctx->num_ass_fonts, *att);
+                    struct demux_attachment *font =
+                        &mpctx->ass_fonts[mpctx->num_ass_fonts - 1];
+                    font->name = talloc_strdup(mpctx->ass_fonts, att->name);
+                    font->type = NULL;
+                    font->data = talloc_memdup(mpctx->ass_fonts, att->data,
+                                               att->data_size);
                 }
             }
         }
@@ -895,6 +920,12 @@ static void add_subtitle_fonts_from_sources(struct MPContext *mpctx)
 #endif
 }
 
+static void add_subtitle_fonts_from_sources(struct MPContext *mpctx)
+{
+    for (int j = 0; j < mpctx->num_sources; j++)
+        add_subtitle_fonts(mpctx, mpctx->sources[j]);
+}
+
 static void init_sub_renderer(struct MPContext *mpctx)
 {
 #if HAVE_LIBASS
@@ -989,6 +1020,158 @@ static void print_timeline(struct MPContext *mpctx)
     }
 }
 
+// Opening the next playlist entry in the background (--prefetch-playlist).
+struct prefetch_state {
+    pthread_t thread;
+    // Private copy of the options, as the main thread can change them.
+    struct mpv_global *global;
+    struct mp_log *log;
+    struct mp_cancel *cancel;   // aborts opening when discarding the prefetch
+    // Playlist entry the prefetch was started for. Only valid while it's in
+    // the playlist.
+    struct playlist_entry *entry;
+    char *filename;
+    // Results; valid only after the thread was joined.
+    struct mp_resolve_result *resolve_result;
+    struct stream *stream;
+    struct demuxer *demuxer;
+};
+
+static void *prefetch_thread(void *arg)
+{
+    struct prefetch_state *p = arg;
+    struct MPOpts *opts = p->global->opts;
+
+    char *stream_filename = p->filename;
+    p->resolve_result = resolve_url(stream_filename, p->global);
+    if (p->resolve_result) {
+        if (p->resolve_result->playlist)
+            return NULL;
+        stream_filename = p->resolve_result->url;
+    }
+    p->stream = stream_create(stream_filename, STREAM_READ, p->cancel,
+                              p->global);
+    if (!p->stream)
+        return NULL;
+    // Interactive or device streams need setup on the playback thread.
+    if (p->stream->type != STREAMTYPE_GENERIC &&
+        p->stream->type != STREAMTYPE_FILE)
+        return NULL;
+    stream_enable_cache_percent(&p->stream, opts->stream_cache_size,
+                                opts->stream_cache_def_size,
+                                opts->stream_cache_min_percent,
+                                opts->stream_cache_seek_min_percent);
+    if (mp_cancel_test(p->cancel))
+        return NULL;
+    p->demuxer = demux_open(p->stream, opts->demuxer_name, NULL, p->global);
+    return NULL;
+}
+
+// Free all results that weren't claimed. The thread must have been joined.
+static void free_prefetch(struct MPContext *mpctx)
+{
+    struct prefetch_state *p = mpctx->prefetch;
+    free_demuxer(p->demuxer);
+    free_stream(p->stream);
+    talloc_free(p->resolve_result);
+    talloc_free(p->cancel);
+    talloc_free(p);
+    mpctx->prefetch = NULL;
+}
+
+void mp_prefetch_cancel(struct MPContext *mpctx)
+{
+    if (!mpctx->prefetch)
+        return;
+    // Don't wait for a slow or stuck network open.
+    mp_cancel_trigger(mpctx->prefetch->cancel);
+    pthread_join(mpctx->prefetch->thread, NULL);
+    free_prefetch(mpctx);
+}
+
+// Start opening the next playlist entry if the current file ends soon. Also
+// discards the prefetched file if its playlist entry was removed.
+void mp_prefetch_next(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct prefetch_state *cur = mpctx->prefetch;
+    if (cur && (playlist_entry_to_index(mpctx->playlist, cur->entry) < 0 ||
+                strcmp(cur->entry->filename, cur->filename) != 0))
+    {
+        MP_VERBOSE(mpctx, "Prefetched playlist entry was removed.\n");
+        mp_prefetch_cancel(mpctx);
+    }
+    if (opts->prefetch_playlist <= 0 || mpctx->prefetch || !mpctx->demuxer ||
+        mpctx->encode_lavc_ctx)
+        return;
+    double len = get_time_length(mpctx);
+    double pos = get_current_time(mpctx);
+    if (len <= 0 || pos == MP_NOPTS_VALUE || len - pos > opts->prefetch_playlist)
+        return;
+    // Don't use mp_next_file(), which can have side-effects. If it picks a
+    // different entry, the prefetched file is simply discarded.
+    struct playlist_entry *next = playlist_get_next(mpctx->playlist, 1);
+    if (!next && opts->loop_times >= 0 && !opts->shuffle)
+        next = mpctx->playlist->first;
+    // Per-file options could influence opening the file.
+    if (!next || next->num_params)
+        return;
+
+    struct prefetch_state *p = talloc_ptrtype(NULL, p);
+    *p = (struct prefetch_state) {
+        // The next file starts without the current file's file-local options.
+        .global = mp_copy_global(p, mpctx, true),
+        .log = mp_log_new(p, mpctx->log, "prefetch"),
+        .entry = next,
+        .filename = talloc_strdup(p, next->filename),
+    };
+    // The streams keep a reference to it, so it must survive claiming them.
+    p->cancel = mp_cancel_new(NULL);
+    MP_VERBOSE(p, "Opening %s\n", p->filename);
+    if (pthread_create(&p->thread, NULL, prefetch_thread, p)) {
+        talloc_free(p->cancel);
+        talloc_free(p);
+        return;
+    }
+    mpctx->prefetch = p;
+}
+
+// If the current file was prefetched, set mpctx->stream and
+// mpctx->resolve_result, and return the opened demuxer. Otherwise return NULL,
+// and discard the prefetched file (if any).
+static struct demuxer *claim_prefetched_file(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct prefetch_state *p = mpctx->prefetch;
+    if (!p)
+        return NULL;
+    // Some options require the stream to be set up in a special way. The
+    // prefetch was opened without any file-local options (including
+    // auto-profiles), so it's unusable if the file has some.
+    bool usable = strcmp(p->filename, mpctx->filename) == 0 &&
+        !opts->seek_to_byte && !(opts->stream_dump && opts->stream_dump[0]) &&
+        !mpctx->playlist->current->num_params && !mpctx->mconfig->backup_opts;
+    if (!usable)
+        mp_cancel_trigger(p->cancel);
+    pthread_join(p->thread, NULL);
+    struct demuxer *demuxer = NULL;
+    if (usable && p->demuxer) {
+        MP_VERBOSE(mpctx, "Using prefetched file.\n");
+        mpctx->resolve_result = p->resolve_result;
+        mpctx->stream = p->stream;
+        demuxer = p->demuxer;
+        // The streams and the demuxer still reference these.
+        talloc_steal(mpctx->stream, p->global);
+        talloc_steal(mpctx->stream, p->cancel);
+        p->resolve_result = NULL;
+        p->stream = NULL;
+        p->demuxer = NULL;
+        p->cancel = NULL;
+    }
+    free_prefetch(mpctx);
+    return demuxer;
+}
+
 /* When demux performs a blocking operation (network connection or
  * cache filling) if the operation fails we use this function to check
  * if it was interrupted by the user.
@@ -1088,6 +1271,15 @@ static void play_current_file(struct MPContext *mpctx)
     assert(mpctx->d_sub[0] == NULL);
     assert(mpctx->d_sub[1] == NULL);
 
+    struct demuxer *prefetched = claim_prefetched_file(mpctx);
+    if (prefetched) {
+        if (mpctx->resolve_result)
+            print_resolve_contents(mpctx->log, mpctx->resolve_result);
+        mpctx->initialized_flags |= INITIALIZED_STREAM;
+        // The stream type was checked, so mp_nav_init() would be a no-op.
+        goto stream_ready;
+    }
+
     char *stream_filename = mpctx->filename;
     mpctx->resolve_result = resolve_url(stream_filename, mpctx->global);
     if (mpctx->resolve_result) {
@@ -1125,6 +1317,7 @@ static void play_current_file(struct MPContext *mpctx)
         if (demux_was_interrupted(mpctx))
             goto terminate_playback;
 
+stream_ready:
     stream_set_capture_file(mpctx->stream, opts->stream_capture);
 
 goto_reopen_demuxer: ;
@@ -1135,8 +1328,12 @@ goto_reopen_demuxer: ;
 
     mpctx->audio_delay = opts->audio_delay;
 
-    mpctx->demuxer = demux_open(mpctx->stream, opts->demuxer_name, NULL,
-                                mpctx->global);
+    mpctx->demuxer = prefetched;
+    prefetched = NULL;
+    if (!mpctx->demuxer) {
+        mpctx->demuxer = demux_open(mpctx->stream, opts->demuxer_name, NULL,
+                                    mpctx->global);
+    }
     mpctx->master_demuxer = mpctx->demuxer;
     if (!mpctx->demuxer) {
         MP_ERR(mpctx, "Failed to recognize file format.\n");
@@ -1161,6 +1358,9 @@ goto_reopen_demuxer: ;
         goto terminate_playback;
     }
 
+    // Fixed for the file, as sources may be closed before the fonts are needed.
+    mpctx->copy_ass_fonts = opts->ass_render_ahead;
+
     if (mpctx->demuxer->matroska_data.ordered_chapters)
         build_ordered_chapter_timeline(mpctx);
 
@@ -1172,7 +1372,11 @@ goto_reopen_demuxer: ;
 
     print_timeline(mpctx);
 
+    // Before timeline sources are closed.
+    add_subtitle_fonts_from_sources(mpctx);
+
     if (mpctx->timeline) {
+        timeline_init_sources(mpctx);
         // With Matroska, the "master" file usually dictates track layout etc.
         // On the contrary, the EDL and CUE demuxers are empty wrappers, as
         // well as Matroska ordered chapter playlist-like files.
@@ -1180,6 +1384,8 @@ goto_reopen_demuxer: ;
             if (mpctx->timeline[n].source == mpctx->demuxer)
                 goto main_is_ok;
         }
+        if (!timeline_open_part_source(mpctx, 0))
+            goto terminate_playback;
         mpctx->demuxer = mpctx->timeline[0].source;
     main_is_ok: ;
     }
@@ -1190,7 +1396,6 @@ goto_reopen_demuxer: ;
     if (mpctx->timeline)
         timeline_set_part(mpctx, mpctx->timeline_part, true);
 
-    add_subtitle_fonts_from_sources(mpctx);
     // libass seems to misbehave if fonts are changed while a renderer
     // exists, so we (re)create the renderer after fonts are set.
     init_sub_renderer(mpctx);
@@ -1235,6 +1440,9 @@ goto_reopen_demuxer: ;
         encode_lavc_expect_stream(mpctx->encode_lavc_ctx, AVMEDIA_TYPE_VIDEO);
     if (mpctx->encode_lavc_ctx && mpctx->current_track[0][STREAM_AUDIO])
         encode_lavc_expect_stream(mpctx->encode_lavc_ctx, AVMEDIA_TYPE_AUDIO);
+    if (mpctx->encode_lavc_ctx && opts->encode_output.copy &&
+        remux_file(mpctx))
+        goto terminate_playback;
 #endif
 
     reinit_video_chain(mpctx);
@@ -1280,6 +1488,7 @@ goto_reopen_demuxer: ;
     mpctx->restart_playback = true;
     mpctx->video_pts = 0;
     mpctx->last_vo_pts = MP_NOPTS_VALUE;
+    video_cache_reset(mpctx);
     mpctx->last_seek_pts = 0;
     mpctx->playback_pts = MP_NOPTS_VALUE;
     mpctx->hrseek_active = false;
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -15,6 +17,7 @@
 #include "options/path.h"
 #include "bstr/bstr.h"
 #include "osdep/timer.h"
+#include "osdep/threads.h"
 #include "sub/osd.h"
 #include "core.h"
 #include "command.h"
@@ -35,17 +38,76 @@ static const char *builtin_lua_scripts[][2] = {
     {0}
 };
 
-// Represents a loaded script. Each has its own Lua state.
+// If a script doesn't exit within this time on uninit, abort it forcibly.
+#define SCRIPT_KILL_TIMEOUT 2.0
+
+enum script_event_type {
+    SCRIPT_EVENT,           // mp_event(name, arg)
+    SCRIPT_DISPATCH,        // mp_script_dispatch(id, arg)
+    SCRIPT_PROPERTY,        // mp_property_change(id, name, value)
+};
+
+// An event queued for the script thread. All data is owned by the event, as
+// the core might have changed or freed the source by the time it's run.
+struct script_event {
+    enum script_event_type type;
+    int id;
+    char *name;
+    char *arg;
+    // SCRIPT_PROPERTY: copy of the value; value_type.type is NULL if the
+    // property is unavailable
+    struct m_option value_type;
+    union m_option_value value;
+};
+
+// Represents a loaded script. Each has its own Lua state and runs in its own
+// thread. The core never calls into the Lua state; it only queues events.
 struct script_ctx {
     const char *name;
     lua_State *state;
     struct mp_log *log;
     struct MPContext *mpctx;
+    pthread_t thread;
+    // Accessed on the core thread only.
+    struct script_observer **observers;
+    int num_observers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // --- protected by lock
+    struct script_event **events;
+    int num_events;
+    bool terminate;         // set by the core to stop the thread
+    bool dead;              // thread doesn't accept events anymore
+    double cpu_time;        // CPU time used by the script thread (seconds)
+    // --- protected by lua_ctx.lock
+    bool closing;           // lua_close() is being called
+    bool thread_exited;
+};
+
+// A property observed with mp.raw_observe_property().
+struct script_observer {
+    struct script_ctx *ctx;
+    int id;
+    struct mp_property_observer *obs;
+};
+
+// A function the script thread wants to run on the core thread.
+struct script_request {
+    void (*fn)(void *arg);
+    void *arg;
+    bool done;
 };
 
 struct lua_ctx {
     struct script_ctx **scripts;
     int num_scripts;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;  // signaled on new/finished requests, thread exit
+    // --- protected by lock
+    struct script_request **requests; // not a talloc child (other threads)
+    int num_requests;
 };
 
 static struct script_ctx *find_script(struct lua_ctx *lctx, const char *name)
@@ -79,10 +141,11 @@ static int wrap_cpcall(lua_State *L)
 }
 
 // Call the given function fn under a Lua error handler (similar to lua_cpcall).
-// Pass the given number of args from the Lua stack to fn.
-// Returns 0 (and empty stack) on success.
+// Pass the given number of args from the Lua stack to fn, and leave the given
+// number of results (or all with LUA_MULTRET) on the stack.
+// Returns 0 (and only the results on the stack) on success.
 // Returns LUA_ERR[RUN|MEM|ERR] otherwise, with the error value on the stack.
-static int mp_cpcall(lua_State *L, lua_CFunction fn, int args)
+static int mp_cpcall_res(lua_State *L, lua_CFunction fn, int args, int results)
 {
     // Don't use lua_pushcfunction() - it allocates memory on Lua 5.1.
     // Instead, emulate C closures by making wrap_cpcall call fn.
@@ -90,7 +153,12 @@ static int mp_cpcall(lua_State *L, lua_CFunction fn, int args)
     // Will always succeed if mp_lua_init() set it up correctly.
     lua_getfield(L, LUA_REGISTRYINDEX, "wrap_cpcall"); // args... fn wrap_cpcall
     lua_insert(L, -(args + 2)); // wrap_cpcall args... fn
-    return lua_pcall(L, args + 1, 0, 0);
+    return lua_pcall(L, args + 1, results, 0);
+}
+
+static int mp_cpcall(lua_State *L, lua_CFunction fn, int args)
+{
+    return mp_cpcall_res(L, fn, args, 0);
 }
 
 static void report_error(lua_State *L)
@@ -167,6 +235,201 @@ static bool require(lua_State *L, const char *name)
     return true;
 }
 
+static double get_thread_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return 0;
+}
+
+// Run fn(arg) on the core thread, and wait until it has returned. Since the
+// script thread is blocked meanwhile, fn may access the script's Lua state.
+static void run_on_core(struct script_ctx *ctx, void (*fn)(void *), void *arg)
+{
+    struct lua_ctx *lctx = ctx->mpctx->lua_ctx;
+    struct script_request req = { .fn = fn, .arg = arg };
+    pthread_mutex_lock(&lctx->lock);
+    MP_TARRAY_APPEND(NULL, lctx->requests, lctx->num_requests, &req);
+    pthread_cond_broadcast(&lctx->wakeup);
+    pthread_mutex_unlock(&lctx->lock);
+    mp_input_wakeup(ctx->mpctx->input);
+    pthread_mutex_lock(&lctx->lock);
+    while (!req.done)
+        pthread_cond_wait(&lctx->wakeup, &lctx->lock);
+    pthread_mutex_unlock(&lctx->lock);
+}
+
+// Called on the core thread. Returns whether any requests were run. Requests
+// queued while this is running are left for the next call, so that a script
+// calling the core in a loop can't keep the playloop busy.
+bool mp_lua_process_requests(struct MPContext *mpctx)
+{
+    struct lua_ctx *lctx = mpctx->lua_ctx;
+    if (!lctx)
+        return false;
+    pthread_mutex_lock(&lctx->lock);
+    int num = lctx->num_requests;
+    for (int n = 0; n < num; n++) {
+        struct script_request *req = lctx->requests[0];
+        MP_TARRAY_REMOVE_AT(lctx->requests, lctx->num_requests, 0);
+        pthread_mutex_unlock(&lctx->lock);
+        req->fn(req->arg);
+        pthread_mutex_lock(&lctx->lock);
+        req->done = true;
+        pthread_cond_broadcast(&lctx->wakeup);
+    }
+    pthread_mutex_unlock(&lctx->lock);
+    return num > 0;
+}
+
+static int run_event(lua_State *L);
+static int run_script_dispatch(lua_State *L);
+static int run_property_change(lua_State *L);
+static void push_native_value(lua_State *L, struct m_option *type, void *value);
+
+// Called on the script thread.
+static void run_script_event(struct script_ctx *ctx, struct script_event *ev)
+{
+    lua_State *L = ctx->state;
+    int r = 0;
+    switch (ev->type) {
+    case SCRIPT_EVENT:
+        lua_pushstring(L, ev->name);
+        if (ev->arg) {
+            lua_pushstring(L, ev->arg);
+        } else {
+            lua_pushnil(L);
+        }
+        r = mp_cpcall(L, run_event, 2);
+        break;
+    case SCRIPT_DISPATCH:
+        lua_pushinteger(L, ev->id);
+        lua_pushstring(L, ev->arg);
+        r = mp_cpcall(L, run_script_dispatch, 2);
+        break;
+    case SCRIPT_PROPERTY:
+        lua_pushinteger(L, ev->id);
+        lua_pushstring(L, ev->name);
+        if (ev->value_type.type) {
+            push_native_value(L, &ev->value_type, &ev->value);
+        } else {
+            lua_pushnil(L);
+        }
+        r = mp_cpcall(L, run_property_change, 3);
+        break;
+    }
+    if (r != 0)
+        report_error(L);
+}
+
+// Abort a script that doesn't react to termination (e.g. endless loop).
+static void abort_hook(lua_State *L, lua_Debug *ar)
+{
+    luaL_error(L, "script terminated");
+}
+
+static int load_script(struct script_ctx *ctx, const char *fname)
+{
+    lua_State *L = ctx->state;
+
+    if (!require(L, "mp.defaults"))
+        return -1;
+
+    assert(lua_gettop(L) == 0);
+
+    if (fname[0] == '@')
+        return require(L, fname) ? 0 : -1;
+    return load_file(ctx, fname);
+}
+
+struct script_thread_arg {
+    struct script_ctx *ctx;
+    char *fname;
+};
+
+static void *script_thread(void *p)
+{
+    struct script_thread_arg *a = p;
+    struct script_ctx *ctx = a->ctx;
+    struct lua_ctx *lctx = ctx->mpctx->lua_ctx;
+
+    bool ok = load_script(ctx, a->fname) >= 0;
+    talloc_free(a);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->cpu_time = get_thread_cpu_time();
+    if (!ok)
+        ctx->dead = true;
+    // On termination, run the remaining events (like "end") before exiting.
+    while (!ctx->dead && (ctx->num_events || !ctx->terminate)) {
+        if (!ctx->num_events) {
+            pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+            continue;
+        }
+        struct script_event *ev = ctx->events[0];
+        MP_TARRAY_REMOVE_AT(ctx->events, ctx->num_events, 0);
+        pthread_mutex_unlock(&ctx->lock);
+
+        run_script_event(ctx, ev);
+        talloc_free(ev);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->cpu_time = get_thread_cpu_time();
+    }
+    ctx->dead = true;
+    for (int n = 0; n < ctx->num_events; n++)
+        talloc_free(ctx->events[n]);
+    ctx->num_events = 0;
+    pthread_mutex_unlock(&ctx->lock);
+
+    pthread_mutex_lock(&lctx->lock);
+    ctx->closing = true;
+    pthread_mutex_unlock(&lctx->lock);
+
+    // Finalizers might still call the core, which is fine as long as the core
+    // serves requests until thread_exited is set.
+    lua_close(ctx->state);
+    ctx->state = NULL;
+
+    pthread_mutex_lock(&lctx->lock);
+    ctx->thread_exited = true;
+    pthread_cond_broadcast(&lctx->wakeup);
+    pthread_mutex_unlock(&lctx->lock);
+    return NULL;
+}
+
+// Takes ownership of ev. Called on the core thread.
+static void queue_event(struct script_ctx *ctx, struct script_event *ev)
+{
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->dead || ctx->terminate) {
+        talloc_free(ev);
+        ev = NULL;
+    }
+    // If the script is too slow to keep up, coalesce ticks and property
+    // changes, instead of letting the queue grow without bounds.
+    for (int n = 0; ev && n < ctx->num_events; n++) {
+        struct script_event *cur = ctx->events[n];
+        if (cur->type != ev->type)
+            continue;
+        if ((ev->type == SCRIPT_EVENT && strcmp(ev->name, "tick") == 0 &&
+             strcmp(cur->name, "tick") == 0) ||
+            (ev->type == SCRIPT_PROPERTY && ev->id == cur->id))
+        {
+            talloc_free(cur);
+            ctx->events[n] = ev;
+            ev = NULL;
+        }
+    }
+    if (ev)
+        MP_TARRAY_APPEND(ctx, ctx->events, ctx->num_events, ev);
+    pthread_cond_signal(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
 static void mp_lua_load_script(struct MPContext *mpctx, const char *fname)
 {
     struct lua_ctx *lctx = mpctx->lua_ctx;
@@ -177,6 +440,8 @@ static void mp_lua_load_script(struct MPContext *mpctx, const char *fname)
     };
     char *log_name = talloc_asprintf(ctx, "lua/%s", ctx->name);
     ctx->log = mp_log_new(ctx, mpctx->log, log_name);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wakeup, NULL);
 
     lua_State *L = ctx->state = luaL_newstate();
     if (!L)
@@ -215,27 +480,26 @@ static void mp_lua_load_script(struct MPContext *mpctx, const char *fname)
 
     assert(lua_gettop(L) == 0);
 
-    if (!require(L, "mp.defaults")) {
-        report_error(L);
+    // Loading the script runs its main chunk, so do it on the script thread.
+    struct script_thread_arg *a = talloc_ptrtype(NULL, a);
+    *a = (struct script_thread_arg) {
+        .ctx = ctx,
+        .fname = talloc_strdup(a, fname),
+    };
+    if (pthread_create(&ctx->thread, NULL, script_thread, a)) {
+        talloc_free(a);
         goto error_out;
     }
 
-    assert(lua_gettop(L) == 0);
-
-    if (fname[0] == '@') {
-        if (!require(L, fname))
-            goto error_out;
-    } else {
-        if (load_file(ctx, fname) < 0)
-            goto error_out;
-    }
-
     MP_TARRAY_APPEND(lctx, lctx->scripts, lctx->num_scripts, ctx);
     return;
 
 error_out:
+    MP_ERR(ctx, "Could not start script.\n");
     if (ctx->state)
         lua_close(ctx->state);
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
     talloc_free(ctx);
 }
 
@@ -243,14 +507,54 @@ static void kill_script(struct script_ctx *ctx)
 {
     if (!ctx)
         return;
-    struct lua_ctx *lctx = ctx->mpctx->lua_ctx;
-    lua_close(ctx->state);
+    struct MPContext *mpctx = ctx->mpctx;
+    struct lua_ctx *lctx = mpctx->lua_ctx;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->terminate = true;
+    pthread_cond_signal(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+
+    // Keep serving requests, as the script might be waiting for them.
+    double deadline = mp_time_sec() + SCRIPT_KILL_TIMEOUT;
+    bool aborted = false;
+    pthread_mutex_lock(&lctx->lock);
+    while (!ctx->thread_exited) {
+        if (lctx->num_requests) {
+            pthread_mutex_unlock(&lctx->lock);
+            mp_lua_process_requests(mpctx);
+            pthread_mutex_lock(&lctx->lock);
+            continue;
+        }
+        double timeout = deadline - mp_time_sec();
+        if (timeout <= 0 && !aborted) {
+            MP_WARN(ctx, "Script doesn't exit, aborting it.\n");
+            // lua_sethook() is the only function safe to call asynchronously.
+            if (!ctx->closing)
+                lua_sethook(ctx->state, abort_hook, LUA_MASKCOUNT, 1000);
+            aborted = true;
+        }
+        if (aborted) {
+            pthread_cond_wait(&lctx->wakeup, &lctx->lock);
+        } else {
+            mpthread_cond_timed_wait(&lctx->wakeup, &lctx->lock, timeout);
+        }
+    }
+    pthread_mutex_unlock(&lctx->lock);
+    pthread_join(ctx->thread, NULL);
+
+    MP_VERBOSE(ctx, "Script used %.3f seconds of CPU time.\n", ctx->cpu_time);
+
+    for (int n = 0; n < ctx->num_observers; n++)
+        mp_unobserve_property(mpctx, ctx->observers[n]->obs);
     for (int n = 0; n < lctx->num_scripts; n++) {
         if (lctx->scripts[n] == ctx) {
             MP_TARRAY_REMOVE_AT(lctx->scripts, lctx->num_scripts, n);
             break;
         }
     }
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
     talloc_free(ctx);
 }
 
@@ -324,16 +628,13 @@ void mp_lua_event(struct MPContext *mpctx, const char *name, const char *arg)
     // There is no proper subscription mechanism yet, so all scripts get it.
     struct lua_ctx *lctx = mpctx->lua_ctx;
     for (int n = 0; n < lctx->num_scripts; n++) {
-        struct script_ctx *ctx = lctx->scripts[n];
-        lua_State *L = ctx->state;
-        lua_pushstring(L, name);
-        if (arg) {
-            lua_pushstring(L, arg);
-        } else {
-            lua_pushnil(L);
-        }
-        if (mp_cpcall(L, run_event, 2) != 0)
-            report_error(L);
+        struct script_event *ev = talloc_ptrtype(NULL, ev);
+        *ev = (struct script_event) {
+            .type = SCRIPT_EVENT,
+            .name = talloc_strdup(ev, name),
+            .arg = talloc_strdup(ev, arg),
+        };
+        queue_event(lctx->scripts[n], ev);
     }
 }
 
@@ -359,11 +660,13 @@ void mp_lua_script_dispatch(struct MPContext *mpctx, char *script_name,
                    script_name);
         return;
     }
-    lua_State *L = ctx->state;
-    lua_pushinteger(L, id);
-    lua_pushstring(L, event);
-    if (mp_cpcall(L, run_script_dispatch, 2) != 0)
-        report_error(L);
+    struct script_event *ev = talloc_ptrtype(NULL, ev);
+    *ev = (struct script_event) {
+        .type = SCRIPT_DISPATCH,
+        .id = id,
+        .arg = talloc_strdup(ev, event),
+    };
+    queue_event(ctx, ev);
 }
 
 static int script_send_command(lua_State *L)
@@ -413,12 +716,10 @@ static int script_property_list(lua_State *L)
     return 1;
 }
 
-static int script_property_string(lua_State *L)
+static int property_string(lua_State *L, int type)
 {
     struct MPContext *mpctx = get_mpctx(L);
     const char *name = luaL_checkstring(L, 1);
-    int type = lua_tointeger(L, lua_upvalueindex(1))
-               ? M_PROPERTY_PRINT : M_PROPERTY_GET_STRING;
 
     char *result = NULL;
     if (mp_property_do(name, type, &result, mpctx) >= 0 && result) {
@@ -433,6 +734,164 @@ static int script_property_string(lua_State *L)
     return 0;
 }
 
+static int script_property_get(lua_State *L)
+{
+    return property_string(L, M_PROPERTY_GET_STRING);
+}
+
+static int script_property_get_string(lua_State *L)
+{
+    return property_string(L, M_PROPERTY_PRINT);
+}
+
+// Push a property value as native Lua type. Types that have no Lua equivalent
+// are pushed as string.
+static void push_native_value(lua_State *L, struct m_option *type, void *value)
+{
+    if (type->type == CONF_TYPE_FLAG) {
+        lua_pushboolean(L, *(int *)value);
+    } else if (type->type == CONF_TYPE_INT) {
+        lua_pushnumber(L, *(int *)value);
+    } else if (type->type == CONF_TYPE_INT64) {
+        lua_pushnumber(L, *(int64_t *)value);
+    } else if (type->type == CONF_TYPE_FLOAT) {
+        lua_pushnumber(L, *(float *)value);
+    } else if (type->type == CONF_TYPE_DOUBLE ||
+               type->type == CONF_TYPE_TIME) {
+        lua_pushnumber(L, *(double *)value);
+    } else if (type->type == CONF_TYPE_STRING) {
+        char *s = *(char **)value;
+        if (s) {
+            lua_pushstring(L, s);
+        } else {
+            lua_pushnil(L);
+        }
+    } else if (type->type == CONF_TYPE_STRING_LIST) {
+        char **list = *(char ***)value;
+        lua_newtable(L); // list
+        for (int n = 0; list && list[n]; n++) {
+            lua_pushinteger(L, n + 1); // list n1
+            lua_pushstring(L, list[n]); // list n1 str
+            lua_settable(L, -3); // list
+        }
+    } else {
+        char *s = m_option_print(type, value);
+        lua_pushstring(L, s ? s : "");
+        talloc_free(s);
+    }
+}
+
+// Push the value of the given property, or return false (and push nothing) if
+// it's unavailable.
+static bool push_property_native(lua_State *L, struct MPContext *mpctx,
+                                 const char *name)
+{
+    struct m_option type = {0};
+    union m_option_value val = {0};
+    if (mp_property_do(name, M_PROPERTY_GET_TYPE, &type, mpctx) <= 0 ||
+        mp_property_do(name, M_PROPERTY_GET, &val, mpctx) <= 0)
+        return false;
+    push_native_value(L, &type, &val);
+    m_option_free(&type, &val);
+    return true;
+}
+
+static int script_property_get_native(lua_State *L)
+{
+    struct MPContext *mpctx = get_mpctx(L);
+    const char *name = luaL_checkstring(L, 1);
+    return push_property_native(L, mpctx, name) ? 1 : 0;
+}
+
+// Takes an array of property names, and returns a table mapping the names to
+// native values. Unavailable properties are left out.
+static int script_property_get_many(lua_State *L)
+{
+    struct MPContext *mpctx = get_mpctx(L);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_newtable(L); // names res
+    for (int n = 1; ; n++) {
+        lua_pushinteger(L, n); // names res n
+        lua_gettable(L, 1); // names res name
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1); // names res
+            break;
+        }
+        const char *name = lua_tostring(L, -1);
+        if (!name)
+            luaL_error(L, "property name %d is not a string", n);
+        if (push_property_native(L, mpctx, name)) // names res name val
+            lua_settable(L, -3); // names res
+        else
+            lua_pop(L, 1); // names res
+    }
+    return 1;
+}
+
+static void destroy_event(void *p)
+{
+    struct script_event *ev = p;
+    if (ev->value_type.type)
+        m_option_free(&ev->value_type, &ev->value);
+}
+
+static int run_property_change(lua_State *L)
+{
+    lua_getglobal(L, "mp_property_change"); // id name value fn
+    if (lua_isnil(L, -1))
+        return 0;
+    lua_insert(L, -4); // fn id name value
+    lua_call(L, 3, 0);
+    return 0;
+}
+
+static void property_change_cb(void *cb_ctx, const char *name,
+                               struct m_option *type, void *value)
+{
+    struct script_observer *so = cb_ctx;
+    struct script_event *ev = talloc_ptrtype(NULL, ev);
+    *ev = (struct script_event) {
+        .type = SCRIPT_PROPERTY,
+        .id = so->id,
+        .name = talloc_strdup(ev, name),
+    };
+    if (type) {
+        // The value is freed after the callback returns.
+        ev->value_type = *type;
+        m_option_copy(type, &ev->value, value);
+        talloc_set_destructor(ev, destroy_event);
+    }
+    queue_event(so->ctx, ev);
+}
+
+static int script_raw_observe_property(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    int id = luaL_checkinteger(L, 1);
+    const char *name = luaL_checkstring(L, 2);
+    struct script_observer *so = talloc_ptrtype(ctx, so);
+    *so = (struct script_observer) { .ctx = ctx, .id = id };
+    so->obs = mp_observe_property(ctx->mpctx, name, property_change_cb, so);
+    MP_TARRAY_APPEND(ctx, ctx->observers, ctx->num_observers, so);
+    return 0;
+}
+
+static int script_raw_unobserve_property(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    int id = luaL_checkinteger(L, 1);
+    for (int n = 0; n < ctx->num_observers; n++) {
+        struct script_observer *so = ctx->observers[n];
+        if (so->id == id) {
+            mp_unobserve_property(ctx->mpctx, so->obs);
+            MP_TARRAY_REMOVE_AT(ctx->observers, ctx->num_observers, n);
+            talloc_free(so);
+            break;
+        }
+    }
+    return 0;
+}
+
 static int script_set_osd_ass(lua_State *L)
 {
     struct MPContext *mpctx = get_mpctx(L);
@@ -636,30 +1095,65 @@ static int script_format_time(lua_State *L)
     return 1;
 }
 
+struct core_call {
+    lua_State *L;
+    lua_CFunction fn;
+    int status;
+};
+
+static void run_core_call(void *p)
+{
+    struct core_call *c = p;
+    c->status = mp_cpcall_res(c->L, c->fn, lua_gettop(c->L), LUA_MULTRET);
+}
+
+// Wrapper for functions that access core state: the function in upvalue 1 is
+// run on the core thread. Lua errors are caught there, and rethrown here on the
+// script thread.
+static int script_call_core(lua_State *L)
+{
+    struct core_call c = {
+        .L = L,
+        .fn = lua_touserdata(L, lua_upvalueindex(1)),
+    };
+    run_on_core(get_ctx(L), run_core_call, &c);
+    if (c.status)
+        lua_error(L);
+    return lua_gettop(L);
+}
+
 struct fn_entry {
     const char *name;
     int (*fn)(lua_State *L);
+    bool core; // accesses core state; must be run on the core thread
 };
 
 #define FN_ENTRY(name) {#name, script_ ## name}
+#define CORE_FN_ENTRY(name) {#name, script_ ## name, true}
 
 static struct fn_entry fn_list[] = {
     FN_ENTRY(log),
-    FN_ENTRY(find_config_file),
+    CORE_FN_ENTRY(find_config_file),
     FN_ENTRY(send_command),
     FN_ENTRY(send_commandv),
     FN_ENTRY(property_list),
-    FN_ENTRY(set_osd_ass),
-    FN_ENTRY(get_osd_resolution),
-    FN_ENTRY(get_screen_size),
-    FN_ENTRY(get_mouse_pos),
+    CORE_FN_ENTRY(property_get),
+    CORE_FN_ENTRY(property_get_string),
+    CORE_FN_ENTRY(property_get_native),
+    CORE_FN_ENTRY(property_get_many),
+    CORE_FN_ENTRY(raw_observe_property),
+    CORE_FN_ENTRY(raw_unobserve_property),
+    CORE_FN_ENTRY(set_osd_ass),
+    CORE_FN_ENTRY(get_osd_resolution),
+    CORE_FN_ENTRY(get_screen_size),
+    CORE_FN_ENTRY(get_mouse_pos),
     FN_ENTRY(get_timer),
-    FN_ENTRY(get_chapter_list),
-    FN_ENTRY(get_track_list),
+    CORE_FN_ENTRY(get_chapter_list),
+    CORE_FN_ENTRY(get_track_list),
     FN_ENTRY(input_define_section),
     FN_ENTRY(input_enable_section),
     FN_ENTRY(input_disable_section),
-    FN_ENTRY(input_set_section_mouse_area),
+    CORE_FN_ENTRY(input_set_section_mouse_area),
     FN_ENTRY(format_time),
 };
 
@@ -669,22 +1163,39 @@ static void add_functions(struct script_ctx *ctx)
     lua_State *L = ctx->state;
 
     for (int n = 0; n < MP_ARRAY_SIZE(fn_list); n++) {
-        lua_pushcfunction(L, fn_list[n].fn);
+        if (fn_list[n].core) {
+            lua_pushlightuserdata(L, fn_list[n].fn);
+            lua_pushcclosure(L, script_call_core, 1);
+        } else {
+            lua_pushcfunction(L, fn_list[n].fn);
+        }
         lua_setfield(L, -2, fn_list[n].name);
     }
+}
 
-    lua_pushinteger(L, 0);
-    lua_pushcclosure(L, script_property_string, 1);
-    lua_setfield(L, -2, "property_get");
-
-    lua_pushinteger(L, 1);
-    lua_pushcclosure(L, script_property_string, 1);
-    lua_setfield(L, -2, "property_get_string");
+// Return the CPU time used by the named script in seconds, or the sum over all
+// scripts if name is NULL. Returns -1 if there is no such script.
+double mp_lua_get_cpu_time(struct MPContext *mpctx, const char *name)
+{
+    struct lua_ctx *lctx = mpctx->lua_ctx;
+    double sum = name ? -1 : 0;
+    for (int n = 0; n < lctx->num_scripts; n++) {
+        struct script_ctx *ctx = lctx->scripts[n];
+        if (name && strcmp(ctx->name, name) != 0)
+            continue;
+        pthread_mutex_lock(&ctx->lock);
+        sum = MPMAX(sum, 0) + ctx->cpu_time;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    return sum;
 }
 
 void mp_lua_init(struct MPContext *mpctx)
 {
-    mpctx->lua_ctx = talloc_zero(NULL, struct lua_ctx);
+    struct lua_ctx *lctx = talloc_zero(NULL, struct lua_ctx);
+    pthread_mutex_init(&lctx->lock, NULL);
+    pthread_cond_init(&lctx->wakeup, NULL);
+    mpctx->lua_ctx = lctx;
     // Load scripts from options
     if (mpctx->opts->lua_load_osc)
         mp_lua_load_script(mpctx, "@osc");
@@ -698,9 +1209,13 @@ void mp_lua_init(struct MPContext *mpctx)
 void mp_lua_uninit(struct MPContext *mpctx)
 {
     if (mpctx->lua_ctx) {
-        while (mpctx->lua_ctx->num_scripts)
-            kill_script(mpctx->lua_ctx->scripts[0]);
-        talloc_free(mpctx->lua_ctx);
+        struct lua_ctx *lctx = mpctx->lua_ctx;
+        while (lctx->num_scripts)
+            kill_script(lctx->scripts[0]);
+        pthread_cond_destroy(&lctx->wakeup);
+        pthread_mutex_destroy(&lctx->lock);
+        talloc_free(lctx->requests);
+        talloc_free(lctx);
         mpctx->lua_ctx = NULL;
     }
 }
@@ -10,5 +10,7 @@ void mp_lua_uninit(struct MPContext *mpctx);
 void mp_lua_event(struct MPContext *mpctx, const char *name, const char *arg);
 void mp_lua_script_dispatch(struct MPContext *mpctx, char *script_name,
                             int id, char *event);
+bool mp_lua_process_requests(struct MPContext *mpctx);
+double mp_lua_get_cpu_time(struct MPContext *mpctx, const char *name);
 
 #endif
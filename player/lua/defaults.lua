@@ -64,6 +64,38 @@ function mp_script_dispatch(id, event)
     end
 end
 
+local prop_observers = {}
+local last_prop_observer = 0
+
+-- Call fn(name, value) each time the property changes, and once with the
+-- initial value. value is nil if the property is unavailable, and otherwise
+-- has the natural Lua type for the property (number, boolean or string).
+-- Changes are detected by the core, so this is cheaper than polling the
+-- property on every "tick" event.
+function mp.observe_property(name, fn)
+    last_prop_observer = last_prop_observer + 1
+    prop_observers[last_prop_observer] = fn
+    mp.raw_observe_property(last_prop_observer, name)
+end
+
+-- Stop all observations registered with this function.
+function mp.unobserve_property(fn)
+    for id, cb in pairs(prop_observers) do
+        if cb == fn then
+            prop_observers[id] = nil
+            mp.raw_unobserve_property(id)
+        end
+    end
+end
+
+-- called by C when an observed property changed
+function mp_property_change(id, name, value)
+    local fn = prop_observers[id]
+    if fn then
+        fn(name, value)
+    end
+end
+
 mp.msg = {
     log = mp.log,
     fatal = function(...) return mp.log("fatal", ...) end,
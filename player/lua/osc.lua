@@ -774,7 +774,7 @@ function osc_init()
 
     --play/pause
     local contentF = function (ass)
-        if mp.property_get("pause") == "yes" then
+        if mp.property_get_native("pause") then
             ass:append("\238\132\129")
         else
             ass:append("\238\128\130")
@@ -902,7 +902,7 @@ function osc_init()
 
     --toggle FS
     local contentF = function (ass)
-        if mp.property_get("fullscreen") == "yes" then
+        if mp.property_get_native("fullscreen") then
             ass:append("\238\132\137")
         else
             ass:append("\238\132\136")
@@ -918,10 +918,7 @@ function osc_init()
     --
 
     local markerF = function ()
-        local duration = 0
-        if not (mp.property_get("length") == nil) then
-            duration = tonumber(mp.property_get("length"))
-        end
+        local duration = mp.property_get_native("length") or 0
 
         local chapters = mp.get_chapter_list()
         local markers = {}
@@ -932,16 +929,17 @@ function osc_init()
     end
 
     local posF = function ()
-        if mp.property_get("length") == nil then
+        local p = mp.property_get_many({"length", "percent-pos"})
+        if p["length"] == nil then
             return nil
         else
-            return tonumber(mp.property_get("percent-pos"))
+            return p["percent-pos"]
         end
     end
 
     local tooltipF = function (pos)
-        if not (mp.property_get("length") == nil) then
-            duration = tonumber(mp.property_get("length"))
+        local duration = mp.property_get_native("length")
+        if not (duration == nil) then
             possec = duration * (pos / 100)
             return mp.format_time(possec)
         else
@@ -1001,9 +999,8 @@ function osc_init()
     local eventresponder = {}
 
     local contentF = function (ass)
-        local cache = mp.property_get("cache")
+        local cache = mp.property_get_native("cache")
         if not (cache == nil) then
-            cache = tonumber(mp.property_get("cache"))
             if (cache < 45) then
                 ass:append("Cache: " .. (cache) .."%")
             end
@@ -1250,7 +1247,8 @@ end
 
 -- called by mpv on every frame
 function tick()
-    if (mp.property_get("fullscreen") == "yes" and user_opts.showfullscreen) or (mp.property_get("fullscreen") == "no" and user_opts.showwindowed) then
+    local fullscreen = mp.property_get_native("fullscreen")
+    if (fullscreen and user_opts.showfullscreen) or (fullscreen == false and user_opts.showwindowed) then
         render()
     else
         mp.set_osd_ass(osc_param.playresy, osc_param.playresy, "")
@@ -61,6 +61,7 @@
 
 #include "core.h"
 #include "lua.h"
+#include "ipc.h"
 #include "command.h"
 #include "screenshot.h"
 
@@ -109,10 +110,14 @@ static MP_NORETURN void exit_player(struct MPContext *mpctx,
 {
     int rc;
     uninit_player(mpctx, INITIALIZED_ALL);
+    mp_prefetch_cancel(mpctx);
+    screenshot_uninit(mpctx);
+    thumbnail_uninit(mpctx);
 
 #if HAVE_ENCODING
     encode_lavc_finish(mpctx->encode_lavc_ctx);
     encode_lavc_free(mpctx->encode_lavc_ctx);
+    encode_parallel_cleanup(mpctx);
 #endif
 
     mpctx->encode_lavc_ctx = NULL;
@@ -121,6 +126,10 @@ static MP_NORETURN void exit_player(struct MPContext *mpctx,
     mp_lua_uninit(mpctx);
 #endif
 
+#if HAVE_UNIX_SOCKET
+    mp_ipc_uninit(mpctx);
+#endif
+
 #if defined(__MINGW32__)
     timeEndPeriod(1);
 #endif
@@ -279,6 +288,9 @@ static int mpv_main(int argc, char *argv[])
 {
     osdep_preinit(&argc, &argv);
 
+    int full_argc = argc;
+    char **full_argv = argv;
+
     if (argc >= 1) {
         argc--;
         argv++;
@@ -373,6 +385,9 @@ static int mpv_main(int argc, char *argv[])
 
 #if HAVE_ENCODING
     if (opts->encode_output.file && *opts->encode_output.file) {
+        if (opts->encode_output.parallel > 1 &&
+            !encode_parallel(mpctx, full_argc, full_argv))
+            exit_player(mpctx, EXIT_ERROR);
         mpctx->encode_lavc_ctx = encode_lavc_init(&opts->encode_output,
                                                   mpctx->global);
         if(!mpctx->encode_lavc_ctx) {
@@ -425,6 +440,10 @@ static int mpv_main(int argc, char *argv[])
     mp_lua_init(mpctx);
 #endif
 
+#if HAVE_UNIX_SOCKET
+    mp_ipc_init(mpctx);
+#endif
+
     if (opts->shuffle)
         playlist_shuffle(mpctx->playlist);
 
@@ -27,7 +27,9 @@
 #include "osdep/timer.h"
 
 #include "common/msg.h"
+#include "common/global.h"
 #include "options/options.h"
+#include "options/m_config.h"
 #include "options/m_property.h"
 #include "common/common.h"
 #include "common/encode.h"
@@ -36,12 +38,17 @@
 
 #include "audio/out/ao.h"
 #include "demux/demux.h"
+#include "demux/stheader.h"
 #include "stream/stream.h"
 #include "video/out/vo.h"
 
 #include "core.h"
 #include "command.h"
 
+#if HAVE_ENCODING
+#include "common/encode_lavc.h"
+#endif
+
 double get_relative_time(struct MPContext *mpctx)
 {
     int64_t new_time = mp_time_us();
@@ -130,6 +137,26 @@ bool mp_get_cache_idle(struct MPContext *mpctx)
     return idle;
 }
 
+// Return a mpv_global with a private copy of the options, for code that runs
+// on other threads while the options can change. If without_file_local is
+// set, the values from before the current file's file-local options were
+// applied are used (e.g. when opening the next file).
+struct mpv_global *mp_copy_global(void *talloc_ctx, struct MPContext *mpctx,
+                                  bool without_file_local)
+{
+    struct mpv_global *global = talloc_ptrtype(talloc_ctx, global);
+    if (without_file_local)
+        m_config_swap_backups(mpctx->mconfig);
+    *global = (struct mpv_global){
+        .opts = m_config_copy_struct(global, mpctx->opts,
+                                     sizeof(struct MPOpts), mp_opts),
+        .log = mpctx->global->log,
+    };
+    if (without_file_local)
+        m_config_swap_backups(mpctx->mconfig);
+    return global;
+}
+
 void update_window_title(struct MPContext *mpctx, bool force)
 {
     if (!mpctx->video_out && !mpctx->ao) {
@@ -186,6 +213,151 @@ void stream_dump(struct MPContext *mpctx)
     }
 }
 
+#if HAVE_ENCODING
+struct copy_stream {
+    struct sh_stream *sh;
+    AVStream *out;
+    bool started;   // a keyframe was written
+    bool eof;
+};
+
+// --ocopy: write the packets of the selected video and audio tracks to the
+// output file, without decoding them. Returns false if stream copy is not
+// possible; nothing has been written in this case, and the streams should be
+// reencoded instead.
+bool remux_file(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct encode_lavc_context *ectx = mpctx->encode_lavc_ctx;
+    struct demuxer *demuxer = mpctx->demuxer;
+    struct copy_stream streams[2];
+    int num_streams = 0;
+
+    if (mpctx->timeline) {
+        MP_WARN(mpctx, "Stream copy is not possible with a timeline, "
+                "reencoding.\n");
+        return false;
+    }
+
+    enum stream_type types[] = {STREAM_VIDEO, STREAM_AUDIO};
+    for (int n = 0; n < MP_ARRAY_SIZE(types); n++) {
+        struct track *track = mpctx->current_track[0][types[n]];
+        if (!track)
+            continue;
+        if (track->is_external || !track->stream ||
+            !track->stream->lav_headers)
+        {
+            MP_WARN(mpctx, "Stream copy is not possible for track %d, "
+                    "reencoding.\n", track->user_tid);
+            return false;
+        }
+        streams[num_streams++] = (struct copy_stream){ .sh = track->stream };
+    }
+    if (!num_streams)
+        return false;
+
+    for (int n = 0; n < num_streams; n++) {
+        streams[n].out = encode_lavc_copy_stream(ectx, streams[n].sh);
+        if (!streams[n].out) {
+            MP_FATAL(mpctx, "Could not set up stream copy.\n");
+            return true;
+        }
+    }
+
+    if (!encode_lavc_start(ectx)) {
+        MP_FATAL(mpctx, "Could not start stream copy.\n");
+        return true;
+    }
+
+    // Don't let the demuxer queue packets nobody reads.
+    for (int n = 0; n < demuxer->num_streams; n++) {
+        struct sh_stream *sh = demuxer->streams[n];
+        bool used = false;
+        for (int i = 0; i < num_streams; i++)
+            used |= streams[i].sh == sh;
+        if (!used)
+            demuxer_select_track(demuxer, sh, false);
+    }
+
+    // Without reencoding, the output can only start on a keyframe.
+    double startpos = rel_time_to_abs(mpctx, opts->play_start, -1);
+    if (startpos != -1)
+        demux_seek(demuxer, startpos, SEEK_ABSOLUTE | SEEK_BACKWARD);
+    double endpts = get_play_end_pts(mpctx);
+
+    bool copyts = opts->encode_output.copyts || opts->encode_output.rawts;
+    double offset = copyts ? 0 : MP_NOPTS_VALUE;
+    double last_status = 0;
+
+    MP_VERBOSE(mpctx, "Starting stream copy...\n");
+    mpctx->error_playing = false;
+
+    while (mpctx->stop_play == KEEP_PLAYING) {
+        // Write the stream with the lowest timestamp first.
+        struct copy_stream *s = NULL;
+        double s_pts = MP_NOPTS_VALUE;
+        for (int n = 0; n < num_streams; n++) {
+            if (streams[n].eof)
+                continue;
+            double pts = demux_get_next_pts(streams[n].sh);
+            if (!demux_has_packet(streams[n].sh)) {
+                streams[n].eof = true;
+                continue;
+            }
+            if (!s || (pts != MP_NOPTS_VALUE &&
+                       (s_pts == MP_NOPTS_VALUE || pts < s_pts)))
+            {
+                s = &streams[n];
+                s_pts = pts;
+            }
+        }
+        if (!s)
+            break;
+
+        struct demux_packet *dp = demux_read_packet(s->sh);
+        if (!dp) {
+            s->eof = true;
+            continue;
+        }
+        double ts = dp->dts != MP_NOPTS_VALUE ? dp->dts : dp->pts;
+        if (endpts != MP_NOPTS_VALUE && ts != MP_NOPTS_VALUE && ts >= endpts) {
+            s->eof = true;
+        } else if (s->started || dp->keyframe) {
+            s->started = true;
+            if (offset == MP_NOPTS_VALUE && ts != MP_NOPTS_VALUE)
+                offset = ts - encode_lavc_copy_end_pts(ectx);
+            if (encode_lavc_write_demux_packet(ectx, s->out, dp,
+                    offset == MP_NOPTS_VALUE ? 0 : offset) < 0)
+                MP_ERR(mpctx, "Error writing packet.\n");
+        }
+        talloc_free(dp);
+
+        if (encode_lavc_didfail(ectx))
+            break;
+
+        double now = mp_time_sec();
+        if (!opts->quiet && ts != MP_NOPTS_VALUE && now - last_status >= 0.5) {
+            char *time = mp_format_time(ts, false);
+            char *line = talloc_asprintf(NULL, "Copying %s...", time);
+            write_status_line(mpctx, line);
+            talloc_free(line);
+            talloc_free(time);
+            last_status = now;
+        }
+
+        for (;;) {
+            mp_cmd_t *cmd = mp_input_get_cmd(mpctx->input, 0, false);
+            if (!cmd)
+                break;
+            run_command(mpctx, cmd);
+            talloc_free(cmd);
+        }
+    }
+
+    return true;
+}
+#endif
+
 void merge_playlist_files(struct playlist *pl)
 {
     if (!pl->first)
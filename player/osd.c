@@ -88,6 +88,11 @@ void print_status(struct MPContext *mpctx)
 
     update_window_title(mpctx, false);
 
+#if HAVE_ENCODING
+    encode_lavc_report_status(mpctx->encode_lavc_ctx,
+                              get_current_pos_ratio(mpctx, true));
+#endif
+
     if (opts->quiet)
         return;
 
@@ -152,6 +152,39 @@ static bool redraw_osd(struct MPContext *mpctx)
     return true;
 }
 
+// Display a frame from --backstep-cache (while paused). The decoder is left
+// alone, and following frames are taken from the cache until the decoder
+// position is reached again (see update_video()).
+static void show_cached_frame(struct MPContext *mpctx, struct mp_image *img)
+{
+    struct vo *vo = mpctx->video_out;
+
+    if (vo->frame_loaded)
+        vo_skip_frame(vo);
+    vo_queue_image(vo, img);
+    if (!vo->frame_loaded)
+        return;
+
+    mpctx->hrseek_active = false;
+    mpctx->hrseek_framedrop = false;
+    mpctx->frame_cache_active = true;
+    mpctx->frame_cache_pos = img->pts;
+    // The frame doesn't follow the previously shown frame.
+    mpctx->vo_pts_history_seek_ts++;
+    add_frame_pts(mpctx, img->pts);
+
+    vo_new_frame_imminent(vo);
+    mpctx->video_pts = img->pts;
+    mpctx->video_next_pts = img->pts;
+    mpctx->last_vo_pts = img->pts;
+    mpctx->playback_pts = img->pts;
+    mpctx->time_frame = 0;
+    update_subtitles(mpctx);
+    update_osd_msg(mpctx);
+    draw_osd(mpctx);
+    vo_flip_page(vo, 0, -1);
+}
+
 void add_step_frame(struct MPContext *mpctx, int dir)
 {
     if (!mpctx->d_video)
@@ -183,6 +216,7 @@ static void seek_reset(struct MPContext *mpctx, bool reset_ao)
 
     reset_subtitles(mpctx, 0);
     reset_subtitles(mpctx, 1);
+    video_cache_reset(mpctx);
 
     mpctx->video_pts = MP_NOPTS_VALUE;
     mpctx->video_next_pts = MP_NOPTS_VALUE;
@@ -386,10 +420,42 @@ void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
     abort();
 }
 
+// If paused, and the target frame of a precise seek is in --backstep-cache,
+// show it without seeking.
+static bool seek_from_cache(struct MPContext *mpctx, struct seek_params seek)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    if (!mpctx->paused || !mpctx->d_video || !mpctx->video_out ||
+        !mpctx->num_frame_cache || mpctx->timeline || mpctx->stop_play ||
+        !mpctx->demuxer || !mpctx->demuxer->accurate_seek ||
+        !opts->correct_pts || seek.exact < 0)
+        return false;
+
+    bool hr_seek = (opts->hr_seek == 0 && seek.type == MPSEEK_ABSOLUTE) ||
+                   opts->hr_seek > 0 || seek.exact > 0;
+    if (!hr_seek)
+        return false;
+    if (seek.type == MPSEEK_RELATIVE) {
+        seek.amount += get_current_time(mpctx);
+    } else if (seek.type != MPSEEK_ABSOLUTE) {
+        return false;
+    }
+
+    struct mp_image *img = video_cache_get_seek_target(mpctx, seek.amount);
+    if (!img)
+        return false;
+    show_cached_frame(mpctx, img);
+    mpctx->backstep_active = false;
+    mpctx->last_seek_pts = seek.amount;
+    return true;
+}
+
 void execute_queued_seek(struct MPContext *mpctx)
 {
     if (mpctx->seek.type) {
-        mp_seek(mpctx, mpctx->seek, false);
+        if (!seek_from_cache(mpctx, mpctx->seek))
+            mp_seek(mpctx, mpctx->seek, false);
         mpctx->seek = (struct seek_params){0};
     }
 }
@@ -802,7 +868,10 @@ static void handle_backstep(struct MPContext *mpctx)
     bool demuxer_ok = mpctx->demuxer && mpctx->demuxer->accurate_seek;
     if (demuxer_ok && mpctx->d_video && current_pts != MP_NOPTS_VALUE) {
         double seek_pts = find_previous_pts(mpctx, current_pts);
-        if (seek_pts != MP_NOPTS_VALUE) {
+        struct mp_image *cached = video_cache_get_prev(mpctx, current_pts);
+        if (cached) {
+            show_cached_frame(mpctx, cached);
+        } else if (seek_pts != MP_NOPTS_VALUE) {
             queue_seek(mpctx, MPSEEK_ABSOLUTE, seek_pts, 2);
         } else {
             double last = get_last_frame_pts(mpctx);
@@ -936,6 +1005,22 @@ static double get_wakeup_period(struct MPContext *mpctx)
     return sleeptime;
 }
 
+// Sleep until input arrives or the timeout expires. Requests from script
+// threads are served while waiting, without running a whole playloop iteration
+// for each of them.
+static void wait_events(struct MPContext *mpctx, double sleeptime)
+{
+    double end = mp_time_sec() + sleeptime;
+    while (sleeptime > 0) {
+        // Round up, so that we don't spin with a 0 timeout until the deadline.
+        int timeout = ceil(sleeptime * 1000);
+        bool got_cmd = mp_input_get_cmd(mpctx->input, timeout, true);
+        if (!mp_handle_script_requests(mpctx) || got_cmd)
+            break;
+        sleeptime = end - mp_time_sec();
+    }
+}
+
 void run_playloop(struct MPContext *mpctx)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -1288,7 +1373,7 @@ void run_playloop(struct MPContext *mpctx)
                 sleeptime = 0;
         }
         if (sleeptime > 0)
-            mp_input_get_cmd(mpctx->input, sleeptime * 1000, true);
+            wait_events(mpctx, sleeptime);
     }
 
     handle_metadata_update(mpctx);
@@ -1307,6 +1392,9 @@ void run_playloop(struct MPContext *mpctx)
 
     execute_queued_seek(mpctx);
 
+    mp_prefetch_next(mpctx);
+    timeline_prefetch_next(mpctx);
+
     getch2_poll();
 }
 
@@ -1318,8 +1406,11 @@ void idle_loop(struct MPContext *mpctx)
     while (mpctx->opts->player_idle_mode && !mpctx->playlist->current
            && mpctx->stop_play != PT_QUIT)
     {
-        if (need_reinit)
+        if (need_reinit) {
+            // Nothing is going to be played next.
+            mp_prefetch_cancel(mpctx);
             handle_force_window(mpctx, true);
+        }
         need_reinit = false;
         int uninit = INITIALIZED_AO;
         if (!mpctx->opts->force_vo)
@@ -1330,9 +1421,8 @@ void idle_loop(struct MPContext *mpctx)
             vo_check_events(mpctx->video_out);
         update_osd_msg(mpctx);
         handle_osd_redraw(mpctx);
-        mp_cmd_t *cmd = mp_input_get_cmd(mpctx->input,
-                                         get_wakeup_period(mpctx) * 1000,
-                                         false);
+        wait_events(mpctx, get_wakeup_period(mpctx));
+        mp_cmd_t *cmd = mp_input_get_cmd(mpctx->input, 0, false);
         if (cmd)
             run_command(mpctx, cmd);
         mp_cmd_free(cmd);
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include "osdep/io.h"
+#include "osdep/numcores.h"
 
 #include "talloc.h"
 #include "screenshot.h"
@@ -51,6 +52,9 @@ typedef struct screenshot_ctx {
     bool osd;
 
     int frameno;
+
+    // Created on the first screenshot.
+    struct image_writer_queue *queue;
 } screenshot_ctx;
 
 void screenshot_init(struct MPContext *mpctx)
@@ -62,6 +66,14 @@ void screenshot_init(struct MPContext *mpctx)
     };
 }
 
+void screenshot_uninit(struct MPContext *mpctx)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+
+    image_writer_queue_destroy(ctx->queue);
+    ctx->queue = NULL;
+}
+
 #define SMSG_OK 0
 #define SMSG_ERR 1
 
@@ -243,6 +255,13 @@ error_exit:
     return NULL;
 }
 
+// Also consider files that are still being written in the background.
+static bool file_exists(screenshot_ctx *ctx, const char *filename)
+{
+    return mp_path_exists(filename) ||
+           (ctx->queue && image_writer_queue_has_file(ctx->queue, filename));
+}
+
 static char *gen_fname(screenshot_ctx *ctx, const char *file_ext)
 {
     int sequence = 0;
@@ -261,7 +280,7 @@ static char *gen_fname(screenshot_ctx *ctx, const char *file_ext)
             return NULL;
         }
 
-        if (!mp_path_exists(fname))
+        if (!file_exists(ctx, fname))
             return fname;
 
         if (sequence == prev_sequence) {
@@ -292,6 +311,21 @@ static void add_subs(struct MPContext *mpctx, struct mp_image *image)
                       OSD_DRAW_SUB_ONLY, image);
 }
 
+// Write the image in the background, so that playback doesn't stall while
+// the image is compressed. Takes ownership of the image.
+static void write_screenshot(struct MPContext *mpctx, struct mp_image *image,
+                             const struct image_writer_opts *opts,
+                             const char *filename)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+
+    if (!ctx->queue) {
+        int threads = MPMAX(default_thread_count(), 1);
+        ctx->queue = image_writer_queue_create(mpctx->log, threads, threads);
+    }
+    image_writer_queue_add(ctx->queue, image, opts, filename);
+}
+
 static void screenshot_save(struct MPContext *mpctx, struct mp_image *image)
 {
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
@@ -301,9 +335,10 @@ static void screenshot_save(struct MPContext *mpctx, struct mp_image *image)
     char *filename = gen_fname(ctx, image_writer_file_ext(opts));
     if (filename) {
         screenshot_msg(ctx, SMSG_OK, "Screenshot: '%s'", filename);
-        if (!write_image(image, opts, filename, mpctx->log))
-            screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot!");
+        write_screenshot(mpctx, image, opts, filename);
         talloc_free(filename);
+    } else {
+        talloc_free(image);
     }
 }
 
@@ -340,7 +375,7 @@ void screenshot_to_file(struct MPContext *mpctx, const char *filename, int mode,
     bool old_osd = ctx->osd;
     ctx->osd = osd;
 
-    if (mp_path_exists(filename)) {
+    if (file_exists(ctx, filename)) {
         screenshot_msg(ctx, SMSG_ERR, "Screenshot: file '%s' already exists.",
                        filename);
         goto end;
@@ -354,9 +389,7 @@ void screenshot_to_file(struct MPContext *mpctx, const char *filename, int mode,
         goto end;
     }
     screenshot_msg(ctx, SMSG_OK, "Screenshot: '%s'", filename);
-    if (!write_image(image, &opts, filename, mpctx->log))
-        screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot!");
-    talloc_free(image);
+    write_screenshot(mpctx, image, &opts, filename);
 
 end:
     ctx->osd = old_osd;
@@ -388,14 +421,16 @@ void screenshot_request(struct MPContext *mpctx, int mode, bool each_frame,
     } else {
         screenshot_msg(ctx, SMSG_ERR, "Taking screenshot failed.");
     }
-
-    talloc_free(image);
 }
 
 void screenshot_flip(struct MPContext *mpctx)
 {
     screenshot_ctx *ctx = mpctx->screenshot_ctx;
 
+    // Report errors from screenshots written in the background.
+    if (ctx->queue && image_writer_queue_get_errors(ctx->queue))
+        screenshot_msg(ctx, SMSG_ERR, "Error writing screenshot!");
+
     if (!ctx->each_frame)
         return;
 
@@ -34,6 +34,7 @@
 #include "demux/demux.h"
 #include "video/mp_image.h"
 #include "video/decode/dec_video.h"
+#include "video/out/vo.h"
 
 #include "core.h"
 
@@ -134,6 +135,19 @@ static void update_subtitle(struct MPContext *mpctx, int order)
         }
     }
 
+    // Tell the decoder which frames the VO is going to display next, so that
+    // it can render them before draw_osd() asks for them.
+    struct vo *vo = mpctx->video_out;
+    if (osd_obj->render_bitmap_subs && vo && vo->frame_loaded) {
+        double frame_pts[2] = {mpctx->video_next_pts, vo->next_pts2};
+        for (int n = 0; n < 2; n++) {
+            if (frame_pts[n] == MP_NOPTS_VALUE)
+                continue;
+            double pts = frame_pts[n] - osd_obj->video_offset + opts->sub_delay;
+            sub_control(dec_sub, SD_CTRL_RENDER_AHEAD, &pts);
+        }
+    }
+
     // Handle displaying subtitles on terminal; never done for secondary subs
     if (order == 0) {
         if (!osd_obj->render_bitmap_subs || !mpctx->video_out)
@@ -205,6 +219,8 @@ static void reinit_subdec(struct MPContext *mpctx, struct track *track,
     sub_set_video_res(dec_sub, w, h);
     sub_set_video_fps(dec_sub, fps);
     sub_set_ass_renderer(dec_sub, mpctx->ass_library, mpctx->ass_renderer);
+    sub_set_ass_fonts(dec_sub, mpctx->copy_ass_fonts, mpctx->ass_fonts,
+                      mpctx->num_ass_fonts);
     sub_init_from_sh(dec_sub, track->stream);
 
     // Don't do this if the file has video/audio streams. Don't do it even
@@ -0,0 +1,503 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Thumbnails for seek previews. They are generated on a worker thread, which
+ * opens its own stream, demuxer and decoder for the file, so that playback is
+ * not disturbed. Only the keyframe before the requested time is decoded.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "talloc.h"
+
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "options/options.h"
+#include "input/input.h"
+#include "stream/stream.h"
+#include "demux/demux.h"
+#include "demux/stheader.h"
+#include "video/mp_image.h"
+#include "video/sws_utils.h"
+#include "video/decode/dec_video.h"
+#include "video/decode/vd.h"
+
+#include "core.h"
+#include "command.h"
+
+// Thumbnails are cached per file and time bucket of this many seconds.
+#define THUMB_BUCKET 1.0
+// Maximum total size of the cached thumbnail images, in bytes.
+#define THUMB_CACHE_BYTES (64 * 1024 * 1024)
+// Give up if no frame was decoded after this many packets.
+#define THUMB_MAX_PACKETS 300
+
+struct thumb {
+    char *filename;
+    int64_t bucket;
+    int w, h;               // requested maximum size
+    // Options copied when the request was queued; the worker takes them.
+    struct mpv_global *global;
+    struct mp_image *image; // result (NULL on failure)
+    bool done;
+    bool busy;              // being generated by the worker
+};
+
+// An overlay waiting for its thumbnail (main thread only).
+struct thumb_display {
+    int id, x, y;
+    char *filename;
+    int64_t bucket;
+    int w, h;
+};
+
+struct thumbnail_ctx {
+    struct mp_log *log;
+    struct input_ctx *input;
+    struct mp_cancel *cancel;   // aborts opening/reading on uninit
+
+    pthread_t thread;
+    bool thread_valid;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    bool terminate;
+    bool new_results;
+    // Cache, oldest first. Entries and their images are not talloc children
+    // of the context, because the worker thread allocates them.
+    struct thumb **thumbs;
+    int num_thumbs;
+
+    // Main thread only.
+    struct thumb_display *displays;
+    int num_displays;
+
+    // Worker thread only.
+    char *open_filename;
+    struct mpv_global *open_global; // options the file was opened with
+    struct stream *stream;
+    struct demuxer *demuxer;
+    struct dec_video *d_video;
+};
+
+static bool thumb_matches(struct thumb *t, const char *filename,
+                          int64_t bucket, int w, int h)
+{
+    return t->bucket == bucket && t->w == w && t->h == h &&
+           strcmp(t->filename, filename) == 0;
+}
+
+// Must be called with ctx->lock held.
+static struct thumb *find_thumb(struct thumbnail_ctx *ctx, const char *filename,
+                                int64_t bucket, int w, int h)
+{
+    for (int n = 0; n < ctx->num_thumbs; n++) {
+        struct thumb *t = ctx->thumbs[n];
+        if (thumb_matches(t, filename, bucket, w, h))
+            return t;
+    }
+    return NULL;
+}
+
+// Must be called with ctx->lock held.
+static void remove_thumb(struct thumbnail_ctx *ctx, int index)
+{
+    assert(!ctx->thumbs[index]->busy);
+    talloc_free(ctx->thumbs[index]);
+    MP_TARRAY_REMOVE_AT(ctx->thumbs, ctx->num_thumbs, index);
+}
+
+static size_t image_bytes(struct mp_image *img)
+{
+    size_t size = 0;
+    for (int n = 0; n < img->num_planes; n++)
+        size += (size_t)abs(img->stride[n]) * img->plane_h[n];
+    return size;
+}
+
+// Remove the oldest finished entries until the images fit into the cache
+// limit. Must be called with ctx->lock held.
+static void trim_cache(struct thumbnail_ctx *ctx)
+{
+    size_t total = 0;
+    for (int n = 0; n < ctx->num_thumbs; n++) {
+        struct thumb *t = ctx->thumbs[n];
+        if (t->image)
+            total += image_bytes(t->image);
+    }
+    for (int n = 0; n < ctx->num_thumbs && total > THUMB_CACHE_BYTES;) {
+        struct thumb *t = ctx->thumbs[n];
+        if (t->done) {
+            if (t->image)
+                total -= image_bytes(t->image);
+            remove_thumb(ctx, n);
+        } else {
+            n++;
+        }
+    }
+}
+
+static void close_file(struct thumbnail_ctx *ctx)
+{
+    if (ctx->d_video)
+        video_uninit(ctx->d_video);
+    ctx->d_video = NULL;
+    free_demuxer(ctx->demuxer);
+    ctx->demuxer = NULL;
+    free_stream(ctx->stream);
+    ctx->stream = NULL;
+    talloc_free(ctx->open_filename);
+    ctx->open_filename = NULL;
+    talloc_free(ctx->open_global);
+    ctx->open_global = NULL;
+}
+
+// Returns whether the file has a usable video decoder. Takes ownership of
+// global, which is used only if the file isn't open yet.
+static bool open_file(struct thumbnail_ctx *ctx, const char *filename,
+                      struct mpv_global *global)
+{
+    if (ctx->open_filename && strcmp(ctx->open_filename, filename) == 0) {
+        talloc_free(global);
+        return !!ctx->d_video;
+    }
+
+    close_file(ctx);
+    ctx->open_filename = talloc_strdup(NULL, filename);
+    ctx->open_global = global;
+    struct MPOpts *opts = global->opts;
+
+    ctx->stream = stream_create(filename, STREAM_READ, ctx->cancel, global);
+    if (!ctx->stream)
+        return false;
+    ctx->demuxer = demux_open(ctx->stream, opts->demuxer_name, NULL, global);
+    if (!ctx->demuxer || !ctx->demuxer->seekable)
+        return false;
+
+    struct sh_stream *sh = NULL;
+    for (int n = 0; n < ctx->demuxer->num_streams; n++) {
+        struct sh_stream *s = ctx->demuxer->streams[n];
+        if (!sh && s->type == STREAM_VIDEO && !s->attached_picture)
+            sh = s;
+    }
+    for (int n = 0; n < ctx->demuxer->num_streams; n++) {
+        struct sh_stream *s = ctx->demuxer->streams[n];
+        demuxer_select_track(ctx->demuxer, s, s == sh);
+    }
+    if (!sh)
+        return false;
+
+    struct dec_video *d_video = talloc_zero(NULL, struct dec_video);
+    d_video->global = global;
+    d_video->log = mp_log_new(d_video, ctx->log, "!vd");
+    d_video->opts = opts;
+    d_video->header = sh;
+    d_video->fps = sh->video->fps;
+    if (!video_init_best_codec(d_video, opts->video_decoders)) {
+        video_uninit(d_video);
+        return false;
+    }
+    ctx->d_video = d_video;
+    return true;
+}
+
+// Decode the first frame starting at the keyframe before the given time, and
+// scale it to fit into w x h.
+static struct mp_image *generate_thumb(struct thumbnail_ctx *ctx,
+                                       struct mpv_global *global,
+                                       const char *filename, double time,
+                                       int w, int h)
+{
+    if (!open_file(ctx, filename, global))
+        return NULL;
+
+    struct dec_video *d_video = ctx->d_video;
+    demux_seek(ctx->demuxer, time, SEEK_ABSOLUTE | SEEK_BACKWARD);
+    video_reset_decoding(d_video);
+
+    struct mp_image *frame = NULL;
+    bool keyframe = false;
+    for (int n = 0; n < THUMB_MAX_PACKETS && !frame; n++) {
+        struct demux_packet *pkt = demux_read_packet(d_video->header);
+        if (pkt && !keyframe && !pkt->keyframe) {
+            talloc_free(pkt);
+            continue;
+        }
+        // Only the keyframe is wanted. Packets after it are fed only to get
+        // the frame out of decoders with delay, so skip as much as possible.
+        int flags = keyframe ? 1 : 0;
+        keyframe = true;
+        frame = d_video->vd_driver->decode(d_video, pkt, flags);
+        if (!pkt)
+            break;
+        talloc_free(pkt);
+    }
+    if (!frame)
+        return NULL;
+
+    int d_w = frame->display_w ? frame->display_w : frame->w;
+    int d_h = frame->display_h ? frame->display_h : frame->h;
+    double scale = MPMIN(w / (double)d_w, h / (double)d_h);
+    int tw = MPMAX(lrint(d_w * scale), 1);
+    int th = MPMAX(lrint(d_h * scale), 1);
+
+    struct mp_image *thumb = mp_image_alloc(IMGFMT_BGRA, tw, th);
+    if (thumb)
+        mp_image_swscale(thumb, frame, mp_sws_fast_flags);
+    talloc_free(frame);
+    return thumb;
+}
+
+static void *thumbnail_thread(void *arg)
+{
+    struct thumbnail_ctx *ctx = arg;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (!ctx->terminate) {
+        // Prefer the most recent request; the user is probably scrubbing.
+        struct thumb *t = NULL;
+        for (int n = ctx->num_thumbs - 1; n >= 0; n--) {
+            if (!ctx->thumbs[n]->done) {
+                t = ctx->thumbs[n];
+                break;
+            }
+        }
+        if (!t) {
+            pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+            continue;
+        }
+        t->busy = true;
+        char *filename = talloc_strdup(NULL, t->filename);
+        struct mpv_global *global = talloc_steal(NULL, t->global);
+        t->global = NULL;
+        double time = t->bucket * THUMB_BUCKET;
+        int w = t->w, h = t->h;
+        pthread_mutex_unlock(&ctx->lock);
+
+        struct mp_image *image =
+            generate_thumb(ctx, global, filename, time, w, h);
+        talloc_free(filename);
+
+        pthread_mutex_lock(&ctx->lock);
+        t->image = image ? talloc_steal(t, image) : NULL;
+        t->done = true;
+        t->busy = false;
+        ctx->new_results = true;
+        mp_input_wakeup(ctx->input);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    close_file(ctx);
+    return NULL;
+}
+
+static struct thumbnail_ctx *get_ctx(struct MPContext *mpctx)
+{
+    if (mpctx->thumbnail_ctx)
+        return mpctx->thumbnail_ctx;
+
+    struct thumbnail_ctx *ctx = talloc_zero(NULL, struct thumbnail_ctx);
+    ctx->log = mp_log_new(ctx, mpctx->log, "thumbnail");
+    ctx->input = mpctx->input;
+    ctx->cancel = mp_cancel_new(ctx);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wakeup, NULL);
+    if (pthread_create(&ctx->thread, NULL, thumbnail_thread, ctx)) {
+        MP_ERR(ctx, "Could not create thread.\n");
+    } else {
+        ctx->thread_valid = true;
+    }
+    mpctx->thumbnail_ctx = ctx;
+    return ctx;
+}
+
+static void remove_display(struct thumbnail_ctx *ctx, int index)
+{
+    talloc_free(ctx->displays[index].filename);
+    MP_TARRAY_REMOVE_AT(ctx->displays, ctx->num_displays, index);
+}
+
+// Show a thumbnail of the current file at the given time as overlay (see
+// overlay_add), scaled to fit into w x h. If it's not cached, it's generated
+// in the background, and shown when done.
+int thumbnail_request(struct MPContext *mpctx, int id, int x, int y,
+                      double time, int w, int h)
+{
+    if (!mpctx->filename || mpctx->timeline || time < 0 || w < 1 || h < 1 ||
+        w > 4096 || h > 4096)
+        return -1;
+
+    struct thumbnail_ctx *ctx = get_ctx(mpctx);
+    if (!ctx->thread_valid)
+        return -1;
+
+    char *filename = mpctx->filename;
+    int64_t bucket = floor(time / THUMB_BUCKET);
+
+    for (int n = ctx->num_displays - 1; n >= 0; n--) {
+        if (ctx->displays[n].id == id)
+            remove_display(ctx, n);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    struct thumb *t = find_thumb(ctx, filename, bucket, w, h);
+    if (t && t->done) {
+        // Move to the end, so it's evicted last.
+        for (int n = 0; n < ctx->num_thumbs; n++) {
+            if (ctx->thumbs[n] == t) {
+                MP_TARRAY_REMOVE_AT(ctx->thumbs, ctx->num_thumbs, n);
+                break;
+            }
+        }
+        MP_TARRAY_APPEND(ctx, ctx->thumbs, ctx->num_thumbs, t);
+        struct mp_image *image = t->image ? mp_image_new_ref(t->image) : NULL;
+        pthread_mutex_unlock(&ctx->lock);
+        if (!image)
+            return -1;
+        mp_overlay_set_image(mpctx, id, x, y, image);
+        return 0;
+    }
+
+    // Drop pending requests nobody waits for anymore.
+    for (int n = ctx->num_thumbs - 1; n >= 0; n--) {
+        struct thumb *p = ctx->thumbs[n];
+        if (p->done || p->busy)
+            continue;
+        bool wanted = false;
+        for (int i = 0; i < ctx->num_displays; i++) {
+            struct thumb_display *d = &ctx->displays[i];
+            wanted |= thumb_matches(p, d->filename, d->bucket, d->w, d->h);
+        }
+        if (!wanted)
+            remove_thumb(ctx, n);
+    }
+
+    if (!find_thumb(ctx, filename, bucket, w, h)) {
+        t = talloc_ptrtype(NULL, t);
+        *t = (struct thumb) {
+            .filename = talloc_strdup(t, filename),
+            .bucket = bucket,
+            .w = w,
+            .h = h,
+        };
+        // The worker must not read the options while they can change.
+        t->global = mp_copy_global(t, mpctx, false);
+        MP_TARRAY_APPEND(ctx, ctx->thumbs, ctx->num_thumbs, t);
+        pthread_cond_signal(&ctx->wakeup);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    struct thumb_display d = {
+        .id = id, .x = x, .y = y,
+        .filename = talloc_strdup(ctx, filename),
+        .bucket = bucket,
+        .w = w, .h = h,
+    };
+    MP_TARRAY_APPEND(ctx, ctx->displays, ctx->num_displays, d);
+    mp_notify_property(mpctx, "thumbnail-pending");
+    return 0;
+}
+
+// Stop waiting for a thumbnail for the given overlay ID.
+void thumbnail_cancel(struct MPContext *mpctx, int id)
+{
+    struct thumbnail_ctx *ctx = mpctx->thumbnail_ctx;
+    if (!ctx)
+        return;
+    for (int n = ctx->num_displays - 1; n >= 0; n--) {
+        if (ctx->displays[n].id == id) {
+            remove_display(ctx, n);
+            mp_notify_property(mpctx, "thumbnail-pending");
+        }
+    }
+}
+
+// Number of overlays waiting for their thumbnail.
+int thumbnail_get_pending(struct MPContext *mpctx)
+{
+    struct thumbnail_ctx *ctx = mpctx->thumbnail_ctx;
+    return ctx ? ctx->num_displays : 0;
+}
+
+// Show finished thumbnails. Returns whether there were any.
+bool thumbnail_process_results(struct MPContext *mpctx)
+{
+    struct thumbnail_ctx *ctx = mpctx->thumbnail_ctx;
+    if (!ctx)
+        return false;
+
+    pthread_mutex_lock(&ctx->lock);
+    bool new_results = ctx->new_results;
+    ctx->new_results = false;
+    pthread_mutex_unlock(&ctx->lock);
+    if (!new_results)
+        return false;
+
+    for (int n = ctx->num_displays - 1; n >= 0; n--) {
+        struct thumb_display *d = &ctx->displays[n];
+        pthread_mutex_lock(&ctx->lock);
+        struct thumb *t = find_thumb(ctx, d->filename, d->bucket, d->w, d->h);
+        bool done = !t || t->done;
+        struct mp_image *image = t && t->image ? mp_image_new_ref(t->image)
+                                               : NULL;
+        pthread_mutex_unlock(&ctx->lock);
+        if (!done)
+            continue;
+        if (image) {
+            mp_overlay_set_image(mpctx, d->id, d->x, d->y, image);
+        } else {
+            MP_VERBOSE(ctx, "Could not create thumbnail for %s.\n",
+                       d->filename);
+        }
+        remove_display(ctx, n);
+        mp_notify_property(mpctx, "thumbnail-pending");
+    }
+    // Done here, so that no thumbnail is dropped before it was shown.
+    pthread_mutex_lock(&ctx->lock);
+    trim_cache(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+    return true;
+}
+
+void thumbnail_uninit(struct MPContext *mpctx)
+{
+    struct thumbnail_ctx *ctx = mpctx->thumbnail_ctx;
+    if (!ctx)
+        return;
+
+    if (ctx->thread_valid) {
+        // Don't wait for a slow or stuck network open.
+        mp_cancel_trigger(ctx->cancel);
+        pthread_mutex_lock(&ctx->lock);
+        ctx->terminate = true;
+        pthread_cond_signal(&ctx->wakeup);
+        pthread_mutex_unlock(&ctx->lock);
+        pthread_join(ctx->thread, NULL);
+    }
+    while (ctx->num_thumbs)
+        remove_thumb(ctx, ctx->num_thumbs - 1);
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+    talloc_free(ctx);
+    mpctx->thumbnail_ctx = NULL;
+}
@@ -178,27 +178,39 @@ static void add_source(struct MPContext *mpctx, struct demuxer *d)
     MP_TARRAY_APPEND(NULL, mpctx->sources, mpctx->num_sources, d);
 }
 
-static bool try_open(struct MPContext *mpctx, char *filename)
+static bool can_open(struct MPContext *mpctx, char *filename)
 {
     struct bstr bfilename = bstr0(filename);
     // Avoid trying to open itself or another .cue file. Best would be
     // to check the result of demuxer auto-detection, but the demuxer
     // API doesn't allow this without opening a full demuxer.
-    if (bstr_case_endswith(bfilename, bstr0(".cue"))
-        || bstrcasecmp(bstr0(mpctx->demuxer->filename), bfilename) == 0)
-        return false;
+    return !bstr_case_endswith(bfilename, bstr0(".cue"))
+        && bstrcasecmp(bstr0(mpctx->demuxer->filename), bfilename) != 0;
+}
 
-    struct stream *s = stream_open(filename, mpctx->global);
-    if (!s)
+// If probed is set, opening the file with demuxer probing was already tried
+// and failed, so only the BIN fallback is tried.
+static bool try_open(struct MPContext *mpctx, char *filename, bool probed)
+{
+    struct bstr bfilename = bstr0(filename);
+    if (!can_open(mpctx, filename))
         return false;
-    struct demuxer *d = demux_open(s, NULL, NULL, mpctx->global);
+
     // Since .bin files are raw PCM data with no headers, we have to explicitly
     // open them. Also, try to avoid to open files that are most likely not .bin
     // files, as that would only play noise. Checking the file extension is
     // fragile, but it's about the only way we have.
     // TODO: maybe also could check if the .bin file is a multiple of the Audio
     //       CD sector size (2352 bytes)
-    if (!d && bstr_case_endswith(bfilename, bstr0(".bin"))) {
+    bool bin = bstr_case_endswith(bfilename, bstr0(".bin"));
+
+    struct stream *s = NULL;
+    struct demuxer *d = NULL;
+    if (!probed || bin)
+        s = stream_open(filename, mpctx->global);
+    if (s && !probed)
+        d = demux_open(s, NULL, NULL, mpctx->global);
+    if (s && !d && bin) {
         MP_WARN(mpctx, "CUE: Opening as BIN file!\n");
         d = demux_open(s, "rawaudio", NULL, mpctx->global);
     }
@@ -207,23 +219,37 @@ static bool try_open(struct MPContext *mpctx, char *filename)
         return true;
     }
     MP_ERR(mpctx, "Could not open source '%s'!\n", filename);
-    free_stream(s);
+    if (s)
+        free_stream(s);
     return false;
 }
 
-static bool open_source(struct MPContext *mpctx, struct bstr filename)
+// Return the path of the file referenced by the .cue file, or NULL if invalid.
+static char *source_path(void *talloc_ctx, struct MPContext *mpctx,
+                         struct bstr filename)
+{
+    struct bstr dirname = mp_dirname(mpctx->demuxer->filename);
+    struct bstr base_filename =
+        bstr0(mp_basename(bstrdup0(talloc_ctx, filename)));
+    if (!base_filename.len)
+        return NULL;
+    return mp_path_join(talloc_ctx, dirname, base_filename);
+}
+
+// probed: see try_open()
+static bool open_source(struct MPContext *mpctx, struct bstr filename,
+                        bool probed)
 {
     void *ctx = talloc_new(NULL);
     bool res = false;
 
     struct bstr dirname = mp_dirname(mpctx->demuxer->filename);
 
-    struct bstr base_filename = bstr0(mp_basename(bstrdup0(ctx, filename)));
-    if (!base_filename.len) {
+    char *fullname = source_path(ctx, mpctx, filename);
+    if (!fullname) {
         MP_WARN(mpctx, "CUE: Invalid audio filename in .cue file!\n");
     } else {
-        char *fullname = mp_path_join(ctx, dirname, base_filename);
-        if (try_open(mpctx, fullname)) {
+        if (try_open(mpctx, fullname, probed)) {
             res = true;
             goto out;
         }
@@ -245,10 +271,14 @@ static bool open_source(struct MPContext *mpctx, struct bstr filename)
         char *dename0 = de->d_name;
         struct bstr dename = bstr0(dename0);
         if (bstr_case_startswith(dename, cuefile)) {
+            char *path = mp_path_join(ctx, dirname, dename);
+            // Was tried above already.
+            if (fullname && strcmp(path, fullname) == 0)
+                continue;
             MP_WARN(mpctx, "CUE: No useful audio filename "
                     "in .cue file found, trying with '%s' instead!\n",
                     dename0);
-            if (try_open(mpctx, mp_path_join(ctx, dirname, dename))) {
+            if (try_open(mpctx, path, false)) {
                 res = true;
                 break;
             }
@@ -355,10 +385,30 @@ void build_cue_timeline(struct MPContext *mpctx)
         }
     }
 
+    // Open the files concurrently. Files which can't be opened this way go
+    // through open_source(), which also tries the fallbacks.
+    struct tl_open_request *reqs =
+        talloc_zero_array(ctx, struct tl_open_request, file_count);
     for (size_t i = 0; i < file_count; i++) {
-        if (!open_source(mpctx, files[i]))
-            goto out;
+        char *fullname = source_path(ctx, mpctx, files[i]);
+        if (fullname && can_open(mpctx, fullname))
+            reqs[i].filename = fullname;
+    }
+    tl_open_sources(mpctx, reqs, file_count);
+
+    // On failure, opened files are still added, so they are freed with the
+    // other sources.
+    bool ok = true;
+    for (size_t i = 0; i < file_count; i++) {
+        if (reqs[i].demuxer) {
+            add_source(mpctx, reqs[i].demuxer);
+            timeline_add_source(mpctx, &reqs[i], false);
+        } else if (ok) {
+            ok = open_source(mpctx, files[i], !!reqs[i].filename);
+        }
     }
+    if (!ok)
+        goto out;
 
     struct timeline_part *timeline = talloc_array_ptrtype(NULL, timeline,
                                                           track_count + 1);
@@ -115,41 +115,6 @@ static char **find_files(const char *original_file, const char *suffix)
     return results;
 }
 
-static int enable_cache(struct MPContext *mpctx, struct stream **stream,
-                        struct demuxer **demuxer, struct demuxer_params *params)
-{
-    struct MPOpts *opts = mpctx->opts;
-
-    if (opts->stream_cache_size <= 0)
-        return 0;
-
-    char *filename = talloc_strdup(NULL, (*demuxer)->filename);
-    free_demuxer(*demuxer);
-    free_stream(*stream);
-
-    *stream = stream_open(filename, mpctx->global);
-    if (!*stream) {
-        talloc_free(filename);
-        return -1;
-    }
-
-    stream_enable_cache_percent(stream,
-                                opts->stream_cache_size,
-                                opts->stream_cache_def_size,
-                                opts->stream_cache_min_percent,
-                                opts->stream_cache_seek_min_percent);
-
-    *demuxer = demux_open(*stream, "mkv", params, mpctx->global);
-    if (!*demuxer) {
-        talloc_free(filename);
-        free_stream(*stream);
-        return -1;
-    }
-
-    talloc_free(filename);
-    return 1;
-}
-
 static bool has_source_request(struct matroska_segment_uid *uids,
                                int num_sources,
                                struct matroska_segment_uid *new_uid)
@@ -162,80 +127,207 @@ static bool has_source_request(struct matroska_segment_uid *uids,
     return false;
 }
 
-// segment = get Nth segment of a multi-segment file
-static bool check_file_seg(struct MPContext *mpctx, struct demuxer ***sources,
-                           int *num_sources, struct matroska_segment_uid **uids,
-                           char *filename, int segment)
-{
-    bool was_valid = false;
-    struct demuxer_params params = {
-        .matroska_num_wanted_uids = *num_sources,
-        .matroska_wanted_uids = *uids,
-        .matroska_wanted_segment = segment,
-        .matroska_was_valid = &was_valid,
-    };
-    struct stream *s = stream_open(filename, mpctx->global);
-    if (!s)
-        return false;
-    struct demuxer *d = demux_open(s, "mkv", &params, mpctx->global);
-
-    if (!d) {
-        free_stream(s);
-        return was_valid;
-    }
-    if (d->type == DEMUXER_TYPE_MATROSKA) {
-        struct matroska_data *m = &d->matroska_data;
+// Segment UIDs of a candidate file. These are kept in mpctx->mkv_uid_cache,
+// so that playing the next file in the same directory doesn't need to read
+// the headers of all files again.
+struct uid_cache_file {
+    char *filename;
+    bool have_stat;
+    off_t size;
+    time_t mtime;
+    bool probed;
+    struct matroska_segment_uid *uids;  // indexed by segment number
+    int num_uids;
+};
 
-        for (int i = 1; i < *num_sources; i++) {
-            struct matroska_segment_uid *uid = *uids + i;
-            if ((*sources)[i])
-                continue;
-            /* Accept the source if the segment uid matches and the edition
-             * either matches or isn't specified. */
-            if (!memcmp(uid->segment, m->uid.segment, 16) &&
-                (!uid->edition || uid->edition == m->uid.edition)) {
-                MP_INFO(mpctx, "Match for source %d: %s\n",
-                       i, d->filename);
+struct mkv_uid_cache {
+    struct uid_cache_file *files;
+    int num_files;
+};
 
-                for (int j = 0; j < m->num_ordered_chapters; j++) {
-                    struct matroska_chapter *c = m->ordered_chapters + j;
+struct probe_ctx {
+    struct mpv_global *global;
+    struct mkv_uid_cache *old;
+    struct uid_cache_file *files;
+};
 
-                    if (!c->has_segment_uid)
-                        continue;
+// Runs on a worker thread; allocates only new talloc trees.
+static void probe_file(void *ctx, int n)
+{
+    struct probe_ctx *p = ctx;
+    struct uid_cache_file *f = &p->files[n];
+
+    struct stat statbuf;
+    if (stat(f->filename, &statbuf) == 0) {
+        f->have_stat = true;
+        f->size = statbuf.st_size;
+        f->mtime = statbuf.st_mtime;
+    }
 
-                    if (has_source_request(*uids, *num_sources, &c->uid))
-                        continue;
+    for (int i = 0; p->old && f->have_stat && i < p->old->num_files; i++) {
+        struct uid_cache_file *c = &p->old->files[i];
+        if (c->probed && c->have_stat && c->size == f->size &&
+            c->mtime == f->mtime && strcmp(c->filename, f->filename) == 0)
+        {
+            for (int s = 0; s < c->num_uids; s++)
+                MP_TARRAY_APPEND(NULL, f->uids, f->num_uids, c->uids[s]);
+            f->probed = true;
+            return;
+        }
+    }
 
-                    /* Set the requested segment. */
-                    MP_TARRAY_GROW(NULL, *uids, *num_sources);
-                    memcpy((*uids) + *num_sources, &c->uid, sizeof(c->uid));
+    for (int segment = 0; ; segment++) {
+        struct matroska_segment_uid uid = {{0}};
+        bool was_valid = false;
+        struct demuxer_params params = {
+            .matroska_wanted_segment = segment,
+            .matroska_was_valid = &was_valid,
+            .matroska_probe_uid = &uid,
+        };
+        struct stream *s = stream_open(f->filename, p->global);
+        if (!s)
+            break;
+        // Normally fails after reading the segment UID.
+        struct demuxer *d = demux_open(s, "mkv", &params, p->global);
+        free_demuxer(d);
+        free_stream(s);
+        if (!was_valid)
+            break;
+        MP_TARRAY_APPEND(NULL, f->uids, f->num_uids, uid);
+    }
+    f->probed = true;
+}
 
-                    /* Add a new source slot. */
-                    MP_TARRAY_APPEND(NULL, *sources, *num_sources, NULL);
-                }
+// Read the segment UIDs of all files concurrently, or reuse cached ones.
+static void probe_files(struct MPContext *mpctx, char **filenames,
+                        int num_filenames)
+{
+    struct mkv_uid_cache *old = mpctx->mkv_uid_cache;
+    struct mkv_uid_cache *cache = talloc_zero(mpctx, struct mkv_uid_cache);
+    cache->files = talloc_zero_array(cache, struct uid_cache_file,
+                                     num_filenames);
+    cache->num_files = num_filenames;
+    for (int n = 0; n < num_filenames; n++)
+        cache->files[n].filename = talloc_strdup(cache, filenames[n]);
+
+    MP_VERBOSE(mpctx, "Checking %d files.\n", num_filenames);
+    struct probe_ctx p = {
+        .global = mpctx->global,
+        .old = old,
+        .files = cache->files,
+    };
+    tl_run_parallel(probe_file, &p, num_filenames);
 
-                if (enable_cache(mpctx, &s, &d, &params) < 0)
-                    continue;
+    for (int n = 0; n < num_filenames; n++)
+        talloc_steal(cache, cache->files[n].uids);
+    // Only files from the last search are kept.
+    talloc_free(old);
+    mpctx->mkv_uid_cache = cache;
+}
 
-                (*sources)[i] = d;
+// Find the first file and segment with the given UID. Segment 0 of the first
+// file is the main file, and is skipped.
+static bool find_uid(struct mkv_uid_cache *cache,
+                     struct matroska_segment_uid *uid,
+                     char **out_filename, int *out_segment)
+{
+    for (int n = 0; cache && n < cache->num_files; n++) {
+        struct uid_cache_file *f = &cache->files[n];
+        for (int segment = n ? 0 : 1; segment < f->num_uids; segment++) {
+            if (!memcmp(uid->segment, f->uids[segment].segment, 16)) {
+                *out_filename = f->filename;
+                *out_segment = segment;
                 return true;
             }
         }
     }
-    free_demuxer(d);
-    free_stream(s);
-    return was_valid;
+    return false;
 }
 
-static void check_file(struct MPContext *mpctx, struct demuxer ***sources,
-                       int *num_sources, struct matroska_segment_uid **uids,
-                       char *filename, int first)
+// Open the sources for sources[first] up to sources[*num_sources - 1]. New
+// sources referenced by their ordered chapters are appended to the arrays.
+static void open_ordered_chapter_sources(struct MPContext *mpctx,
+                                         struct demuxer ***sources,
+                                         int *num_sources,
+                                         struct matroska_segment_uid **uids,
+                                         int first)
 {
-    for (int segment = first; ; segment++) {
-        if (!check_file_seg(mpctx, sources, num_sources,
-                            uids, filename, segment))
-            break;
+    struct MPOpts *opts = mpctx->opts;
+    void *tmp = talloc_new(NULL);
+    int num_wanted = *num_sources - first;
+    struct tl_open_request *reqs =
+        talloc_zero_array(tmp, struct tl_open_request, num_wanted);
+    struct demuxer_params *params =
+        talloc_zero_array(tmp, struct demuxer_params, num_wanted);
+    struct matroska_segment_uid *wanted_uids =
+        talloc_memdup(tmp, *uids + first, num_wanted * sizeof(**uids));
+    int *req_source = talloc_zero_array(tmp, int, num_wanted);
+    int num_reqs = 0;
+
+    for (int i = first; i < *num_sources; i++) {
+        char *filename;
+        int segment;
+        if ((*sources)[i] ||
+            !find_uid(mpctx->mkv_uid_cache, *uids + i, &filename, &segment))
+            continue;
+        params[num_reqs] = (struct demuxer_params) {
+            .matroska_num_wanted_uids = 1,
+            .matroska_wanted_uids = &wanted_uids[i - first],
+            .matroska_wanted_segment = segment,
+        };
+        reqs[num_reqs] = (struct tl_open_request) {
+            .filename = filename,
+            .demuxer_name = "mkv",
+            .params = &params[num_reqs],
+        };
+        req_source[num_reqs] = i;
+        num_reqs++;
     }
+
+    tl_open_sources(mpctx, reqs, num_reqs);
+
+    for (int r = 0; r < num_reqs; r++) {
+        struct demuxer *d = reqs[r].demuxer;
+        if (!d)
+            continue;
+        int i = req_source[r];
+        struct matroska_segment_uid *uid = *uids + i;
+        struct matroska_data *m = &d->matroska_data;
+        /* Accept the source if the segment uid matches and the edition
+         * either matches or isn't specified. */
+        if (d->type != DEMUXER_TYPE_MATROSKA ||
+            memcmp(uid->segment, m->uid.segment, 16) ||
+            (uid->edition && uid->edition != m->uid.edition))
+        {
+            struct stream *s = d->stream;
+            free_demuxer(d);
+            free_stream(s);
+            continue;
+        }
+        MP_INFO(mpctx, "Match for source %d: %s\n", i, d->filename);
+
+        for (int j = 0; j < m->num_ordered_chapters; j++) {
+            struct matroska_chapter *c = m->ordered_chapters + j;
+
+            if (!c->has_segment_uid)
+                continue;
+
+            if (has_source_request(*uids, *num_sources, &c->uid))
+                continue;
+
+            /* Set the requested segment. */
+            MP_TARRAY_GROW(NULL, *uids, *num_sources);
+            memcpy((*uids) + *num_sources, &c->uid, sizeof(c->uid));
+
+            /* Add a new source slot. */
+            MP_TARRAY_APPEND(NULL, *sources, *num_sources, NULL);
+        }
+
+        (*sources)[i] = d;
+        timeline_add_source(mpctx, &reqs[r], opts->stream_cache_size > 0);
+    }
+
+    talloc_free(tmp);
 }
 
 static bool missing(struct demuxer **sources, int num_sources)
@@ -260,6 +352,8 @@ static int find_ordered_chapter_sources(struct MPContext *mpctx,
         char *main_filename = mpctx->demuxer->filename;
         MP_INFO(mpctx, "This file references data from "
                "other sources.\n");
+        // Possibly get further segments appended to the first segment
+        MP_TARRAY_APPEND(tmp, filenames, num_filenames, main_filename);
         if (opts->ordered_chapters_files && opts->ordered_chapters_files[0]) {
             MP_INFO(mpctx, "Loading references from '%s'.\n",
                    opts->ordered_chapters_files);
@@ -274,25 +368,20 @@ static int find_ordered_chapter_sources(struct MPContext *mpctx,
         } else {
             MP_INFO(mpctx, "Will scan other files in the "
                    "same directory to find referenced sources.\n");
-            filenames = find_files(main_filename, ".mkv");
-            num_filenames = MP_TALLOC_ELEMS(filenames);
-            talloc_steal(tmp, filenames);
+            char **found = find_files(main_filename, ".mkv");
+            talloc_steal(tmp, found);
+            for (int i = 0; i < MP_TALLOC_ELEMS(found); i++)
+                MP_TARRAY_APPEND(tmp, filenames, num_filenames, found[i]);
         }
-        // Possibly get further segments appended to the first segment
-        check_file(mpctx, sources, num_sources, uids, main_filename, 1);
+        probe_files(mpctx, filenames, num_filenames);
     }
 
-    int old_source_count;
-    do {
-        old_source_count = *num_sources;
-        for (int i = 0; i < num_filenames; i++) {
-            if (!missing(*sources, *num_sources))
-                break;
-            MP_INFO(mpctx, "Checking file %s\n", filenames[i]);
-            check_file(mpctx, sources, num_sources, uids, filenames[i], 0);
-        }
     /* Loop while we have new sources to look for. */
-    } while (old_source_count != *num_sources);
+    for (int first = 1; first < *num_sources;) {
+        int old_source_count = *num_sources;
+        open_ordered_chapter_sources(mpctx, sources, num_sources, uids, first);
+        first = old_source_count;
+    }
 
     if (missing(*sources, *num_sources)) {
         MP_ERR(mpctx, "Failed to find ordered chapter part!\n"
@@ -119,69 +119,133 @@ error:
     return NULL;
 }
 
-static struct demuxer *open_file(char *filename, struct MPContext *mpctx)
+// Number of sources opened at the same time while building the timeline.
+// Each batch is closed (except the sources needed at the start of playback)
+// before the next one is opened, so that long EDL files don't run out of
+// file descriptors or memory.
+#define OPEN_BATCH_SIZE 16
+
+// What is needed from a source file to build the timeline.
+struct source_info {
+    char *filename;
+    bool opened;
+    int id;                     // registered timeline source
+    struct demuxer *demuxer;    // NULL if the source was closed again
+    double length;              // -1 if unknown
+    struct chapter *chapters;   // start is the source time
+    int num_chapters;
+};
+
+// return length of the source in seconds, or -1 if unknown
+static double source_get_length(struct demuxer *demuxer)
 {
-    struct MPOpts *opts = mpctx->opts;
-    struct demuxer *d = NULL;
-    struct stream *s = stream_open(filename, mpctx->global);
-    if (s) {
-        stream_enable_cache_percent(&s,
-                                    opts->stream_cache_size,
-                                    opts->stream_cache_def_size,
-                                    opts->stream_cache_min_percent,
-                                    opts->stream_cache_seek_min_percent);
-        d = demux_open(s, NULL, NULL, mpctx->global);
+    double time;
+    // <= 0 means DEMUXER_CTRL_NOTIMPL or DEMUXER_CTRL_DONTKNOW
+    if (demux_control(demuxer, DEMUXER_CTRL_GET_TIME_LENGTH, &time) <= 0)
+        time = -1;
+    return time;
+}
+
+static void read_source_info(void *ta_ctx, struct source_info *info,
+                             struct demuxer *d)
+{
+    info->length = source_get_length(d);
+    int count = demuxer_chapter_count(d);
+    for (int n = 0; n < count; n++) {
+        struct chapter ch = {
+            .start = demuxer_chapter_time(d, n),
+            .name = demuxer_chapter_name(d, n),
+        };
+        MP_TARRAY_APPEND(ta_ctx, info->chapters, info->num_chapters, ch);
+        talloc_steal(info->chapters, ch.name);
     }
-    if (!d) {
-        MP_ERR(mpctx, "EDL: Could not open source file '%s'.\n",
-               filename);
-        free_stream(s);
+}
+
+static struct source_info *find_source(struct source_info *infos, int num,
+                                       char *filename)
+{
+    for (int n = 0; n < num; n++) {
+        if (strcmp(infos[n].filename, filename) == 0)
+            return &infos[n];
     }
-    return d;
+    return NULL;
 }
 
-static struct demuxer *open_source(struct MPContext *mpctx, char *filename)
+// Open all sources in batches, which is much faster than opening them one by
+// one if there are many (or they are on network shares). Only the sources of
+// the first parts are kept open (with cache, as they're used for playback
+// right away); the others are reopened when needed.
+static struct source_info *open_sources(struct MPContext *mpctx,
+                                        struct tl_parts *parts, int *num_infos)
 {
-    for (int n = 0; n < mpctx->num_sources; n++) {
-        struct demuxer *d = mpctx->sources[n];
-        if (strcmp(d->stream->url, filename) == 0)
-            return d;
+    struct MPOpts *opts = mpctx->opts;
+    bool cache = opts->stream_cache_size > 0;
+    struct source_info *infos = NULL;
+    int num = 0;
+    for (int n = 0; n < parts->num_parts; n++) {
+        char *filename = parts->parts[n].filename;
+        if (!find_source(infos, num, filename)) {
+            struct source_info info = {.filename = filename};
+            MP_TARRAY_APPEND(NULL, infos, num, info);
+        }
     }
-    struct demuxer *d = open_file(filename, mpctx);
-    if (d)
-        MP_TARRAY_APPEND(NULL, mpctx->sources, mpctx->num_sources, d);
-    return d;
+    // Parts 0 and 1 are "near" the initial part; see timeline_init_sources().
+    struct source_info *keep[2] = {
+        find_source(infos, num, parts->parts[0].filename),
+        parts->num_parts > 1 ?
+            find_source(infos, num, parts->parts[1].filename) : NULL,
+    };
+
+    for (int start = 0; start < num; start += OPEN_BATCH_SIZE) {
+        struct tl_open_request reqs[OPEN_BATCH_SIZE];
+        int num_reqs = MPMIN(num - start, OPEN_BATCH_SIZE);
+        for (int i = 0; i < num_reqs; i++) {
+            struct source_info *info = &infos[start + i];
+            reqs[i] = (struct tl_open_request) {
+                .filename = info->filename,
+                .cache = cache && (info == keep[0] || info == keep[1]),
+            };
+        }
+        tl_open_sources(mpctx, reqs, num_reqs);
+        for (int i = 0; i < num_reqs; i++) {
+            struct source_info *info = &infos[start + i];
+            struct demuxer *d = reqs[i].demuxer;
+            if (!d)
+                continue;
+            read_source_info(infos, info, d);
+            MP_TARRAY_APPEND(NULL, mpctx->sources, mpctx->num_sources, d);
+            info->opened = true;
+            info->id = timeline_add_source(mpctx, &reqs[i], cache);
+            if (info == keep[0] || info == keep[1]) {
+                info->demuxer = d;
+                continue;
+            }
+            add_subtitle_fonts(mpctx, d);
+            timeline_close_source(mpctx, info->id);
+        }
+    }
+    *num_infos = num;
+    return infos;
 }
 
 // Append all chapters from src to the chapters array.
 // Ignore chapters outside of the given time range.
 static void copy_chapters(struct chapter **chapters, int *num_chapters,
-                          struct demuxer *src, double start, double len,
+                          struct source_info *src, double start, double len,
                           double dest_offset)
 {
-    int count = demuxer_chapter_count(src);
-    for (int n = 0; n < count; n++) {
-        double time = demuxer_chapter_time(src, n);
+    for (int n = 0; n < src->num_chapters; n++) {
+        double time = src->chapters[n].start;
         if (time >= start && time <= start + len) {
             struct chapter ch = {
                 .start = dest_offset + time,
-                .name = talloc_steal(*chapters, demuxer_chapter_name(src, n)),
+                .name = talloc_strdup(*chapters, src->chapters[n].name),
             };
             MP_TARRAY_APPEND(NULL, *chapters, *num_chapters, ch);
         }
     }
 }
 
-// return length of the source in seconds, or -1 if unknown
-static double source_get_length(struct demuxer *demuxer)
-{
-    double time;
-    // <= 0 means DEMUXER_CTRL_NOTIMPL or DEMUXER_CTRL_DONTKNOW
-    if (demux_control(demuxer, DEMUXER_CTRL_GET_TIME_LENGTH, &time) <= 0)
-        time = -1;
-    return time;
-}
-
 static void build_timeline(struct MPContext *mpctx, struct tl_parts *parts)
 {
     struct chapter *chapters = talloc_new(NULL);
@@ -189,13 +253,19 @@ static void build_timeline(struct MPContext *mpctx, struct tl_parts *parts)
     struct timeline_part *timeline = talloc_array_ptrtype(NULL, timeline,
                                                           parts->num_parts + 1);
     double starttime = 0;
+    int num_sources;
+    struct source_info *sources = open_sources(mpctx, parts, &num_sources);
     for (int n = 0; n < parts->num_parts; n++) {
         struct tl_part *part = &parts->parts[n];
-        struct demuxer *source = open_source(mpctx, part->filename);
-        if (!source)
+        struct source_info *source = find_source(sources, num_sources,
+                                                 part->filename);
+        if (!source->opened) {
+            MP_ERR(mpctx, "EDL: Could not open source file '%s'.\n",
+                   part->filename);
             goto error;
+        }
 
-        double len = source_get_length(source);
+        double len = source->length;
         if (len <= 0) {
             MP_WARN(mpctx, "EDL: source file '%s' has unknown duration.\n",
                    part->filename);
@@ -229,19 +299,25 @@ static void build_timeline(struct MPContext *mpctx, struct tl_parts *parts)
         timeline[n] = (struct timeline_part) {
             .start = starttime,
             .source_start = part->offset,
-            .source = source,
+            .source = source->demuxer,
+            .source_id = source->id,
         };
 
         starttime += part->length;
     }
-    timeline[parts->num_parts] = (struct timeline_part) {.start = starttime};
+    timeline[parts->num_parts] = (struct timeline_part) {
+        .start = starttime,
+        .source_id = -1,
+    };
     mpctx->timeline = timeline;
     mpctx->num_timeline_parts = parts->num_parts;
     mpctx->chapters = chapters;
     mpctx->num_chapters = num_chapters;
+    talloc_free(sources);
     return;
 
 error:
+    talloc_free(sources);
     talloc_free(timeline);
     talloc_free(chapters);
 }
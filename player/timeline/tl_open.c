@@ -0,0 +1,424 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Opening timeline sources concurrently. Most of the time is spent waiting
+ * for I/O (especially with network shares), so this uses more threads than
+ * there are CPUs.
+ */
+
+#include <pthread.h>
+#include <assert.h>
+
+#include "talloc.h"
+
+#include "player/core.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "compat/atomics.h"
+#include "options/options.h"
+#include "demux/demux.h"
+#include "stream/stream.h"
+
+#define MAX_OPEN_THREADS 8
+
+struct parallel_ctx {
+    void (*fn)(void *ctx, int n);
+    void *fn_ctx;
+    int num;
+    pthread_mutex_t lock;
+    int next;
+};
+
+static void *parallel_thread(void *arg)
+{
+    struct parallel_ctx *p = arg;
+    while (1) {
+        pthread_mutex_lock(&p->lock);
+        int n = p->next < p->num ? p->next++ : -1;
+        pthread_mutex_unlock(&p->lock);
+        if (n < 0)
+            break;
+        p->fn(p->fn_ctx, n);
+    }
+    return NULL;
+}
+
+// Call fn(ctx, n) for each n in [0, num), with up to MAX_OPEN_THREADS calls
+// running at the same time. Returns when all calls are done. fn must not
+// access the player core.
+void tl_run_parallel(void (*fn)(void *ctx, int n), void *ctx, int num)
+{
+    struct parallel_ctx p = {
+        .fn = fn,
+        .fn_ctx = ctx,
+        .num = num,
+    };
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_t threads[MAX_OPEN_THREADS];
+    int num_threads = 0;
+    if (num > 1) {
+        while (num_threads < MPMIN(num, MAX_OPEN_THREADS) - 1) {
+            if (pthread_create(&threads[num_threads], NULL, parallel_thread, &p))
+                break;
+            num_threads++;
+        }
+    }
+    // The calling thread works too (and does everything if there are no
+    // other threads).
+    parallel_thread(&p);
+    for (int n = 0; n < num_threads; n++)
+        pthread_join(threads[n], NULL);
+    pthread_mutex_destroy(&p.lock);
+}
+
+struct open_ctx {
+    struct mpv_global *global;
+    struct mp_cancel *cancel;       // can be NULL
+    struct tl_open_request *reqs;
+    // Copied from the options, as they are not thread-safe.
+    int cache_size, cache_def_size;
+    float cache_min_percent, cache_seek_min_percent;
+};
+
+static void open_request(void *ctx, int n)
+{
+    struct open_ctx *p = ctx;
+    struct tl_open_request *req = &p->reqs[n];
+    if (!req->filename)
+        return;
+
+    struct stream *s = stream_create(req->filename, STREAM_READ, p->cancel,
+                                     p->global);
+    if (!s)
+        return;
+    if (req->cache) {
+        stream_enable_cache_percent(&s, p->cache_size, p->cache_def_size,
+                                    p->cache_min_percent,
+                                    p->cache_seek_min_percent);
+    }
+    struct demuxer_params params = {0};
+    if (req->params)
+        params = *req->params;
+    params.matroska_was_valid = &req->was_valid;
+    req->demuxer = demux_open(s, req->demuxer_name, &params, p->global);
+    if (!req->demuxer)
+        free_stream(s);
+}
+
+// Open all requested sources concurrently. Each request gets its own stream
+// and demuxer; failed requests have demuxer set to NULL.
+void tl_open_sources(struct MPContext *mpctx, struct tl_open_request *reqs,
+                     int num_reqs)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct open_ctx p = {
+        .global = mpctx->global,
+        .reqs = reqs,
+        .cache_size = opts->stream_cache_size,
+        .cache_def_size = opts->stream_cache_def_size,
+        .cache_min_percent = opts->stream_cache_min_percent,
+        .cache_seek_min_percent = opts->stream_cache_seek_min_percent,
+    };
+    for (int n = 0; n < num_reqs; n++) {
+        reqs[n].demuxer = NULL;
+        reqs[n].was_valid = false;
+    }
+    if (num_reqs > 1)
+        MP_VERBOSE(mpctx, "Opening %d sources.\n", num_reqs);
+    tl_run_parallel(open_request, &p, num_reqs);
+}
+
+/*
+ * Timeline sources are opened while building the timeline (which needs their
+ * durations and chapters), but during playback only the sources around the
+ * current part are kept open. Other sources are closed, and reopened when
+ * their part is reached. The source of the next part is opened in the
+ * background shortly before the part boundary.
+ */
+
+// Time before the end of the current part when the next part's source is
+// opened in the background.
+#define PREFETCH_TIME 5.0
+
+struct timeline_source {
+    // req.demuxer is the open demuxer, or NULL if the source is closed.
+    // req.cache is set if the open demuxer uses the stream cache.
+    struct tl_open_request req;
+    struct demuxer_params params;
+    bool cache;                 // enable the cache when opening for playback
+};
+
+struct timeline_prefetch {
+    pthread_t thread;
+    int done;                   // set by the thread when it's about to exit
+    int source_id;
+    double seek_pts;            // source time of the part start
+    // The thread opens with a copy of the options (open.global), and can be
+    // aborted with open.cancel.
+    struct open_ctx open;
+    struct tl_open_request req;
+};
+
+// Register a source opened with tl_open_sources() (req->demuxer must be set),
+// so that it can be closed and reopened during playback. The demuxer must
+// also be added to mpctx->sources. Sources which are not registered are kept
+// open. Returns the source ID.
+int timeline_add_source(struct MPContext *mpctx, struct tl_open_request *req,
+                        bool cache)
+{
+    struct timeline_source *src = talloc_zero(mpctx, struct timeline_source);
+    src->req = (struct tl_open_request) {
+        .filename = talloc_strdup(src, req->filename),
+        .demuxer_name = talloc_strdup(src, req->demuxer_name),
+        .params = &src->params,
+        .cache = req->cache,
+        .demuxer = req->demuxer,
+    };
+    if (req->params) {
+        struct demuxer_params *p = req->params;
+        src->params = (struct demuxer_params) {
+            .matroska_num_wanted_uids = p->matroska_num_wanted_uids,
+            .matroska_wanted_uids = talloc_memdup(src, p->matroska_wanted_uids,
+                p->matroska_num_wanted_uids * sizeof(p->matroska_wanted_uids[0])),
+            .matroska_wanted_segment = p->matroska_wanted_segment,
+        };
+    }
+    src->cache = cache;
+    MP_TARRAY_APPEND(mpctx, mpctx->timeline_sources,
+                     mpctx->num_timeline_sources, src);
+    return mpctx->num_timeline_sources - 1;
+}
+
+static void set_source_demuxer(struct MPContext *mpctx, int id,
+                               struct demuxer *demuxer)
+{
+    mpctx->timeline_sources[id]->req.demuxer = demuxer;
+    if (!mpctx->timeline)
+        return;
+    for (int n = 0; n <= mpctx->num_timeline_parts; n++) {
+        if (mpctx->timeline[n].source_id == id)
+            mpctx->timeline[n].source = demuxer;
+    }
+}
+
+static void free_source_demuxer(struct MPContext *mpctx, struct demuxer *d)
+{
+    uninit_subs(d);
+    struct stream *stream = d->stream;
+    free_demuxer(d);
+    if (stream != mpctx->stream)
+        free_stream(stream);
+}
+
+// Close a registered source. Can also be used while building the timeline.
+void timeline_close_source(struct MPContext *mpctx, int id)
+{
+    struct demuxer *d = mpctx->timeline_sources[id]->req.demuxer;
+    if (!d || d == mpctx->demuxer)
+        return;
+    MP_VERBOSE(mpctx, "Closing timeline source %s\n", d->filename);
+    for (int n = 0; n < mpctx->num_sources; n++) {
+        if (mpctx->sources[n] == d) {
+            MP_TARRAY_REMOVE_AT(mpctx->sources, mpctx->num_sources, n);
+            break;
+        }
+    }
+    set_source_demuxer(mpctx, id, NULL);
+    free_source_demuxer(mpctx, d);
+}
+
+static void cancel_prefetch(struct MPContext *mpctx)
+{
+    struct timeline_prefetch *p = mpctx->timeline_prefetch;
+    if (!p)
+        return;
+    mp_cancel_trigger(p->open.cancel);
+    pthread_join(p->thread, NULL);
+    if (p->req.demuxer)
+        free_source_demuxer(mpctx, p->req.demuxer);
+    talloc_free(p);
+    mpctx->timeline_prefetch = NULL;
+}
+
+// Whether the source is used by the current, previous or next part.
+static bool source_is_near(struct MPContext *mpctx, int id)
+{
+    int cur = mpctx->timeline_part;
+    for (int n = MPMAX(cur - 1, 0);
+         n <= MPMIN(cur + 1, mpctx->num_timeline_parts - 1); n++)
+    {
+        if (mpctx->timeline[n].source_id == id)
+            return true;
+    }
+    return false;
+}
+
+// Close the sources not needed around the current part.
+void timeline_update_sources(struct MPContext *mpctx)
+{
+    if (mpctx->timeline_prefetch &&
+        !source_is_near(mpctx, mpctx->timeline_prefetch->source_id))
+        cancel_prefetch(mpctx);
+    for (int id = 0; id < mpctx->num_timeline_sources; id++) {
+        if (!source_is_near(mpctx, id))
+            timeline_close_source(mpctx, id);
+    }
+}
+
+// Call after the timeline was built. Parts with an open source are mapped to
+// their source ID here; parts whose source was already closed while building
+// the timeline must have source_id set by the builder.
+void timeline_init_sources(struct MPContext *mpctx)
+{
+    for (int n = 0; n <= mpctx->num_timeline_parts; n++) {
+        struct timeline_part *part = &mpctx->timeline[n];
+        if (part->source || n == mpctx->num_timeline_parts)
+            part->source_id = -1;
+        for (int id = 0; id < mpctx->num_timeline_sources; id++) {
+            if (part->source && part->source ==
+                                mpctx->timeline_sources[id]->req.demuxer)
+                part->source_id = id;
+        }
+    }
+    mpctx->timeline_part = 0;
+    int num_open = 0;
+    for (int id = 0; id < mpctx->num_timeline_sources; id++) {
+        struct timeline_source *src = mpctx->timeline_sources[id];
+        // Sources opened without cache while building the timeline are
+        // reopened with it when needed.
+        if (!source_is_near(mpctx, id) || (src->cache && !src->req.cache))
+            timeline_close_source(mpctx, id);
+        num_open += !!src->req.demuxer;
+    }
+    MP_VERBOSE(mpctx, "Keeping %d of %d timeline sources open.\n",
+               num_open, mpctx->num_timeline_sources);
+}
+
+// Make sure the source of the given timeline part is open. Returns false if
+// it could not be opened.
+bool timeline_open_part_source(struct MPContext *mpctx, int part)
+{
+    struct timeline_part *p = &mpctx->timeline[part];
+    if (p->source || p->source_id < 0)
+        return !!p->source;
+
+    struct timeline_source *src = mpctx->timeline_sources[p->source_id];
+    struct demuxer *d = NULL;
+    struct timeline_prefetch *pf = mpctx->timeline_prefetch;
+    if (pf && pf->source_id == p->source_id) {
+        // Wait for the prefetch, but let the user abort a slow open.
+        while (!mp_atomic_load_acquire(&pf->done)) {
+            if (stream_check_interrupt(NULL, 10)) {
+                cancel_prefetch(mpctx);
+                return false;
+            }
+        }
+        pthread_join(pf->thread, NULL);
+        d = pf->req.demuxer;
+        if (d) {
+            MP_VERBOSE(mpctx, "Using prefetched source %s\n", d->filename);
+            // The demuxer keeps using the option copy and the cancel handle.
+            talloc_steal(d->stream, pf->open.global);
+            talloc_steal(d->stream, pf->open.cancel);
+            pf->req.demuxer = NULL;
+        }
+        talloc_free(pf);
+        mpctx->timeline_prefetch = NULL;
+    }
+    if (!d) {
+        MP_VERBOSE(mpctx, "Opening timeline source %s\n", src->req.filename);
+        struct tl_open_request req = src->req;
+        req.cache = src->cache;
+        tl_open_sources(mpctx, &req, 1);
+        d = req.demuxer;
+    }
+    if (!d) {
+        MP_ERR(mpctx, "Could not open timeline source %s\n",
+               src->req.filename);
+        return false;
+    }
+    src->req.cache = src->cache;
+    MP_TARRAY_APPEND(NULL, mpctx->sources, mpctx->num_sources, d);
+    set_source_demuxer(mpctx, p->source_id, d);
+    return true;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct timeline_prefetch *p = arg;
+    open_request(&p->open, 0);
+    // Make the stream cache fill from the part start.
+    if (p->req.demuxer)
+        demux_seek(p->req.demuxer, p->seek_pts, SEEK_ABSOLUTE);
+    mp_atomic_store_release(&p->done, 1);
+    return NULL;
+}
+
+// Start opening the source of the next part if it's reached soon.
+void timeline_prefetch_next(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    if (!mpctx->timeline || mpctx->timeline_prefetch)
+        return;
+    int next = mpctx->timeline_part + 1;
+    if (next >= mpctx->num_timeline_parts)
+        return;
+    struct timeline_part *part = &mpctx->timeline[next];
+    if (part->source || part->source_id < 0)
+        return;
+    double pos = get_current_time(mpctx);
+    if (pos == MP_NOPTS_VALUE || part->start - pos > PREFETCH_TIME)
+        return;
+
+    struct timeline_source *src = mpctx->timeline_sources[part->source_id];
+    struct timeline_prefetch *p = talloc_zero(NULL, struct timeline_prefetch);
+    p->source_id = part->source_id;
+    p->seek_pts = part->source_start;
+    p->req = src->req;
+    p->req.cache = src->cache;
+    p->req.demuxer = NULL;
+    p->open = (struct open_ctx) {
+        // Playback continues while the thread runs, so it can't use the
+        // options directly.
+        .global = mp_copy_global(p, mpctx, false),
+        .cancel = mp_cancel_new(p),
+        .reqs = &p->req,
+        .cache_size = opts->stream_cache_size,
+        .cache_def_size = opts->stream_cache_def_size,
+        .cache_min_percent = opts->stream_cache_min_percent,
+        .cache_seek_min_percent = opts->stream_cache_seek_min_percent,
+    };
+    MP_VERBOSE(mpctx, "Prefetching timeline source %s\n", p->req.filename);
+    if (pthread_create(&p->thread, NULL, prefetch_thread, p)) {
+        talloc_free(p);
+        return;
+    }
+    mpctx->timeline_prefetch = p;
+}
+
+// Forget about the registered sources. Their demuxers are in mpctx->sources,
+// and freed with it.
+void timeline_uninit_sources(struct MPContext *mpctx)
+{
+    cancel_prefetch(mpctx);
+    for (int id = 0; id < mpctx->num_timeline_sources; id++)
+        talloc_free(mpctx->timeline_sources[id]);
+    talloc_free(mpctx->timeline_sources);
+    mpctx->timeline_sources = NULL;
+    mpctx->num_timeline_sources = 0;
+}
@@ -118,6 +118,8 @@ static void recreate_video_filters(struct MPContext *mpctx)
     struct dec_video *d_video = mpctx->d_video;
     assert(d_video);
 
+    video_cache_clear(mpctx);
+
     vf_destroy(d_video->vfilter);
     d_video->vfilter = vf_new(mpctx->global);
     d_video->vfilter->hwdec = &d_video->hwdec_info;
@@ -330,6 +332,155 @@ void video_execute_format_change(struct MPContext *mpctx)
         filter_video(mpctx, decoded_frame, true);
 }
 
+struct frame_cache_entry {
+    struct mp_image *image;
+    // pts of the frame the decoder returned after this one, or MP_NOPTS_VALUE
+    double next_pts;
+};
+
+static size_t image_size(struct mp_image *img)
+{
+    size_t size = 0;
+    for (int n = 0; n < img->num_planes; n++)
+        size += (size_t)abs(img->stride[n]) * img->plane_h[n];
+    return size;
+}
+
+static int find_cached_frame(struct MPContext *mpctx, double pts)
+{
+    for (int n = 0; n < mpctx->num_frame_cache; n++) {
+        if (mpctx->frame_cache[n].image->pts == pts)
+            return n;
+    }
+    return -1;
+}
+
+static void remove_cached_frame(struct MPContext *mpctx, int index)
+{
+    struct mp_image *img = mpctx->frame_cache[index].image;
+    mpctx->frame_cache_bytes -= image_size(img);
+    talloc_free(img);
+    MP_TARRAY_REMOVE_AT(mpctx->frame_cache, mpctx->num_frame_cache, index);
+}
+
+void video_cache_clear(struct MPContext *mpctx)
+{
+    while (mpctx->num_frame_cache)
+        remove_cached_frame(mpctx, mpctx->num_frame_cache - 1);
+    video_cache_reset(mpctx);
+}
+
+// Called when the decoder is reset. The cached frames stay valid.
+void video_cache_reset(struct MPContext *mpctx)
+{
+    mpctx->frame_cache_last_pts = MP_NOPTS_VALUE;
+    mpctx->frame_cache_active = false;
+}
+
+// Add a frame returned by the decoder (and filters), and link it to the frame
+// added before it.
+static void video_cache_add(struct MPContext *mpctx, struct mp_image *img)
+{
+    size_t max_size = (size_t)mpctx->opts->backstep_cache * 1024 * 1024;
+    double last_pts = mpctx->frame_cache_last_pts;
+    mpctx->frame_cache_last_pts = MP_NOPTS_VALUE;
+    if (!max_size || img->pts == MP_NOPTS_VALUE || mpctx->hrseek_framedrop)
+        return;
+    // Hardware decoded frames have no size in system memory, and keeping
+    // them would take surfaces away from the decoder's fixed-size pool.
+    if (IMGFMT_IS_HWACCEL(img->imgfmt)) {
+        video_cache_clear(mpctx);
+        return;
+    }
+
+    if (mpctx->num_frame_cache) {
+        struct mp_image_params p1, p2;
+        mp_image_params_from_image(&p1, mpctx->frame_cache[0].image);
+        mp_image_params_from_image(&p2, img);
+        if (!mp_image_params_equals(&p1, &p2))
+            video_cache_clear(mpctx);
+    }
+
+    int old = find_cached_frame(mpctx, img->pts);
+    if (old >= 0)
+        remove_cached_frame(mpctx, old);
+
+    int prev = last_pts < img->pts ? find_cached_frame(mpctx, last_pts) : -1;
+    if (prev >= 0)
+        mpctx->frame_cache[prev].next_pts = img->pts;
+
+    struct frame_cache_entry e = {
+        .image = mp_image_new_ref(img),
+        .next_pts = MP_NOPTS_VALUE,
+    };
+    MP_TARRAY_APPEND(mpctx, mpctx->frame_cache, mpctx->num_frame_cache, e);
+    mpctx->frame_cache_bytes += image_size(img);
+    mpctx->frame_cache_last_pts = img->pts;
+
+    while (mpctx->frame_cache_bytes > max_size && mpctx->num_frame_cache > 1)
+        remove_cached_frame(mpctx, 0);
+}
+
+// Return the cached frame that was decoded right before the frame with the
+// given pts, or NULL.
+struct mp_image *video_cache_get_prev(struct MPContext *mpctx, double pts)
+{
+    if (pts == MP_NOPTS_VALUE)
+        return NULL;
+    for (int n = 0; n < mpctx->num_frame_cache; n++) {
+        if (mpctx->frame_cache[n].next_pts == pts)
+            return mpctx->frame_cache[n].image;
+    }
+    return NULL;
+}
+
+// Return the cached frame a precise seek to pts would display, or NULL if it's
+// not known whether there is an uncached frame closer to pts.
+struct mp_image *video_cache_get_seek_target(struct MPContext *mpctx,
+                                             double pts)
+{
+    double target = pts - .005; // same tolerance as hr-seek
+    for (int n = 0; n < mpctx->num_frame_cache; n++) {
+        struct frame_cache_entry *e = &mpctx->frame_cache[n];
+        if (e->image->pts < target && e->next_pts != MP_NOPTS_VALUE &&
+            e->next_pts >= target)
+        {
+            int next = find_cached_frame(mpctx, e->next_pts);
+            return next >= 0 ? mpctx->frame_cache[next].image : NULL;
+        }
+    }
+    return NULL;
+}
+
+// While frames are shown from the cache, queue the frame following the one
+// shown last. Returns false if the decoder should be used instead.
+static bool video_cache_next_frame(struct MPContext *mpctx)
+{
+    if (!mpctx->frame_cache_active)
+        return false;
+
+    double pos = mpctx->frame_cache_pos;
+    int cur = find_cached_frame(mpctx, pos);
+    double next_pts = cur >= 0 ? mpctx->frame_cache[cur].next_pts
+                               : MP_NOPTS_VALUE;
+    int next = find_cached_frame(mpctx, next_pts);
+    // The audio decoder is not at the cached position, so continue normal
+    // playback with a real seek. (Frame stepping is fine.)
+    if (next < 0 || (!mpctx->paused && mpctx->step_frames < 1)) {
+        MP_VERBOSE(mpctx, "Leaving frame cache at %f.\n", pos);
+        mpctx->frame_cache_active = false;
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, pos, 2);
+        return true;
+    }
+
+    vo_queue_image(mpctx->video_out, mpctx->frame_cache[next].image);
+    mpctx->frame_cache_pos = next_pts;
+    // Reached the frame the decoder returned last; continue decoding.
+    if (next_pts == mpctx->frame_cache_last_pts)
+        mpctx->frame_cache_active = false;
+    return true;
+}
+
 static int check_framedrop(struct MPContext *mpctx, double frame_time)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -357,6 +508,20 @@ static int check_framedrop(struct MPContext *mpctx, double frame_time)
     return 0;
 }
 
+// Whether a decoded frame can be dropped without filtering it, because it's
+// before the target of the hr-seek in progress. Frames just before the
+// target are still filtered, for filters which look at previous frames
+// (such as deinterlacers). Backstepping needs all frames to go through.
+static bool hrseek_skip_frame(struct MPContext *mpctx, struct mp_image *frame)
+{
+    if (!mpctx->hrseek_active || mpctx->backstep_active ||
+        frame->pts == MP_NOPTS_VALUE || mpctx->d_video->waiting_decoded_mpi)
+        return false;
+    float fps = mpctx->d_video->fps;
+    double margin = fps > 0 ? 2.0 / fps : 0;
+    return frame->pts < mpctx->hrseek_pts - .005 - margin;
+}
+
 static double update_video_attached_pic(struct MPContext *mpctx)
 {
     struct dec_video *d_video = mpctx->d_video;
@@ -382,8 +547,12 @@ double update_video(struct MPContext *mpctx, double endpts)
     if (d_video->header->attached_picture)
         return update_video_attached_pic(mpctx);
 
+    bool from_cache = false;
     if (load_next_vo_frame(mpctx, false)) {
         // Use currently queued VO frame
+    } else if (video_cache_next_frame(mpctx)) {
+        // Use frame from --backstep-cache
+        from_cache = true;
     } else if (d_video->waiting_decoded_mpi) {
         // Draining on reconfig
         if (!load_next_vo_frame(mpctx, true))
@@ -403,7 +572,11 @@ double update_video(struct MPContext *mpctx, double endpts)
         struct mp_image *decoded_frame =
             video_decode(d_video, pkt, framedrop_type);
         talloc_free(pkt);
-        if (decoded_frame) {
+        if (decoded_frame && hrseek_skip_frame(mpctx, decoded_frame)) {
+            if (endpts == MP_NOPTS_VALUE || decoded_frame->pts < endpts)
+                add_frame_pts(mpctx, decoded_frame->pts);
+            talloc_free(decoded_frame);
+        } else if (decoded_frame) {
             filter_video(mpctx, decoded_frame, false);
         } else if (!pkt) {
             if (!load_next_vo_frame(mpctx, true))
@@ -419,6 +592,8 @@ double update_video(struct MPContext *mpctx, double endpts)
     double pts = video_out->next_pts;
     if (endpts == MP_NOPTS_VALUE || pts < endpts)
         add_frame_pts(mpctx, pts);
+    if (!from_cache && video_out->waiting_mpi)
+        video_cache_add(mpctx, video_out->waiting_mpi);
     if (mpctx->hrseek_active && pts < mpctx->hrseek_pts - .005) {
         vo_skip_frame(video_out);
         return 0;
@@ -39,6 +39,7 @@
 
 #include "common/common.h"
 #include "common/global.h"
+#include "compat/atomics.h"
 #include "bstr/bstr.h"
 #include "common/msg.h"
 #include "options/path.h"
@@ -264,8 +265,8 @@ static const char *match_proto(const char *url, const char *proto)
 }
 
 static int open_internal(const stream_info_t *sinfo, struct stream *underlying,
-                         const char *url, int flags, struct mpv_global *global,
-                         struct stream **ret)
+                         const char *url, int flags, struct mp_cancel *c,
+                         struct mpv_global *global, struct stream **ret)
 {
     if (sinfo->stream_filter != !!underlying)
         return STREAM_NO_MATCH;
@@ -290,6 +291,7 @@ static int open_internal(const stream_info_t *sinfo, struct stream *underlying,
     s->info = sinfo;
     s->opts = global->opts;
     s->global = global;
+    s->cancel = c;
     s->url = talloc_strdup(s, url);
     s->path = talloc_strdup(s, path);
     s->source = underlying;
@@ -341,7 +343,8 @@ static int open_internal(const stream_info_t *sinfo, struct stream *underlying,
     return STREAM_OK;
 }
 
-struct stream *stream_create(const char *url, int flags, struct mpv_global *global)
+struct stream *stream_create(const char *url, int flags,
+                             struct mp_cancel *c, struct mpv_global *global)
 {
     struct mp_log *log = mp_log_new(NULL, global->log, "!stream");
     struct stream *s = NULL;
@@ -349,7 +352,7 @@ struct stream *stream_create(const char *url, int flags, struct mpv_global *glob
 
     // Open stream proper
     for (int i = 0; stream_list[i]; i++) {
-        int r = open_internal(stream_list[i], NULL, url, flags, global, &s);
+        int r = open_internal(stream_list[i], NULL, url, flags, c, global, &s);
         if (r == STREAM_OK)
             break;
         if (r == STREAM_NO_MATCH || r == STREAM_UNSUPPORTED)
@@ -369,7 +372,8 @@ struct stream *stream_create(const char *url, int flags, struct mpv_global *glob
     for (;;) {
         struct stream *new = NULL;
         for (int i = 0; stream_list[i]; i++) {
-            int r = open_internal(stream_list[i], s, s->url, flags, global, &new);
+            int r = open_internal(stream_list[i], s, s->url, flags, c, global,
+                                  &new);
             if (r == STREAM_OK)
                 break;
         }
@@ -385,12 +389,12 @@ done:
 
 struct stream *stream_open(const char *filename, struct mpv_global *global)
 {
-    return stream_create(filename, STREAM_READ, global);
+    return stream_create(filename, STREAM_READ, NULL, global);
 }
 
 stream_t *open_output_stream(const char *filename, struct mpv_global *global)
 {
-    return stream_create(filename, STREAM_WRITE, global);
+    return stream_create(filename, STREAM_WRITE, NULL, global);
 }
 
 static int stream_reconnect(stream_t *s)
@@ -405,7 +409,7 @@ static int stream_reconnect(stream_t *s)
     for (int retry = 0; retry < MAX_RECONNECT_RETRIES; retry++) {
         MP_WARN(s, "Connection lost! Attempting to reconnect (%d)...\n", retry + 1);
 
-        if (stream_check_interrupt(retry ? RECONNECT_SLEEP_MS : 0))
+        if (stream_check_interrupt(s, retry ? RECONNECT_SLEEP_MS : 0))
             return 0;
 
         s->eof = 1;
@@ -461,6 +465,8 @@ static int stream_read_unbuffered(stream_t *s, void *buf, int len)
 {
     int orig_len = len;
     s->buf_pos = s->buf_len = 0;
+    if (mp_cancel_test(s->cancel))
+        goto eof_out;
     // we will retry even if we already reached EOF previously.
     len = s->fill_buffer ? s->fill_buffer(s, buf, len) : -1;
     if (len < 0)
@@ -760,8 +766,10 @@ void stream_set_interrupt_callback(int (*cb)(struct input_ctx *, int),
     stream_check_interrupt_ctx = ctx;
 }
 
-int stream_check_interrupt(int time)
+int stream_check_interrupt(stream_t *s, int time)
 {
+    if (s && mp_cancel_test(s->cancel))
+        return 1;
     if (!stream_check_interrupt_cb) {
         mp_sleep_us(time * 1000);
         return 0;
@@ -769,6 +777,27 @@ int stream_check_interrupt(int time)
     return stream_check_interrupt_cb(stream_check_interrupt_ctx, time);
 }
 
+struct mp_cancel {
+    int triggered;
+};
+
+struct mp_cancel *mp_cancel_new(void *talloc_ctx)
+{
+    return talloc_zero(talloc_ctx, struct mp_cancel);
+}
+
+// Can be called from any thread.
+void mp_cancel_trigger(struct mp_cancel *c)
+{
+    mp_atomic_store_release(&c->triggered, 1);
+}
+
+// c can be NULL (never triggered).
+bool mp_cancel_test(struct mp_cancel *c)
+{
+    return c && mp_atomic_load_acquire(&c->triggered);
+}
+
 stream_t *open_memory_stream(void *data, int len)
 {
     assert(len >= 0);
@@ -826,6 +855,7 @@ static int stream_enable_cache(stream_t **stream, int64_t size, int64_t min,
     cache->safe_origin = orig->safe_origin;
     cache->opts = orig->opts;
     cache->global = orig->global;
+    cache->cancel = orig->cancel;
     cache->start_pos = orig->start_pos;
     cache->end_pos = orig->end_pos;
 
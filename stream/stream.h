@@ -161,6 +161,7 @@ typedef struct stream {
     struct mp_log *log;
     struct MPOpts *opts;
     struct mpv_global *global;
+    struct mp_cancel *cancel; // aborts blocking operations if triggered
 
     FILE *capture_file;
     char *capture_filename;
@@ -245,7 +246,9 @@ struct bstr stream_read_complete(struct stream *s, void *talloc_ctx,
 int stream_control(stream_t *s, int cmd, void *arg);
 void stream_update_size(stream_t *s);
 void free_stream(stream_t *s);
-struct stream *stream_create(const char *url, int flags, struct mpv_global *global);
+struct mp_cancel;
+struct stream *stream_create(const char *url, int flags,
+                             struct mp_cancel *c, struct mpv_global *global);
 struct stream *stream_open(const char *filename, struct mpv_global *global);
 stream_t *open_output_stream(const char *filename, struct mpv_global *global);
 stream_t *open_memory_stream(void *data, int len);
@@ -257,8 +260,15 @@ struct input_ctx;
 void stream_set_interrupt_callback(int (*cb)(struct input_ctx *, int),
                                    struct input_ctx *ctx);
 /// Call the interrupt checking callback if there is one and
-/// wait for time milliseconds
-int stream_check_interrupt(int time);
+/// wait for time milliseconds. Also returns true if s (can be NULL) was
+/// opened with a mp_cancel that was triggered.
+int stream_check_interrupt(stream_t *s, int time);
+
+/// Allows another thread to abort opening and reading streams (used for
+/// opening files in the background).
+struct mp_cancel *mp_cancel_new(void *talloc_ctx);
+void mp_cancel_trigger(struct mp_cancel *c);
+bool mp_cancel_test(struct mp_cancel *c);
 
 bool stream_manages_timeline(stream_t *s);
 
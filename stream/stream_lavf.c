@@ -130,6 +130,12 @@ static bool mp_avio_has_opts(AVIOContext *avio)
 
 static const char * const prefix[] = { "lavf://", "ffmpeg://" };
 
+static int interrupt_cb(void *ctx)
+{
+    struct stream *stream = ctx;
+    return mp_cancel_test(stream->cancel);
+}
+
 static int open_f(stream_t *stream, int mode)
 {
     struct MPOpts *opts = stream->opts;
@@ -209,7 +215,12 @@ static int open_f(stream_t *stream, int mode)
         av_dict_set(&dict, "headers", cust_headers, 0);
     av_dict_set(&dict, "icy", "1", 0);
 
-    int err = avio_open2(&avio, filename, flags, NULL, &dict);
+    AVIOInterruptCB cb = {
+        .callback = interrupt_cb,
+        .opaque = stream,
+    };
+
+    int err = avio_open2(&avio, filename, flags, &cb, &dict);
     if (err < 0) {
         if (err == AVERROR_PROTOCOL_NOT_FOUND)
             MP_ERR(stream, "[ffmpeg] Protocol not found. Make sure"
@@ -97,7 +97,8 @@ static int rar_entry_open(stream_t *stream, int mode)
     mp_url_unescape_inplace(base);
 
     struct stream *rar =
-        stream_create(base, STREAM_READ | STREAM_NO_FILTERS, stream->global);
+        stream_create(base, STREAM_READ | STREAM_NO_FILTERS, stream->cancel,
+                      stream->global);
     if (!rar)
         return STREAM_ERROR;
 
@@ -127,6 +128,7 @@ static int rar_entry_open(stream_t *stream, int mode)
     file->current_chunk = &dummy;
     file->s = rar; // transfer ownership
     file->global = stream->global;
+    file->cancel = stream->cancel;
     RarSeek(file, 0);
 
     stream->priv = file;
@@ -150,20 +150,36 @@ void mp_ass_configure(ASS_Renderer *priv, struct MPOpts *opts,
     ass_set_line_spacing(priv, set_line_spacing);
 }
 
-void mp_ass_configure_fonts(ASS_Renderer *priv, struct osd_style_opts *opts,
-                            struct mpv_global *global, struct mp_log *log)
+// Find the user's fallback font and fontconfig config file. Both are set to
+// NULL if they don't exist.
+void mp_ass_find_fonts(void *talloc_ctx, struct mpv_global *global,
+                       char **default_font, char **config)
 {
-    void *tmp = talloc_new(NULL);
-    char *default_font = mp_find_user_config_file(tmp, global, "subfont.ttf");
-    char *config       = mp_find_config_file(tmp, global, "fonts.conf");
+    *default_font = mp_find_user_config_file(talloc_ctx, global, "subfont.ttf");
+    *config       = mp_find_config_file(talloc_ctx, global, "fonts.conf");
 
-    if (default_font && !mp_path_exists(default_font))
-        default_font = NULL;
+    if (*default_font && !mp_path_exists(*default_font)) {
+        talloc_free(*default_font);
+        *default_font = NULL;
+    }
+}
 
+void mp_ass_set_fonts(ASS_Renderer *priv, const char *family,
+                      const char *default_font, const char *config,
+                      struct mp_log *log)
+{
     mp_verbose(log, "Setting up fonts...\n");
-    ass_set_fonts(priv, default_font, opts->font, 1, config, 1);
+    ass_set_fonts(priv, default_font, family, 1, config, 1);
     mp_verbose(log, "Done.\n");
+}
 
+void mp_ass_configure_fonts(ASS_Renderer *priv, struct osd_style_opts *opts,
+                            struct mpv_global *global, struct mp_log *log)
+{
+    void *tmp = talloc_new(NULL);
+    char *default_font, *config;
+    mp_ass_find_fonts(tmp, global, &default_font, &config);
+    mp_ass_set_fonts(priv, opts->font, default_font, config, log);
     talloc_free(tmp);
 }
 
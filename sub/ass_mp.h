@@ -57,6 +57,11 @@ void mp_ass_configure(ASS_Renderer *priv, struct MPOpts *opts,
                       struct mp_osd_res *dim);
 void mp_ass_configure_fonts(ASS_Renderer *priv, struct osd_style_opts *opts,
                             struct mpv_global *global, struct mp_log *log);
+void mp_ass_find_fonts(void *talloc_ctx, struct mpv_global *global,
+                       char **default_font, char **config);
+void mp_ass_set_fonts(ASS_Renderer *priv, const char *family,
+                      const char *default_font, const char *config,
+                      struct mp_log *log);
 ASS_Library *mp_ass_init(struct mpv_global *global, struct mp_log *log);
 
 struct sub_bitmap;
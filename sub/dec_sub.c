@@ -78,6 +78,7 @@ struct dec_sub *sub_create(struct mpv_global *global)
     struct dec_sub *sub = talloc_zero(NULL, struct dec_sub);
     sub->log = mp_log_new(sub, global->log, "sub");
     sub->opts = global->opts;
+    sub->init_sd.global = global;
     return sub;
 }
 
@@ -134,6 +135,14 @@ void sub_set_ass_renderer(struct dec_sub *sub, struct ass_library *ass_library,
     sub->init_sd.ass_renderer = ass_renderer;
 }
 
+void sub_set_ass_fonts(struct dec_sub *sub, bool have_fonts,
+                       struct demux_attachment *fonts, int num_fonts)
+{
+    sub->init_sd.have_ass_fonts = have_fonts;
+    sub->init_sd.ass_fonts = fonts;
+    sub->init_sd.num_ass_fonts = num_fonts;
+}
+
 static void print_chain(struct dec_sub *sub)
 {
     MP_VERBOSE(sub, "Subtitle filter chain: ");
@@ -192,6 +201,7 @@ void sub_init_from_sh(struct dec_sub *sub, struct sh_stream *sh)
             return;
         }
         init_sd = (struct sd) {
+            .global = sub->init_sd.global,
             .codec = sd->output_codec,
             .converted_from = sd->codec,
             .extradata = sd->output_extradata,
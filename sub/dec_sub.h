@@ -12,6 +12,7 @@ struct mpv_global;
 struct demux_packet;
 struct ass_library;
 struct ass_renderer;
+struct demux_attachment;
 
 struct dec_sub;
 struct sd;
@@ -20,6 +21,8 @@ enum sd_ctrl {
     SD_CTRL_SUB_STEP,
     SD_CTRL_SET_VIDEO_PARAMS,
     SD_CTRL_GET_RESOLUTION,
+    // Hint that a video frame will be displayed soon (arg: double *pts)
+    SD_CTRL_RENDER_AHEAD,
 };
 
 struct dec_sub *sub_create(struct mpv_global *global);
@@ -30,6 +33,8 @@ void sub_set_video_fps(struct dec_sub *sub, double fps);
 void sub_set_extradata(struct dec_sub *sub, void *data, int data_len);
 void sub_set_ass_renderer(struct dec_sub *sub, struct ass_library *ass_library,
                           struct ass_renderer *ass_renderer);
+void sub_set_ass_fonts(struct dec_sub *sub, bool have_fonts,
+                       struct demux_attachment *fonts, int num_fonts);
 void sub_init_from_sh(struct dec_sub *sub, struct sh_stream *sh);
 
 bool sub_is_initialized(struct dec_sub *sub);
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <time.h>
 #include <assert.h>
 
 #include "osdep/io.h"
@@ -81,9 +82,118 @@ static struct bstr guess_lang_from_filename(struct bstr name)
     return (struct bstr){name.start + i + 1, n};
 }
 
+// Maximum number of directory listings kept in the cache.
+#define MAX_CACHED_DIRS 16
+
+struct dir_entry {
+    char *name;         // original file name
+    struct bstr key;    // lower case name without extension, stripped
+};
+
+// Subtitle files in a directory, sorted by key.
+struct dir_listing {
+    char *path;
+    time_t mtime;
+    bool racy;          // directory changed right before it was read
+    struct dir_entry *entries;
+    int num_entries;
+};
+
+struct mp_subfile_cache {
+    struct dir_listing **dirs;  // least recently used first
+    int num_dirs;
+};
+
+struct mp_subfile_cache *mp_subfile_cache_create(void *talloc_ctx)
+{
+    return talloc_zero(talloc_ctx, struct mp_subfile_cache);
+}
+
+static int compare_dir_entry(const void *a, const void *b)
+{
+    const struct dir_entry *e1 = a;
+    const struct dir_entry *e2 = b;
+    return bstrcmp(e1->key, e2->key);
+}
+
+static struct dir_listing *read_dir(void *talloc_ctx, struct mp_log *log,
+                                    const char *path)
+{
+    struct stat st;
+    if (mp_stat(path, &st) != 0)
+        return NULL;
+    DIR *d = opendir(path);
+    if (!d)
+        return NULL;
+    mp_verbose(log, "Load subtitles in %s\n", path);
+
+    struct dir_listing *dir = talloc_zero(talloc_ctx, struct dir_listing);
+    dir->path = talloc_strdup(dir, path);
+    dir->mtime = st.st_mtime;
+    // Entries added within the mtime granularity would go unnoticed, so
+    // don't trust the listing of a directory that was just modified.
+    dir->racy = st.st_mtime + 2 > time(NULL);
+
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct bstr dename = bstr0(de->d_name);
+        // does it end with a subtitle extension?
+        if (!is_sub_ext(get_ext(dename)))
+            continue;
+        struct dir_entry e = { .name = talloc_strdup(dir, de->d_name) };
+        struct bstr noext = bstrdup(dir, strip_ext(bstr0(e.name)));
+        bstr_lower(noext);
+        e.key = bstr_strip(noext);
+        MP_TARRAY_APPEND(dir, dir->entries, dir->num_entries, e);
+    }
+    closedir(d);
+
+    qsort(dir->entries, dir->num_entries, sizeof(dir->entries[0]),
+          compare_dir_entry);
+    return dir;
+}
+
+// Return the listing of the given directory, reading it only if it's not
+// cached, or if the directory was modified since it was read.
+static struct dir_listing *get_dir(struct mp_subfile_cache *cache,
+                                   void *tmpmem, struct mp_log *log,
+                                   const char *path)
+{
+    if (!cache)
+        return read_dir(tmpmem, log, path);
+
+    for (int n = 0; n < cache->num_dirs; n++) {
+        struct dir_listing *dir = cache->dirs[n];
+        if (strcmp(dir->path, path) != 0)
+            continue;
+        MP_TARRAY_REMOVE_AT(cache->dirs, cache->num_dirs, n);
+        struct stat st;
+        bool valid = !dir->racy && mp_stat(path, &st) == 0 &&
+                     st.st_mtime == dir->mtime;
+        if (valid) {
+            mp_dbg(log, "Using cached listing of %s\n", path);
+            MP_TARRAY_APPEND(cache, cache->dirs, cache->num_dirs, dir);
+            return dir;
+        }
+        talloc_free(dir);
+        break;
+    }
+
+    struct dir_listing *dir = read_dir(cache, log, path);
+    if (!dir)
+        return NULL;
+    if (cache->num_dirs >= MAX_CACHED_DIRS) {
+        talloc_free(cache->dirs[0]);
+        MP_TARRAY_REMOVE_AT(cache->dirs, cache->num_dirs, 0);
+    }
+    MP_TARRAY_APPEND(cache, cache->dirs, cache->num_dirs, dir);
+    return dir;
+}
+
 /**
  * @brief Append all the subtitles in the given path matching fname
  * @param opts MPlayer options
+ * @param cache directory listing cache (can be NULL)
  * @param slist pointer to the subtitles list tallocated
  * @param nsub pointer to the number of subtitles
  * @param path Look for subtitles in this directory
@@ -91,6 +201,7 @@ static struct bstr guess_lang_from_filename(struct bstr name)
  * @param limit_fuzziness Ignore flag when sub_fuziness == 2
  */
 static void append_dir_subtitles(struct mpv_global *global,
+                                 struct mp_subfile_cache *cache,
                                  struct subfn **slist, int *nsub,
                                  struct bstr path, const char *fname,
                                  int limit_fuzziness)
@@ -107,29 +218,36 @@ static void append_dir_subtitles(struct mpv_global *global,
     bstr_lower(f_fname_noext);
     struct bstr f_fname_trim = bstr_strip(f_fname_noext);
 
+    struct dir_listing *dir = get_dir(cache, tmpmem, log, bstrdup0(tmpmem, path));
+    if (!dir)
+        goto out;
+
+    // Without fuzzy matching, only files starting with the movie name can
+    // match. They form a contiguous range in the sorted listing.
+    int first = 0, last = dir->num_entries;
+    if (opts->sub_match_fuzziness < 1) {
+        int lo = 0, hi = dir->num_entries;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (bstrcmp(dir->entries[mid].key, f_fname_trim) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        first = last = lo;
+        while (last < dir->num_entries &&
+               bstr_startswith(dir->entries[last].key, f_fname_trim))
+            last++;
+    }
+
     // 0 = nothing
     // 1 = any subtitle file
     // 2 = any sub file containing movie name
     // 3 = sub file containing movie name and the lang extension
-    char *path0 = bstrdup0(tmpmem, path);
-    DIR *d = opendir(path0);
-    if (!d)
-        goto out;
-    mp_verbose(log, "Load subtitles in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
-        struct bstr dename = bstr0(de->d_name);
-        void *tmpmem2 = talloc_new(tmpmem);
-
-        // retrieve various parts of the filename
-        struct bstr tmp_fname_noext = bstrdup(tmpmem2, strip_ext(dename));
-        bstr_lower(tmp_fname_noext);
-        struct bstr tmp_fname_ext = get_ext(dename);
-        struct bstr tmp_fname_trim = bstr_strip(tmp_fname_noext);
-
-        // does it end with a subtitle extension?
-        if (!is_sub_ext(tmp_fname_ext))
-            goto next_sub;
+    for (int i = first; i < last; i++) {
+        struct dir_entry *e = &dir->entries[i];
+        struct bstr tmp_fname_trim = e->key;
 
         // we have a (likely) subtitle file
         int prio = 0;
@@ -161,10 +279,10 @@ static void append_dir_subtitles(struct mpv_global *global,
             }
         }
 
-        mp_dbg(log, "Potential sub file: \"%s\"  Priority: %d\n", de->d_name, prio);
+        mp_dbg(log, "Potential sub file: \"%s\"  Priority: %d\n", e->name, prio);
         if (prio) {
             prio += prio;
-            char *subpath = mp_path_join(*slist, path, dename);
+            char *subpath = mp_path_join(*slist, path, bstr0(e->name));
             if (mp_path_exists(subpath)) {
                 MP_GROW_ARRAY(*slist, *nsub);
                 struct subfn *sub = *slist + (*nsub)++;
@@ -179,11 +297,7 @@ static void append_dir_subtitles(struct mpv_global *global,
             } else
                 talloc_free(subpath);
         }
-
-    next_sub:
-        talloc_free(tmpmem2);
     }
-    closedir(d);
 
  out:
     talloc_free(tmpmem);
@@ -218,28 +332,35 @@ static void filter_subidx(struct subfn **slist, int *nsub)
 
 // Return a list of subtitles found, sorted by priority.
 // Last element is terminated with a fname==NULL entry.
-struct subfn *find_text_subtitles(struct mpv_global *global, const char *fname)
+// If cache is not NULL, directory listings are kept in it and reused by later
+// calls, as long as the directories are not modified.
+struct subfn *find_text_subtitles(struct mpv_global *global,
+                                  struct mp_subfile_cache *cache,
+                                  const char *fname)
 {
     struct MPOpts *opts = global->opts;
     struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
     int n = 0;
 
     // Load subtitles from current media directory
-    append_dir_subtitles(global, &slist, &n, mp_dirname(fname), fname, 0);
+    append_dir_subtitles(global, cache, &slist, &n, mp_dirname(fname),
+                         fname, 0);
 
     // Load subtitles in dirs specified by sub-paths option
     if (opts->sub_paths) {
         for (int i = 0; opts->sub_paths[i]; i++) {
             char *path = mp_path_join(slist, mp_dirname(fname),
                                       bstr0(opts->sub_paths[i]));
-            append_dir_subtitles(global, &slist, &n, bstr0(path), fname, 0);
+            append_dir_subtitles(global, cache, &slist, &n, bstr0(path),
+                                 fname, 0);
         }
     }
 
     // Load subtitles in ~/.mpv/sub limiting sub fuzziness
     char *mp_subdir = mp_find_user_config_file(NULL, global, "sub/");
     if (mp_subdir)
-        append_dir_subtitles(global, &slist, &n, bstr0(mp_subdir), fname, 1);
+        append_dir_subtitles(global, cache, &slist, &n, bstr0(mp_subdir),
+                             fname, 1);
     talloc_free(mp_subdir);
 
     // Sort by name for filter_subidx()
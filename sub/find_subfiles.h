@@ -26,6 +26,12 @@ struct subfn {
 };
 
 struct mpv_global;
-struct subfn *find_text_subtitles(struct mpv_global *global, const char *fname);
+struct mp_subfile_cache;
+
+struct mp_subfile_cache *mp_subfile_cache_create(void *talloc_ctx);
+
+struct subfn *find_text_subtitles(struct mpv_global *global,
+                                  struct mp_subfile_cache *cache,
+                                  const char *fname);
 
 #endif /* MPLAYER_FINDFILES_H */
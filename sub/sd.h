@@ -5,6 +5,7 @@
 #include "demux/packet.h"
 
 struct sd {
+    struct mpv_global *global;
     struct mp_log *log;
     struct MPOpts *opts;
 
@@ -31,6 +32,11 @@ struct sd {
     // Shared renderer for ASS - done to avoid reloading embedded fonts.
     struct ass_library *ass_library;
     struct ass_renderer *ass_renderer;
+    // Fonts added to ass_library, for sd_ass' render-ahead thread, which
+    // uses its own library. Only set if have_ass_fonts is true.
+    bool have_ass_fonts;
+    struct demux_attachment *ass_fonts;
+    int num_ass_fonts;
 
     // If false, try to remove multiple subtitles.
     // (Only for decoders which have accept_packets_in_advance set.)
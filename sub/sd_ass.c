@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include <libavutil/common.h>
 #include <ass/ass.h>
@@ -28,12 +30,36 @@
 #include "options/options.h"
 #include "common/common.h"
 #include "common/msg.h"
+#include "demux/demux.h"
 #include "video/csputils.h"
 #include "video/mp_image.h"
 #include "dec_sub.h"
 #include "ass_mp.h"
 #include "sd.h"
 
+// Number of frames the render-ahead thread keeps around.
+#define MAX_RENDERED_FRAMES 4
+// Number of frame times waiting to be rendered.
+#define MAX_RENDER_REQUESTS 2
+
+// Everything that determines the libass output, except the track and time.
+struct render_params {
+    struct mp_osd_res dim;
+    double scale;
+    int storage_w, storage_h;
+    int style_override, use_margins, sub_pos, hinting, shaper;
+    float line_spacing, sub_scale;
+};
+
+// A deep copy of a libass render result.
+struct rendered_frame {
+    void *data;         // talloc parent of parts and bitmaps; NULL if unused
+    long long time;
+    struct render_params params;
+    struct sub_bitmap *parts;
+    int num_parts;
+};
+
 struct sd_ass_priv {
     struct ass_track *ass_track;
     bool is_converted;
@@ -42,6 +68,45 @@ struct sd_ass_priv {
     char last_text[500];
     struct mp_image_params video_params;
     struct mp_image_params last_params;
+
+    // Pre-rendered frame returned by the last get_bitmaps() call, if any.
+    // Accessed by the main thread only.
+    struct rendered_frame shown;
+
+    // --ass-render-ahead
+    // While the worker runs, it renders all frames (see render_now()), so
+    // that the state libass keeps per track (such as the positions of
+    // colliding lines) is the same as with a single renderer.
+    bool worker_running, worker_failed;
+    pthread_t worker;
+    // Set up by the main thread before starting the worker, and then owned
+    // by it. The worker renders a copy of ass_track (worker_track) with its
+    // own library, so that it never uses libass state of the main thread.
+    ASS_Library *worker_library;
+    ASS_Track *worker_track;
+    char *worker_font, *worker_default_font, *worker_fonts_conf;
+    // Held while the main thread changes or renders ass_track (rendering can
+    // change it too), and while the worker copies it. If both are needed,
+    // lock this one first.
+    pthread_mutex_t track_lock;
+    bool resync_track;              // worker_track must be copied completely
+    // Protects the fields below.
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;          // signaled to the worker
+    pthread_cond_t done;            // signaled when urgent is cleared
+    bool worker_quit;
+    bool renderer_failed;           // the worker can't render anything
+    int track_gen;                  // incremented on each ass_track change
+    bool urgent;                    // render urgent_time before the requests
+    long long urgent_time;
+    struct rendered_frame urgent_frame;
+    bool have_params;
+    struct render_params params;    // as used by the last get_bitmaps() call
+    long long last_time;            // time of the last get_bitmaps() call
+    long long requests[MAX_RENDER_REQUESTS];
+    int num_requests;
+    struct rendered_frame frames[MAX_RENDERED_FRAMES];
+    int next_frame;                 // slot to replace if all are in use
 };
 
 static void mangle_colors(struct sd *sd, struct sub_bitmaps *parts);
@@ -65,6 +130,11 @@ static int init(struct sd *sd)
     struct sd_ass_priv *ctx = talloc_zero(NULL, struct sd_ass_priv);
     sd->priv = ctx;
 
+    pthread_mutex_init(&ctx->track_lock, NULL);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wakeup, NULL);
+    pthread_cond_init(&ctx->done, NULL);
+
     ctx->is_converted = sd->converted_from != NULL;
 
     if (sd->ass_track) {
@@ -85,7 +155,49 @@ static int init(struct sd *sd)
     return 0;
 }
 
-static void decode(struct sd *sd, struct demux_packet *packet)
+static void free_frame(struct rendered_frame *f)
+{
+    talloc_free(f->data);
+    *f = (struct rendered_frame){0};
+}
+
+static bool params_equal(struct render_params *a, struct render_params *b)
+{
+    return a->dim.w == b->dim.w && a->dim.h == b->dim.h &&
+           a->dim.mt == b->dim.mt && a->dim.mb == b->dim.mb &&
+           a->dim.ml == b->dim.ml && a->dim.mr == b->dim.mr &&
+           a->dim.display_par == b->dim.display_par &&
+           a->scale == b->scale &&
+           a->storage_w == b->storage_w && a->storage_h == b->storage_h &&
+           a->style_override == b->style_override &&
+           a->use_margins == b->use_margins && a->sub_pos == b->sub_pos &&
+           a->hinting == b->hinting && a->shaper == b->shaper &&
+           a->line_spacing == b->line_spacing && a->sub_scale == b->sub_scale;
+}
+
+static bool frame_matches(struct rendered_frame *f, long long time,
+                          struct render_params *params)
+{
+    return f->data && f->time == time && params_equal(&f->params, params);
+}
+
+// Forget pre-rendered frames with start <= time < end, e.g. because events
+// visible in this range were added. Caller must hold ctx->track_lock.
+static void drop_frames(struct sd_ass_priv *ctx, long long start, long long end)
+{
+    if (ctx->shown.data && ctx->shown.time >= start && ctx->shown.time < end)
+        free_frame(&ctx->shown);
+    pthread_mutex_lock(&ctx->lock);
+    ctx->track_gen++;
+    for (int n = 0; n < MAX_RENDERED_FRAMES; n++) {
+        struct rendered_frame *f = &ctx->frames[n];
+        if (f->data && f->time >= start && f->time < end)
+            free_frame(f);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void decode_packet(struct sd *sd, struct demux_packet *packet)
 {
     struct sd_ass_priv *ctx = sd->priv;
     ASS_Track *track = ctx->ass_track;
@@ -127,39 +239,484 @@ static void decode(struct sd *sd, struct demux_packet *packet)
     event->Text = strdup(text);
 }
 
-static void get_bitmaps(struct sd *sd, struct mp_osd_res dim, double pts,
-                        struct sub_bitmaps *res)
+static void decode(struct sd *sd, struct demux_packet *packet)
 {
     struct sd_ass_priv *ctx = sd->priv;
-    struct MPOpts *opts = sd->opts;
 
-    if (pts == MP_NOPTS_VALUE || !sd->ass_renderer)
-        return;
+    pthread_mutex_lock(&ctx->track_lock);
+    decode_packet(sd, packet);
+    // Other frames are unaffected, unless the packet timing is unknown.
+    long long start = LLONG_MIN, end = LLONG_MAX;
+    if (strcmp(sd->codec, "ssa") != 0 && packet->pts != MP_NOPTS_VALUE &&
+        packet->duration >= 0)
+    {
+        start = packet->pts * 1000 + 0.5;
+        end = start + (long long)(packet->duration * 1000 + 0.5);
+    }
+    drop_frames(ctx, start, end);
+    pthread_mutex_unlock(&ctx->track_lock);
+}
+
+static void get_render_params(struct sd *sd, struct mp_osd_res dim,
+                              struct render_params *p)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    struct MPOpts *opts = sd->opts;
 
-    ASS_Renderer *renderer = sd->ass_renderer;
-    double scale = dim.display_par;
+    *p = (struct render_params) {
+        .dim = dim,
+        .scale = dim.display_par,
+        .style_override = opts->ass_style_override,
+        .use_margins = opts->ass_use_margins,
+        .sub_pos = opts->sub_pos,
+        .hinting = opts->ass_hinting,
+        .shaper = opts->ass_shaper,
+        .line_spacing = opts->ass_line_spacing,
+        .sub_scale = opts->sub_scale,
+    };
     if (!ctx->is_converted && (!opts->ass_style_override ||
                                opts->ass_vsfilter_aspect_compat))
     {
         // Let's use the original video PAR for vsfilter compatibility:
-        scale = scale
+        p->scale = p->scale
             * (ctx->video_params.d_w / (double)ctx->video_params.d_h)
             / (ctx->video_params.w   / (double)ctx->video_params.h);
     }
-    mp_ass_configure(renderer, opts, &dim);
-    ass_set_aspect_ratio(renderer, scale, 1);
-#if LIBASS_VERSION >= 0x01020000
     if (!ctx->is_converted && (!opts->ass_style_override ||
                                opts->ass_vsfilter_blur_compat))
     {
-        ass_set_storage_size(renderer, ctx->video_params.w, ctx->video_params.h);
-    } else {
-        ass_set_storage_size(renderer, 0, 0);
+        p->storage_w = ctx->video_params.w;
+        p->storage_h = ctx->video_params.h;
     }
+}
+
+static void configure_renderer(ASS_Renderer *renderer, struct render_params *p)
+{
+    // mp_ass_configure() reads only these fields.
+    struct MPOpts opts = {
+        .ass_style_override = p->style_override,
+        .ass_use_margins = p->use_margins,
+        .sub_pos = p->sub_pos,
+        .ass_hinting = p->hinting,
+        .ass_shaper = p->shaper,
+        .ass_line_spacing = p->line_spacing,
+        .sub_scale = p->sub_scale,
+    };
+    mp_ass_configure(renderer, &opts, &p->dim);
+    ass_set_aspect_ratio(renderer, p->scale, 1);
+#if LIBASS_VERSION >= 0x01020000
+    ass_set_storage_size(renderer, p->storage_w, p->storage_h);
 #endif
-    mp_ass_render_frame(renderer, ctx->ass_track, pts * 1000 + .5,
-                        &ctx->parts, res);
-    talloc_steal(ctx, ctx->parts);
+}
+
+// The ASS_Image list is owned by the renderer, and is overwritten by the next
+// ass_render_frame() call, so copy it.
+static void copy_images(struct rendered_frame *f, ASS_Image *imgs)
+{
+    f->data = talloc_new(NULL);
+    for (struct ass_image *img = imgs; img; img = img->next) {
+        if (img->w == 0 || img->h == 0)
+            continue;
+        struct sub_bitmap p = {
+            .bitmap = talloc_size(f->data, img->stride * img->h),
+            .stride = img->stride,
+            .libass.color = img->color,
+            .w = img->w, .dw = img->w,
+            .h = img->h, .dh = img->h,
+            .x = img->dst_x,
+            .y = img->dst_y,
+        };
+        memcpy(p.bitmap, img->bitmap, img->stride * (img->h - 1) + img->w);
+        MP_TARRAY_APPEND(f->data, f->parts, f->num_parts, p);
+    }
+}
+
+// Return what changed between a and b, with the same meaning as the libass
+// detect_change parameter: 0 nothing, 1 positions only, 2 content.
+static int compare_frames(struct rendered_frame *a, struct rendered_frame *b)
+{
+    if (a->num_parts != b->num_parts)
+        return 2;
+    int change = 0;
+    for (int n = 0; n < a->num_parts; n++) {
+        struct sub_bitmap *pa = &a->parts[n], *pb = &b->parts[n];
+        if (pa->w != pb->w || pa->h != pb->h ||
+            pa->libass.color != pb->libass.color)
+            return 2;
+        for (int y = 0; y < pa->h; y++) {
+            if (memcmp((char *)pa->bitmap + y * pa->stride,
+                       (char *)pb->bitmap + y * pb->stride, pa->w) != 0)
+                return 2;
+        }
+        if (pa->x != pb->x || pa->y != pb->y)
+            change = 1;
+    }
+    return change;
+}
+
+// Caller must hold ctx->lock.
+static int find_frame(struct sd_ass_priv *ctx, long long time,
+                      struct render_params *params)
+{
+    for (int n = 0; n < MAX_RENDERED_FRAMES; n++) {
+        if (frame_matches(&ctx->frames[n], time, params))
+            return n;
+    }
+    return -1;
+}
+
+static char *copy_str(const char *s)
+{
+    return s ? strdup(s) : NULL;
+}
+
+// Copy everything the renderer uses from src to dst, except the events.
+static void copy_track_header(ASS_Track *dst, ASS_Track *src)
+{
+    dst->track_type = src->track_type;
+    dst->PlayResX = src->PlayResX;
+    dst->PlayResY = src->PlayResY;
+    dst->Timer = src->Timer;
+    dst->WrapStyle = src->WrapStyle;
+    dst->ScaledBorderAndShadow = src->ScaledBorderAndShadow;
+    dst->Kerning = src->Kerning;
+    dst->default_style = src->default_style;
+    for (int n = dst->n_styles; n < src->n_styles; n++) {
+        int sid = ass_alloc_style(dst);
+        ASS_Style *style = &dst->styles[sid];
+        *style = src->styles[n];
+        style->Name = copy_str(src->styles[n].Name);
+        style->FontName = copy_str(src->styles[n].FontName);
+    }
+}
+
+// Bring the worker's copy of the track up to date. Since events are only
+// appended to the track (or everything is flushed, which sets resync_track),
+// only the new events need to be copied. Caller must hold ctx->track_lock.
+static void sync_worker_track(struct sd_ass_priv *ctx)
+{
+    ASS_Track *src = ctx->ass_track;
+    ASS_Track *dst = ctx->worker_track;
+    if (ctx->resync_track || dst->n_styles > src->n_styles ||
+        dst->n_events > src->n_events)
+    {
+        dst = ass_new_track(ctx->worker_library);
+        ass_free_track(ctx->worker_track);
+        ctx->worker_track = dst;
+        ctx->resync_track = false;
+    }
+    copy_track_header(dst, src);
+    for (int n = dst->n_events; n < src->n_events; n++) {
+        int eid = ass_alloc_event(dst);
+        ASS_Event *event = &dst->events[eid];
+        *event = src->events[n];
+        event->Name = copy_str(src->events[n].Name);
+        event->Effect = copy_str(src->events[n].Effect);
+        event->Text = copy_str(src->events[n].Text);
+        event->render_priv = NULL;
+    }
+}
+
+static void *render_thread(void *arg)
+{
+    struct sd *sd = arg;
+    struct sd_ass_priv *ctx = sd->priv;
+
+    // Setting up fonts can take a while, so do it here.
+    ASS_Renderer *renderer = ass_renderer_init(ctx->worker_library);
+    if (renderer) {
+        mp_ass_set_fonts(renderer, ctx->worker_font, ctx->worker_default_font,
+                         ctx->worker_fonts_conf, sd->log);
+    }
+
+    int synced_gen = -1;
+    pthread_mutex_lock(&ctx->lock);
+    if (!renderer) {
+        ctx->renderer_failed = true;
+        pthread_cond_broadcast(&ctx->done);
+    }
+    while (!ctx->worker_quit) {
+        if (!renderer || !(ctx->urgent || ctx->num_requests)) {
+            pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+            continue;
+        }
+        bool urgent = ctx->urgent;
+        long long time;
+        if (urgent) {
+            time = ctx->urgent_time;
+        } else {
+            time = ctx->requests[0];
+            ctx->num_requests--;
+            memmove(&ctx->requests[0], &ctx->requests[1],
+                    ctx->num_requests * sizeof(ctx->requests[0]));
+        }
+        struct render_params params = ctx->params;
+        if (!urgent && find_frame(ctx, time, &params) >= 0)
+            continue;
+        int gen = ctx->track_gen;
+        pthread_mutex_unlock(&ctx->lock);
+
+        // The track lock is held only while copying, never while rendering.
+        if (gen != synced_gen) {
+            pthread_mutex_lock(&ctx->track_lock);
+            sync_worker_track(ctx);
+            pthread_mutex_unlock(&ctx->track_lock);
+            synced_gen = gen;
+        }
+
+        configure_renderer(renderer, &params);
+        int changed;
+        ASS_Image *imgs = ass_render_frame(renderer, ctx->worker_track, time,
+                                           &changed);
+        struct rendered_frame f = {.time = time, .params = params};
+        copy_images(&f, imgs);
+
+        pthread_mutex_lock(&ctx->lock);
+        // If the track changed in the meantime, the frame might be outdated,
+        // and drop_frames() couldn't remove it, because it wasn't added yet.
+        if (ctx->track_gen != gen) {
+            free_frame(&f);
+            continue;
+        }
+        if (urgent) {
+            free_frame(&ctx->urgent_frame);
+            ctx->urgent_frame = f;
+            ctx->urgent = false;
+            pthread_cond_broadcast(&ctx->done);
+            continue;
+        }
+        int slot = -1;
+        for (int n = 0; n < MAX_RENDERED_FRAMES; n++) {
+            if (!ctx->frames[n].data) {
+                slot = n;
+                break;
+            }
+        }
+        if (slot < 0) {
+            slot = ctx->next_frame;
+            ctx->next_frame = (ctx->next_frame + 1) % MAX_RENDERED_FRAMES;
+        }
+        free_frame(&ctx->frames[slot]);
+        ctx->frames[slot] = f;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (renderer)
+        ass_renderer_done(renderer);
+    return NULL;
+}
+
+// Set up everything the worker needs, so that it doesn't have to access the
+// options or the main thread's libass state.
+static void setup_worker(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    ctx->worker_library = mp_ass_init(sd->global, sd->log);
+    for (int n = 0; n < sd->num_ass_fonts; n++) {
+        struct demux_attachment *font = &sd->ass_fonts[n];
+        ass_add_font(ctx->worker_library, font->name, font->data,
+                     font->data_size);
+    }
+    // Extract fonts embedded in the subtitle header.
+    if (sd->extradata) {
+        ASS_Track *track = ass_new_track(ctx->worker_library);
+        ass_process_codec_private(track, sd->extradata, sd->extradata_len);
+        ass_free_track(track);
+    }
+    ctx->worker_track = ass_new_track(ctx->worker_library);
+    ctx->resync_track = true;
+
+    ctx->worker_font = talloc_strdup(ctx, sd->opts->sub_text_style->font);
+    mp_ass_find_fonts(ctx, sd->global, &ctx->worker_default_font,
+                      &ctx->worker_fonts_conf);
+}
+
+// Start the worker if --ass-render-ahead is enabled. Returns whether it runs.
+static bool start_worker(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    if (ctx->worker_running)
+        return true;
+    if (!sd->opts->ass_render_ahead || !sd->ass_library || !sd->global ||
+        ctx->worker_failed)
+        return false;
+
+    // The player copies the font attachments only if the option was set
+    // when the file was loaded.
+    if (!sd->have_ass_fonts) {
+        MP_WARN(sd, "--ass-render-ahead takes effect with the next file.\n");
+        ctx->worker_failed = true;
+        return false;
+    }
+
+    ctx->worker_quit = false;
+    if (!ctx->worker_library)
+        setup_worker(sd);
+    if (pthread_create(&ctx->worker, NULL, render_thread, sd)) {
+        MP_ERR(sd, "Could not start subtitle render thread.\n");
+        ctx->worker_failed = true;
+        return false;
+    }
+    ctx->worker_running = true;
+    return true;
+}
+
+static void render_ahead(struct sd *sd, double pts)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    if (!sd->opts->ass_render_ahead || pts == MP_NOPTS_VALUE ||
+        !start_worker(sd))
+        return;
+
+    long long time = pts * 1000 + 0.5;
+    pthread_mutex_lock(&ctx->lock);
+    // The parameters are only known after the first get_bitmaps() call.
+    bool needed = ctx->have_params && time != ctx->last_time &&
+                  find_frame(ctx, time, &ctx->params) < 0;
+    for (int n = 0; n < ctx->num_requests; n++)
+        needed &= ctx->requests[n] != time;
+    if (needed) {
+        if (ctx->num_requests == MAX_RENDER_REQUESTS) {
+            ctx->num_requests--;
+            memmove(&ctx->requests[0], &ctx->requests[1],
+                    ctx->num_requests * sizeof(ctx->requests[0]));
+        }
+        ctx->requests[ctx->num_requests++] = time;
+        pthread_cond_signal(&ctx->wakeup);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void stop_worker(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    if (ctx->worker_running) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->worker_quit = true;
+        pthread_cond_signal(&ctx->wakeup);
+        pthread_mutex_unlock(&ctx->lock);
+        pthread_join(ctx->worker, NULL);
+        ctx->worker_running = false;
+    }
+    if (ctx->worker_track)
+        ass_free_track(ctx->worker_track);
+    ctx->worker_track = NULL;
+    if (ctx->worker_library)
+        ass_library_done(ctx->worker_library);
+    ctx->worker_library = NULL;
+    for (int n = 0; n < MAX_RENDERED_FRAMES; n++)
+        free_frame(&ctx->frames[n]);
+    free_frame(&ctx->urgent_frame);
+    free_frame(&ctx->shown);
+    ctx->num_requests = 0;
+}
+
+// Render the frame on the worker, and wait until it's done. Returns false if
+// the worker can't render.
+static bool render_now(struct sd_ass_priv *ctx, long long time)
+{
+    pthread_mutex_lock(&ctx->lock);
+    ctx->urgent = true;
+    ctx->urgent_time = time;
+    pthread_cond_signal(&ctx->wakeup);
+    while (ctx->urgent && !ctx->renderer_failed)
+        pthread_cond_wait(&ctx->done, &ctx->lock);
+    ctx->urgent = false;
+    bool ok = !ctx->renderer_failed;
+    pthread_mutex_unlock(&ctx->lock);
+    return ok;
+}
+
+// Return the frame pre-rendered by render_thread(), if there is one.
+static bool get_rendered_frame(struct sd *sd, long long time,
+                               struct render_params *params,
+                               struct sub_bitmaps *res)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    int changed = 0;
+    if (!frame_matches(&ctx->shown, time, params)) {
+        struct rendered_frame f = {0};
+        pthread_mutex_lock(&ctx->lock);
+        if (frame_matches(&ctx->urgent_frame, time, params)) {
+            f = ctx->urgent_frame;
+            ctx->urgent_frame = (struct rendered_frame){0};
+        }
+        int n = f.data ? -1 : find_frame(ctx, time, params);
+        if (n >= 0) {
+            f = ctx->frames[n];
+            ctx->frames[n] = (struct rendered_frame){0};
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (!f.data)
+            return false;
+        changed = ctx->shown.data ? compare_frames(&ctx->shown, &f) : 2;
+        free_frame(&ctx->shown);
+        ctx->shown = f;
+    }
+
+    if (changed == 2)
+        res->bitmap_id = ++res->bitmap_pos_id;
+    else if (changed)
+        res->bitmap_pos_id++;
+    res->format = SUBBITMAP_LIBASS;
+
+    // Copy the part list, because mangle_colors() changes it.
+    int num_parts = ctx->shown.num_parts;
+    if (MP_TALLOC_ELEMS(ctx->parts) < num_parts)
+        ctx->parts = talloc_realloc(ctx, ctx->parts, struct sub_bitmap, num_parts);
+    if (num_parts)
+        memcpy(ctx->parts, ctx->shown.parts, num_parts * sizeof(ctx->parts[0]));
+    res->parts = ctx->parts;
+    res->num_parts = num_parts;
+    return true;
+}
+
+static void get_bitmaps(struct sd *sd, struct mp_osd_res dim, double pts,
+                        struct sub_bitmaps *res)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    if (pts == MP_NOPTS_VALUE || !sd->ass_renderer)
+        return;
+
+    long long time = pts * 1000 + .5;
+    struct render_params params;
+    get_render_params(sd, dim, &params);
+
+    bool rendered = false;
+    if (start_worker(sd)) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->params = params;
+        ctx->have_params = true;
+        ctx->last_time = time;
+        pthread_mutex_unlock(&ctx->lock);
+
+        rendered = get_rendered_frame(sd, time, &params, res) ||
+                   (render_now(ctx, time) &&
+                    get_rendered_frame(sd, time, &params, res));
+    }
+
+    if (!rendered) {
+        // The renderer's change detection doesn't know about frames that
+        // were rendered by the worker.
+        bool force_change = ctx->shown.data;
+        free_frame(&ctx->shown);
+
+        ASS_Renderer *renderer = sd->ass_renderer;
+        pthread_mutex_lock(&ctx->track_lock);
+        configure_renderer(renderer, &params);
+        mp_ass_render_frame(renderer, ctx->ass_track, time, &ctx->parts, res);
+        pthread_mutex_unlock(&ctx->track_lock);
+        talloc_steal(ctx, ctx->parts);
+
+        if (force_change)
+            res->bitmap_id = ++res->bitmap_pos_id;
+    }
 
     if (!ctx->is_converted)
         mangle_colors(sd, res);
@@ -271,15 +828,29 @@ static void fix_events(struct sd *sd)
 static void reset(struct sd *sd)
 {
     struct sd_ass_priv *ctx = sd->priv;
-    if (ctx->flush_on_seek)
+    pthread_mutex_lock(&ctx->track_lock);
+    if (ctx->flush_on_seek) {
         ass_flush_events(ctx->ass_track);
+        ctx->resync_track = true;
+        drop_frames(ctx, LLONG_MIN, LLONG_MAX);
+    }
     ctx->flush_on_seek = false;
+    pthread_mutex_unlock(&ctx->track_lock);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->num_requests = 0;
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 static void uninit(struct sd *sd)
 {
     struct sd_ass_priv *ctx = sd->priv;
 
+    stop_worker(sd);
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_cond_destroy(&ctx->done);
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_mutex_destroy(&ctx->track_lock);
     if (sd->ass_track != ctx->ass_track)
         ass_free_track(ctx->ass_track);
     talloc_free(ctx);
@@ -300,6 +871,9 @@ static int control(struct sd *sd, enum sd_ctrl cmd, void *arg)
         ctx->video_params = *(struct mp_image_params *)arg;
         return CONTROL_OK;
     }
+    case SD_CTRL_RENDER_AHEAD:
+        render_ahead(sd, *(double *)arg);
+        return CONTROL_OK;
     default:
         return CONTROL_UNKNOWN;
     }
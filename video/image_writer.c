@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <setjmp.h>
+#include <pthread.h>
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/mem.h>
@@ -35,6 +36,8 @@
 
 #include "image_writer.h"
 #include "talloc.h"
+#include "common/common.h"
+#include "common/msg.h"
 #include "video/img_format.h"
 #include "video/mp_image.h"
 #include "video/fmt-conversion.h"
@@ -320,3 +323,167 @@ void dump_png(struct mp_image *image, const char *filename, struct mp_log *log)
     opts.format = "png";
     write_image(image, &opts, filename, log);
 }
+
+struct writer_job {
+    struct mp_image *image;
+    struct image_writer_opts opts;
+    char *filename;
+};
+
+struct image_writer_queue {
+    struct mp_log *log;
+
+    pthread_t *threads;
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // Queued jobs (ring buffer, not yet picked up by a thread)
+    struct writer_job **jobs;
+    int max_jobs;
+    int first_job, num_jobs;
+    int num_busy;           // jobs being written right now
+    int num_errors;         // failed writes not yet seen by the user
+    // Filenames of all jobs that weren't finished yet (owned by the jobs)
+    char **pending_files;
+    int num_pending_files;
+    bool terminate;
+};
+
+static void run_job(struct image_writer_queue *q, struct writer_job *job)
+{
+    bool ok = write_image(job->image, &job->opts, job->filename, q->log);
+    pthread_mutex_lock(&q->lock);
+    for (int n = 0; n < q->num_pending_files; n++) {
+        if (q->pending_files[n] == job->filename) {
+            MP_TARRAY_REMOVE_AT(q->pending_files, q->num_pending_files, n);
+            break;
+        }
+    }
+    if (!ok)
+        q->num_errors++;
+    pthread_mutex_unlock(&q->lock);
+    talloc_free(job);
+}
+
+static void *writer_thread(void *arg)
+{
+    struct image_writer_queue *q = arg;
+
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        if (q->num_jobs) {
+            struct writer_job *job = q->jobs[q->first_job];
+            q->first_job = (q->first_job + 1) % q->max_jobs;
+            q->num_jobs--;
+            q->num_busy++;
+            pthread_cond_broadcast(&q->wakeup);
+            pthread_mutex_unlock(&q->lock);
+            run_job(q, job);
+            pthread_mutex_lock(&q->lock);
+            q->num_busy--;
+            pthread_cond_broadcast(&q->wakeup);
+        } else if (q->terminate) {
+            break;
+        } else {
+            pthread_cond_wait(&q->wakeup, &q->lock);
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+struct image_writer_queue *image_writer_queue_create(struct mp_log *log,
+                                                     int num_threads,
+                                                     int max_queued)
+{
+    struct image_writer_queue *q = talloc_zero(NULL, struct image_writer_queue);
+    q->log = log;
+    q->max_jobs = MPMAX(max_queued, 1);
+    q->jobs = talloc_array(q, struct writer_job *, q->max_jobs);
+    q->threads = talloc_array(q, pthread_t, MPMAX(num_threads, 0));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->wakeup, NULL);
+    for (int n = 0; n < num_threads; n++) {
+        if (pthread_create(&q->threads[n], NULL, writer_thread, q)) {
+            mp_warn(log, "Could not create image writer thread.\n");
+            break;
+        }
+        q->num_threads++;
+    }
+    return q;
+}
+
+void image_writer_queue_add(struct image_writer_queue *q,
+                            struct mp_image *image,
+                            const struct image_writer_opts *opts,
+                            const char *filename)
+{
+    struct writer_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct writer_job) {
+        .image = talloc_steal(job, image),
+        .opts = opts ? *opts : image_writer_opts_defaults,
+        .filename = talloc_strdup(job, filename),
+    };
+    job->opts.format = talloc_strdup(job, job->opts.format);
+
+    pthread_mutex_lock(&q->lock);
+    MP_TARRAY_APPEND(q, q->pending_files, q->num_pending_files, job->filename);
+
+    // Without threads, write synchronously.
+    if (!q->num_threads) {
+        pthread_mutex_unlock(&q->lock);
+        run_job(q, job);
+        return;
+    }
+
+    while (q->num_jobs == q->max_jobs)
+        pthread_cond_wait(&q->wakeup, &q->lock);
+    q->jobs[(q->first_job + q->num_jobs) % q->max_jobs] = job;
+    q->num_jobs++;
+    pthread_cond_broadcast(&q->wakeup);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void image_writer_queue_flush(struct image_writer_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->num_jobs || q->num_busy)
+        pthread_cond_wait(&q->wakeup, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+}
+
+bool image_writer_queue_has_file(struct image_writer_queue *q,
+                                 const char *filename)
+{
+    bool found = false;
+    pthread_mutex_lock(&q->lock);
+    for (int n = 0; n < q->num_pending_files; n++)
+        found |= strcmp(q->pending_files[n], filename) == 0;
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+int image_writer_queue_get_errors(struct image_writer_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    int errors = q->num_errors;
+    q->num_errors = 0;
+    pthread_mutex_unlock(&q->lock);
+    return errors;
+}
+
+void image_writer_queue_destroy(struct image_writer_queue *q)
+{
+    if (!q)
+        return;
+    pthread_mutex_lock(&q->lock);
+    q->terminate = true;
+    pthread_cond_broadcast(&q->wakeup);
+    pthread_mutex_unlock(&q->lock);
+    for (int n = 0; n < q->num_threads; n++)
+        pthread_join(q->threads[n], NULL);
+    pthread_cond_destroy(&q->wakeup);
+    pthread_mutex_destroy(&q->lock);
+    talloc_free(q);
+}
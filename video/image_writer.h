@@ -15,6 +15,8 @@
  * with mplayer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
+
 struct mp_image;
 struct mp_log;
 
@@ -50,5 +52,37 @@ const char *image_writer_file_ext(const struct image_writer_opts *opts);
 int write_image(struct mp_image *image, const struct image_writer_opts *opts,
                 const char *filename, struct mp_log *log);
 
+// Writes images asynchronously on a set of worker threads.
+struct image_writer_queue;
+
+// Create a queue with num_threads writer threads. If num_threads is 0 (or no
+// thread could be created), images are written synchronously. At most
+// max_queued images wait to be written; image_writer_queue_add() blocks
+// while the queue is full.
+struct image_writer_queue *image_writer_queue_create(struct mp_log *log,
+                                                     int num_threads,
+                                                     int max_queued);
+
+// Queue an image for write_image(). Takes ownership of the image, which must
+// not be a talloc child of anything else. opts and filename are copied.
+void image_writer_queue_add(struct image_writer_queue *q,
+                            struct mp_image *image,
+                            const struct image_writer_opts *opts,
+                            const char *filename);
+
+// Wait until all queued images have been written.
+void image_writer_queue_flush(struct image_writer_queue *q);
+
+// Whether an image that is queued or being written has the given filename.
+// The file might not exist yet.
+bool image_writer_queue_has_file(struct image_writer_queue *q,
+                                 const char *filename);
+
+// Return the number of failed writes since the last call.
+int image_writer_queue_get_errors(struct image_writer_queue *q);
+
+// Write all queued images, and free the queue. q can be NULL.
+void image_writer_queue_destroy(struct image_writer_queue *q);
+
 // Debugging helper.
 void dump_png(struct mp_image *image, const char *filename, struct mp_log *log);
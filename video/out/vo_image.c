@@ -39,6 +39,7 @@
 #include "video/sws_utils.h"
 #include "sub/osd.h"
 #include "options/m_option.h"
+#include "osdep/numcores.h"
 
 struct priv {
     struct image_writer_opts *opts;
@@ -46,6 +47,8 @@ struct priv {
 
     struct mp_image *current;
     int frame;
+
+    struct image_writer_queue *queue;
 };
 
 static bool checked_mkdir(struct vo *vo, const char *buf)
@@ -114,10 +117,11 @@ static void flip_page(struct vo *vo)
         filename = mp_path_join(t, bstr0(p->outdir), bstr0(filename));
 
     MP_INFO(vo, "Saving %s\n", filename);
-    write_image(p->current, p->opts, filename, vo->log);
+    if (p->current)
+        image_writer_queue_add(p->queue, p->current, p->opts, filename);
+    p->current = NULL;
 
     talloc_free(t);
-    mp_image_unrefp(&p->current);
 }
 
 static int query_format(struct vo *vo, uint32_t fmt)
@@ -132,11 +136,18 @@ static void uninit(struct vo *vo)
     struct priv *p = vo->priv;
 
     mp_image_unrefp(&p->current);
+    image_writer_queue_destroy(p->queue);
 }
 
 static int preinit(struct vo *vo)
 {
+    struct priv *p = vo->priv;
+
     vo->untimed = true;
+    // Encoding an image is much slower than decoding a frame, so write
+    // several images in parallel.
+    int threads = MPMAX(default_thread_count(), 1);
+    p->queue = image_writer_queue_create(vo->log, threads, threads * 2);
     return 0;
 }
 
@@ -35,12 +35,18 @@
 
 #include "sub/osd.h"
 
+// Maximum number of frames queued for the encoder thread.
+#define ENCODE_QUEUE_SIZE 4
+
 struct priv {
+    // Only accessed by the encoder thread.
     uint8_t *buffer;
     size_t buffer_size;
-    AVStream *stream;
     int have_first_packet;
 
+    AVStream *stream;
+    struct encode_worker *worker;
+
     int harddup;
 
     double lastpts;
@@ -75,6 +81,7 @@ static int preinit(struct vo *vo)
 }
 
 static void draw_image(struct vo *vo, mp_image_t *mpi);
+static void process_job(void *priv, void *p);
 static void uninit(struct vo *vo)
 {
     struct priv *vc = vo->priv;
@@ -84,6 +91,9 @@ static void uninit(struct vo *vo)
     if (vc->lastipts >= 0 && vc->stream)
         draw_image(vo, NULL);
 
+    encode_worker_destroy(vc->worker);
+    vc->worker = NULL;
+
     mp_image_unrefp(&vc->lastimg);
 
     vo->priv = NULL;
@@ -166,6 +176,9 @@ static int config(struct vo *vo, uint32_t width, uint32_t height,
 
     vc->buffer = talloc_size(vc, vc->buffer_size);
 
+    vc->worker = encode_worker_create(vo->encode_lavc_ctx, ENCODE_QUEUE_SIZE,
+                                      process_job, vo);
+
     mp_image_unrefp(&vc->lastimg);
 
     return 0;
@@ -192,7 +205,9 @@ static int query_format(struct vo *vo, uint32_t format)
             // we don't convert colorspaces here
 }
 
-static void write_packet(struct vo *vo, int size, AVPacket *packet)
+// ipts is used if the encoder doesn't return a pts.
+static void write_packet(struct vo *vo, int size, AVPacket *packet,
+                         int64_t ipts)
 {
     struct priv *vc = vo->priv;
 
@@ -209,7 +224,7 @@ static void write_packet(struct vo *vo, int size, AVPacket *packet)
                                        vc->stream->time_base);
         } else {
             MP_VERBOSE(vo, "codec did not provide pts\n");
-            packet->pts = av_rescale_q(vc->lastipts, vc->worst_time_base,
+            packet->pts = av_rescale_q(ipts, vc->worst_time_base,
                                        vc->stream->time_base);
         }
         if (packet->dts != AV_NOPTS_VALUE) {
@@ -272,12 +287,60 @@ static int encode_video(struct vo *vo, AVFrame *frame, AVPacket *packet)
     }
 }
 
+struct encode_job {
+    struct mp_image *img;   // NULL: flush the encoder
+    int64_t pts;            // in codec time base
+    int64_t ipts;           // in worst_time_base
+};
+
+// Runs on the encoder thread.
+static void process_job(void *priv, void *p)
+{
+    struct vo *vo = priv;
+    struct priv *vc = vo->priv;
+    struct encode_job *job = p;
+    AVCodecContext *avc = vc->stream->codec;
+    AVPacket packet;
+    int size;
+
+    if (job->img) {
+        AVFrame *frame = avcodec_alloc_frame();
+
+        frame->pts = job->pts;
+
+        enum AVPictureType savetype = frame->pict_type;
+        mp_image_copy_fields_to_av_frame(frame, job->img);
+        frame->pict_type = savetype;
+            // keep this at avcodec_get_frame_defaults default
+
+        frame->quality = avc->global_quality;
+
+        av_init_packet(&packet);
+        packet.data = vc->buffer;
+        packet.size = vc->buffer_size;
+        size = encode_video(vo, frame, &packet);
+        write_packet(vo, size, &packet, job->ipts);
+
+        avcodec_free_frame(&frame);
+    } else {
+        // finish encoding
+        do {
+            av_init_packet(&packet);
+            packet.data = vc->buffer;
+            packet.size = vc->buffer_size;
+            size = encode_video(vo, NULL, &packet);
+            write_packet(vo, size, &packet, job->ipts);
+        } while (size > 0);
+    }
+
+    mp_image_unrefp(&job->img);
+    talloc_free(job);
+}
+
 static void draw_image(struct vo *vo, mp_image_t *mpi)
 {
     struct priv *vc = vo->priv;
     struct encode_lavc_context *ectx = vo->encode_lavc_ctx;
-    int size;
-    AVFrame *frame;
     AVCodecContext *avc;
     int64_t frameipts;
     double nextpts;
@@ -402,12 +465,9 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
     }
 
     if (vc->lastipts != MP_NOPTS_VALUE) {
-        frame = avcodec_alloc_frame();
-
         // we have a valid image in lastimg
         while (vc->lastipts < frameipts) {
             int64_t thisduration = vc->harddup ? 1 : (frameipts - vc->lastipts);
-            AVPacket packet;
 
             // we will ONLY encode this frame if it can be encoded at at least
             // vc->mindeltapts after the last encoded frame!
@@ -419,44 +479,30 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
                 skipframes = 0;
 
             if (thisduration > skipframes) {
-                avcodec_get_frame_defaults(frame);
-
-                // this is a nop, unless the worst time base is the STREAM time base
-                frame->pts = av_rescale_q(vc->lastipts + skipframes,
-                                          vc->worst_time_base, avc->time_base);
-
-                enum AVPictureType savetype = frame->pict_type;
-                mp_image_copy_fields_to_av_frame(frame, vc->lastimg);
-                frame->pict_type = savetype;
-                    // keep this at avcodec_get_frame_defaults default
-
-                frame->quality = avc->global_quality;
-
-                av_init_packet(&packet);
-                packet.data = vc->buffer;
-                packet.size = vc->buffer_size;
-                size = encode_video(vo, frame, &packet);
-                write_packet(vo, size, &packet);
+                // The encoder thread gets its own reference; drawing the OSD
+                // on the next frame won't modify the queued image.
+                struct encode_job *job = talloc_ptrtype(NULL, job);
+                *job = (struct encode_job) {
+                    .img = mp_image_new_ref(vc->lastimg),
+                    // this is a nop, unless the worst time base is the STREAM time base
+                    .pts = av_rescale_q(vc->lastipts + skipframes,
+                                        vc->worst_time_base, avc->time_base),
+                    .ipts = vc->lastipts,
+                };
+                encode_worker_queue(vc->worker, job);
                 ++vc->lastdisplaycount;
                 vc->lastencodedipts = vc->lastipts + skipframes;
             }
 
             vc->lastipts += thisduration;
         }
-
-        avcodec_free_frame(&frame);
     }
 
     if (!mpi) {
         // finish encoding
-        do {
-            AVPacket packet;
-            av_init_packet(&packet);
-            packet.data = vc->buffer;
-            packet.size = vc->buffer_size;
-            size = encode_video(vo, NULL, &packet);
-            write_packet(vo, size, &packet);
-        } while (size > 0);
+        struct encode_job *job = talloc_ptrtype(NULL, job);
+        *job = (struct encode_job) { .ipts = vc->lastipts };
+        encode_worker_queue(vc->worker, job);
     } else {
         if (frameipts >= vc->lastframeipts) {
             if (vc->lastframeipts != MP_NOPTS_VALUE && vc->lastdisplaycount != 1)
@@ -139,6 +139,7 @@ def build(ctx):
         ( "audio/filter/af_surround.c" ),
         ( "audio/filter/af_sweep.c" ),
         ( "audio/filter/af_volume.c" ),
+        ( "audio/filter/fftconv.c" ),
         ( "audio/filter/filter.c" ),
         ( "audio/filter/tools.c" ),
         ( "audio/filter/window.c" ),
@@ -203,6 +204,7 @@ def build(ctx):
         ( "input/lirc.c",                        "lirc" ),
 
         ## Misc
+        ( "misc/json.c" ),
         ( "misc/ring.c" ),
         ( "misc/charset_conv.c" ),
 
@@ -220,6 +222,8 @@ def build(ctx):
         ( "player/command.c" ),
         ( "player/configfiles.c" ),
         ( "player/dvdnav.c" ),
+        ( "player/encode_parallel.c",            "encoding" ),
+        ( "player/ipc.c",                        "unix-socket" ),
         ( "player/loadfile.c" ),
         ( "player/main.c" ),
         ( "player/misc.c" ),
@@ -228,9 +232,11 @@ def build(ctx):
         ( "player/playloop.c" ),
         ( "player/screenshot.c" ),
         ( "player/sub.c" ),
+        ( "player/thumbnail.c" ),
         ( "player/timeline/tl_cue.c" ),
         ( "player/timeline/tl_mpv_edl.c" ),
         ( "player/timeline/tl_matroska.c" ),
+        ( "player/timeline/tl_open.c" ),
         ( "player/video.c" ),
 
         ## Streams